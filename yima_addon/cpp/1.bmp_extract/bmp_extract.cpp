@@ -1,13 +1,16 @@
 #include "bmp_extract.h"
 #include "../yima_common.h"
-#include <fstream>
+#include "../encoding_utils.h"
+#include "../mapped_file.h"
+#include "../yima_trace.h"
+#include "../yima_probes.h"
+#include "../pixel_kernels.h"
 #include <vector>
 #include <string>
-#include <sstream>
-#include <set>
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
-#include <iomanip>
+#include <fstream>
 
 #pragma pack(push, 2)
 struct BmpFileHeader {
@@ -37,68 +40,215 @@ struct RgbQuad {
 };
 #pragma pack(pop)
 
-extern "C" {
-    YIMA_API char* process_bmp_to_toml(const char* file_path) {
-        std::ifstream file(file_path, std::ios::binary);
-        if (!file) return nullptr;
-
-        BmpFileHeader bmfh;
-        BmpInfoHeader bmih;
-        file.read(reinterpret_cast<char*>(&bmfh), sizeof(bmfh));
-        file.read(reinterpret_cast<char*>(&bmih), sizeof(bmih));
-
-        if (bmih.biBitCount != 8) return nullptr;
-
-        int numColors = (bmih.biClrUsed == 0) ? 256 : bmih.biClrUsed;
-        std::vector<RgbQuad> palette(numColors);
-        file.read(reinterpret_cast<char*>(palette.data()), numColors * sizeof(RgbQuad));
-
-        int32_t width = bmih.biWidth;
-        int32_t height = (bmih.biHeight < 0) ? -bmih.biHeight : bmih.biHeight;
-        file.seekg(bmfh.bfOffBits, std::ios::beg);
-
-        int rowSize = ((width * 8 + 31) / 32) * 4;
-        std::vector<uint8_t> rowData(rowSize);
-
-        std::set<std::string> color_palette;
-        std::stringstream data_ss;
-        data_ss << "data = [\n";
-
-        for (int y = 0; y < height; ++y) {
-            file.read(reinterpret_cast<char*>(rowData.data()), rowSize);
-            data_ss << "  "; 
-            for (int x = 0; x < width; ++x) {
-                uint8_t index = rowData[x];
-                uint8_t r = palette[index].rgbRed;
-                uint8_t g = palette[index].rgbGreen;
-                uint8_t b = palette[index].rgbBlue;
-
-                std::stringstream hex_ss;
-                hex_ss << "#" << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << (int)r
-                       << std::setw(2) << std::setfill('0') << (int)g
-                       << std::setw(2) << std::setfill('0') << (int)b;
-                std::string hex = hex_ss.str();
-                color_palette.insert(hex);
-
-                // --- 坐标逻辑：左下角原点，且全部坐标 + 1 ---
-                int tx = x + 1; 
-                int ty = y + 1; 
-
-                data_ss << "[" << tx << "," << ty << ",\"" << hex << "\"]";
-                if (!(y == height - 1 && x == width - 1)) data_ss << ", ";
-            }
-            data_ss << "\n"; 
-        }
-        data_ss << "]";
+bool ProbeBmpHeader(const uint8_t* data, size_t size, uint64_t file_size, BmpProbe& out) {
+    BmpFileHeader bmfh;
+    BmpInfoHeader bmih;
+    if (!data || size < sizeof(bmfh) + sizeof(bmih)) return false;
+    std::memcpy(&bmfh, data, sizeof(bmfh));
+    std::memcpy(&bmih, data + sizeof(bmfh), sizeof(bmih));
+    if (bmfh.bfType != 0x4D42) return false;
+
+    out = BmpProbe();
+    out.width = bmih.biWidth;
+    out.height = (bmih.biHeight < 0) ? -bmih.biHeight : bmih.biHeight;
+    out.topDown = bmih.biHeight < 0;
+    out.bitCount = bmih.biBitCount;
+    out.compression = bmih.biCompression;
+    out.fileSize = file_size;
+
+    int maxColors = (bmih.biBitCount <= 8) ? (1 << bmih.biBitCount) : 0;
+    out.paletteSize = (bmih.biClrUsed == 0) ? maxColors : (int)std::min<uint32_t>(bmih.biClrUsed, 256);
+    size_t paletteOffset = sizeof(bmfh) + bmih.biSize;
+    size_t available = (paletteOffset < size) ? (size - paletteOffset) / sizeof(RgbQuad) : 0;
+    int readable = (int)std::min<size_t>((size_t)out.paletteSize, available);
+    const RgbQuad* palette = reinterpret_cast<const RgbQuad*>(data + paletteOffset);
+    std::vector<uint32_t> colors;
+    for (int i = 0; i < readable; ++i) {
+        colors.push_back(((uint32_t)palette[i].rgbRed << 16) | ((uint32_t)palette[i].rgbGreen << 8) | palette[i].rgbBlue);
+    }
+    std::sort(colors.begin(), colors.end());
+    out.paletteColors = (int)(std::unique(colors.begin(), colors.end()) - colors.begin());
+
+    if (out.width > 0 && out.height > 0 && bmih.biBitCount > 0) {
+        uint64_t rowSize = (((uint64_t)out.width * bmih.biBitCount + 31) / 32) * 4;
+        uint64_t lastRow = ((uint64_t)out.width * bmih.biBitCount + 7) / 8;
+        out.truncated = bmfh.bfOffBits + rowSize * (out.height - 1) + lastRow > file_size;
+    }
+    return true;
+}
+
+bool ProbeBmpFile(const std::filesystem::path& file_path, BmpProbe& out) {
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file.is_open()) return false;
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = (uint64_t)file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    // 先读文件头与信息头, 再按 biSize 补读调色板 (最多 256 项)
+    std::vector<uint8_t> head(sizeof(BmpFileHeader) + sizeof(BmpInfoHeader));
+    if (!file.read(reinterpret_cast<char*>(head.data()), head.size())) return false;
+    uint32_t biSize = 0;
+    std::memcpy(&biSize, head.data() + sizeof(BmpFileHeader), sizeof(biSize));
+    size_t want = std::min<uint64_t>(sizeof(BmpFileHeader) + (uint64_t)biSize + 256 * sizeof(RgbQuad), fileSize);
+    if (want > head.size()) {
+        size_t have = head.size();
+        head.resize(want);
+        file.read(reinterpret_cast<char*>(head.data() + have), want - have);
+        head.resize(have + (size_t)file.gcount());
+    }
+    return ProbeBmpHeader(head.data(), head.size(), fileSize, out);
+}
+
+bool DecodeBmpLayer(const uint8_t* data, size_t size, LayerGrid& out) {
+    TraceSpan span("decode_bmp", "bmp");
+    span.Arg("bytes", (int64_t)size);
+    BmpFileHeader bmfh;
+    BmpInfoHeader bmih;
+    if (!data || size < sizeof(bmfh) + sizeof(bmih)) return false;
+    std::memcpy(&bmfh, data, sizeof(bmfh));
+    std::memcpy(&bmih, data + sizeof(bmfh), sizeof(bmih));
+
+    if (bmfh.bfType != 0x4D42 || bmih.biBitCount != 8) return false;
+
+    int numColors = (bmih.biClrUsed == 0) ? 256 : (int)std::min<uint32_t>(bmih.biClrUsed, 256);
+    size_t paletteOffset = sizeof(bmfh) + bmih.biSize;
+    if (paletteOffset + numColors * sizeof(RgbQuad) > size) return false;
+    const RgbQuad* palette = reinterpret_cast<const RgbQuad*>(data + paletteOffset);
+
+    int32_t width = bmih.biWidth;
+    int32_t height = (bmih.biHeight < 0) ? -bmih.biHeight : bmih.biHeight;
+    if (width <= 0 || height <= 0) return false;
+    span.Arg("pixels", (int64_t)width * height);
+
+    size_t rowSize = (((size_t)width * 8 + 31) / 32) * 4;
+    if (bmfh.bfOffBits + rowSize * (height - 1) + width > size) return false;
+    const uint8_t* pixels = data + bmfh.bfOffBits;
+
+    // 1. 统计实际使用的调色板索引
+    bool used[256] = {};
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = pixels + rowSize * y;
+        for (int x = 0; x < width; ++x) used[row[x]] = true;
+    }
+
+    // 2. 按 #RRGGBB 字典序合并相同颜色, 构建紧凑调色板与索引重映射表
+    auto packed = [&](int i) -> uint32_t {
+        if (i >= numColors) return 0;
+        return ((uint32_t)palette[i].rgbRed << 16) | ((uint32_t)palette[i].rgbGreen << 8) | palette[i].rgbBlue;
+    };
+    std::vector<uint32_t> colors;
+    for (int i = 0; i < 256; ++i) if (used[i]) colors.push_back(packed(i));
+    std::sort(colors.begin(), colors.end());
+    colors.erase(std::unique(colors.begin(), colors.end()), colors.end());
 
-        std::stringstream final_toml;
-        final_toml << "width = " << width << "\nheight = " << height << "\nall_pixels = [";
-        for (auto it = color_palette.begin(); it != color_palette.end(); ++it) {
-            final_toml << "\"" << *it << "\"" << (std::next(it) == color_palette.end() ? "" : ", ");
+    uint8_t remap[256] = {};
+    for (int i = 0; i < 256; ++i) {
+        if (used[i]) remap[i] = (uint8_t)(std::lower_bound(colors.begin(), colors.end(), packed(i)) - colors.begin());
+    }
+
+    out.width = width;
+    out.height = height;
+    out.palette.resize(colors.size());
+    for (size_t i = 0; i < colors.size(); ++i) {
+        out.palette[i].r = (uint8_t)(colors[i] >> 16);
+        out.palette[i].g = (uint8_t)(colors[i] >> 8);
+        out.palette[i].b = (uint8_t)colors[i];
+        out.palette[i].a = 0;
+    }
+
+    // 3. 按文件行顺序写出索引 (与旧版 TOML 的 y 坐标一致)
+    out.indices.resize((size_t)width * height);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = pixels + rowSize * y;
+        RemapPixels(row, (size_t)width, remap, out.indices.data() + (size_t)width * y);
+    }
+    YIMA_PROBE3(bmp__decode, size, width, height);
+    return true;
+}
+
+bool DecodeBmpLayerFile(const std::filesystem::path& file_path, LayerGrid& out) {
+    TraceSpan span("decode_bmp_file", "bmp");
+    if (TraceEnabled()) span.Detail(PathToUtf8String(file_path.filename()));
+    MappedFile file(file_path);
+    return file.IsOpen() && DecodeBmpLayer(file.data(), file.size(), out);
+}
+
+std::vector<uint8_t> EncodeBmpLayer(const LayerGrid& grid) {
+    const size_t colors = grid.palette.size();
+    const size_t rowSize = (((size_t)grid.width * 8 + 31) / 32) * 4;
+    const size_t offBits = sizeof(BmpFileHeader) + sizeof(BmpInfoHeader) + colors * sizeof(RgbQuad);
+    std::vector<uint8_t> out(offBits + rowSize * grid.height, 0);
+
+    BmpFileHeader bmfh = {};
+    bmfh.bfType = 0x4D42;
+    bmfh.bfSize = (uint32_t)out.size();
+    bmfh.bfOffBits = (uint32_t)offBits;
+    BmpInfoHeader bmih = {};
+    bmih.biSize = sizeof(BmpInfoHeader);
+    bmih.biWidth = grid.width;
+    bmih.biHeight = grid.height;
+    bmih.biPlanes = 1;
+    bmih.biBitCount = 8;
+    bmih.biSizeImage = (uint32_t)(rowSize * grid.height);
+    bmih.biClrUsed = (uint32_t)colors;
+    std::memcpy(out.data(), &bmfh, sizeof(bmfh));
+    std::memcpy(out.data() + sizeof(bmfh), &bmih, sizeof(bmih));
+
+    RgbQuad* palette = reinterpret_cast<RgbQuad*>(out.data() + sizeof(bmfh) + sizeof(bmih));
+    for (size_t i = 0; i < colors; ++i) {
+        palette[i] = RgbQuad{ grid.palette[i].b, grid.palette[i].g, grid.palette[i].r, 0 };
+    }
+    for (int y = 0; y < grid.height; ++y) {
+        std::memcpy(out.data() + offBits + rowSize * y, grid.indices.data() + (size_t)grid.width * y, grid.width);
+    }
+    return out;
+}
+
+std::string FormatLayerToml(const LayerGrid& grid) {
+    std::vector<std::string> hex(grid.palette.size());
+    for (size_t i = 0; i < hex.size(); ++i) hex[i] = LayerColorHex(grid.palette[i]);
+
+    std::string s;
+    s.reserve((size_t)grid.width * grid.height * 24 + 256);
+    s += "width = " + std::to_string(grid.width) + "\nheight = " + std::to_string(grid.height) + "\nall_pixels = [";
+    for (size_t i = 0; i < hex.size(); ++i) {
+        s += "\"" + hex[i] + "\"";
+        if (i + 1 != hex.size()) s += ", ";
+    }
+    s += "]\n\ndata = [\n";
+
+    for (int y = 1; y <= grid.height; ++y) {
+        s += "  ";
+        // --- 坐标逻辑：左下角原点，且全部坐标 + 1 ---
+        std::string ty = std::to_string(y);
+        for (int x = 1; x <= grid.width; ++x) {
+            s += '[';
+            s += std::to_string(x);
+            s += ',';
+            s += ty;
+            s += ",\"";
+            s += hex[grid.At(x, y)];
+            s += "\"]";
+            if (!(y == grid.height && x == grid.width)) s += ", ";
         }
-        final_toml << "]\n\n" << data_ss.str();
+        s += '\n';
+    }
+    s += ']';
+    return s;
+}
+
+extern "C" {
+    YIMA_API int process_bmp_to_ylayer(const char* file_path, const char* out_path) {
+        LayerGrid grid;
+        if (!DecodeBmpLayerFile(file_path, grid)) return -1;
+        return WriteYLayer(out_path, grid) ? 0 : -2;
+    }
+
+    YIMA_API char* process_bmp_to_toml(const char* file_path) {
+        LayerGrid grid;
+        if (!DecodeBmpLayerFile(file_path, grid)) return nullptr;
 
-        std::string res_str = final_toml.str();
+        std::string res_str = FormatLayerToml(grid);
         char* out = new char[res_str.size() + 1];
         std::copy(res_str.begin(), res_str.end(), out);
         out[res_str.size()] = '\0';
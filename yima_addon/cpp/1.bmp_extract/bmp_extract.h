@@ -2,8 +2,48 @@
 #define BMP_EXTRACT_H
 
 #include "../yima_common.h"
+#include "../ylayer_format.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+// 仅由文件头与调色板得到的 BMP 概要信息 (不读取像素数据)
+struct BmpProbe {
+    int32_t width = 0;
+    int32_t height = 0;          // 取绝对值
+    bool topDown = false;        // biHeight < 0
+    uint16_t bitCount = 0;
+    uint32_t compression = 0;    // 0 = BI_RGB
+    int paletteSize = 0;         // 调色板项数 (biClrUsed, 为 0 时按位深推算)
+    int paletteColors = 0;       // 调色板中不同颜色的个数
+    uint64_t fileSize = 0;
+    bool truncated = false;      // 文件长度不足以容纳全部像素行
+};
+
+// 解析 BMP 文件头与调色板, data 至少需包含文件头, 信息头与调色板; file_size 为完整文件长度
+bool ProbeBmpHeader(const uint8_t* data, size_t size, uint64_t file_size, BmpProbe& out);
+
+// 只读取 BMP 文件开头的文件头与调色板部分
+bool ProbeBmpFile(const std::filesystem::path& file_path, BmpProbe& out);
+
+// 从内存中的 BMP 数据解码 8 位索引图层 (调色板压缩为实际使用的颜色)
+bool DecodeBmpLayer(const uint8_t* data, size_t size, LayerGrid& out);
+
+// 内存映射 BMP 文件并解码
+bool DecodeBmpLayerFile(const std::filesystem::path& file_path, LayerGrid& out);
+
+// 将图层编码为 8 位索引 BMP (DecodeBmpLayer 的逆操作, 行顺序与 indices 一致), 用于生成测试与基准输入
+std::vector<uint8_t> EncodeBmpLayer(const LayerGrid& grid);
+
+// 将图层格式化为旧版 TOML 文本 (all_pixels + data 坐标数组)
+std::string FormatLayerToml(const LayerGrid& grid);
 
 extern "C" {
+    // 处理 BMP 并写出 .ylayer 二进制文件, 成功返回 0
+    YIMA_API int process_bmp_to_ylayer(const char* file_path, const char* out_path);
+
     // 处理 BMP 并返回 TOML 字符串
     YIMA_API char* process_bmp_to_toml(const char* file_path);
     
@@ -11,4 +51,4 @@ extern "C" {
     YIMA_API void free_toml_buffer(char* ptr);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -2,24 +2,20 @@
 #define TOML_ENABLE_FORMATTERS 1
 #include "../toml.hpp"
 #include "../encoding_utils.h"
+#include "../yima_log.h"
+#include "../pixel_kernels.h"
 #include <vector>
 #include <string>
 #include <fstream>
 #include <sstream>
-#include <iostream>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <filesystem>
+#include <algorithm>
 
 namespace fs = std::filesystem;
 
-struct PixelGroup {
-    std::string sema = "#000000";
-    std::string shaxian = "#000000";
-    std::string luola = "#000000";
-    std::string dumu = "#000000";
-};
-
 std::string GetStringFromNode(const toml::node* node) {
     if (!node) return "";
     if (auto s = node->as_string()) return s->get();
@@ -27,163 +23,248 @@ std::string GetStringFromNode(const toml::node* node) {
     return "";
 }
 
-YIMA_API int CombineTomlFiles(const char* toml_input_dir, const char* csv_output_dir, const char* config_dir) {
-    try {
-        std::vector<std::string> keys = { "sema", "shaxian", "luola", "dumu" };
-        std::map<std::string, std::map<std::string, std::string>> colorMap;
-        std::map<std::string, std::string> zhenbanMap;
-        std::map<std::string, std::vector<std::string>> signCycles;
-        std::map<std::string, std::vector<std::string>> pixel_lists;
-        std::map<int, std::map<int, PixelGroup>> dataGrid;
-        int commonWidth = -1, commonHeight = -1;
+LayerInput MakeLayerInput(const std::string& key, LayerGrid&& grid) {
+    LayerInput L;
+    L.present = true;
+    L.width = grid.width;
+    L.height = grid.height;
+    for (const auto& c : grid.palette) {
+        L.colors.push_back(LayerColorHex(c));
+        L.allPixels.push_back((key == "shaxian" && L.colors.back() == "#000000") ? "#800000" : L.colors.back());
+    }
+    L.idx = std::move(grid.indices);
+    return L;
+}
 
-        // 1. 读取单体文件
-        for (const auto& key : keys) {
-            fs::path fpath = CreatePathFromUtf8(toml_input_dir) / (key + ".toml");
-            if (!fs::exists(fpath)) continue;
-            std::string fname = fpath.string();
-            std::cout << "[TOML Load] Processing: " << fname << std::endl;
-            std::ifstream file(fpath, std::ios::binary);
-            if (!file.is_open()) {
-                std::cerr << "[TOML Load] Error: Cannot open file with ifstream: " << fname << std::endl;
-                continue;
-            }
-            std::stringstream buffer;
-            buffer << file.rdbuf();
-            file.close();
-            auto tbl = toml::parse(buffer.str(), fname);
-            commonWidth = (int)tbl["width"].as_integer()->get();
-            commonHeight = (int)tbl["height"].as_integer()->get();
-            std::cout << "[TOML Load] Width=" << commonWidth << ", Height=" << commonHeight << std::endl;
-
-            for (auto&& [k, node] : tbl) {
-                if (std::string(k.str()).find("pixels") != std::string::npos && node.is_array()) {
-                    auto p_arr = node.as_array();
-                    for (auto&& p_node : *p_arr) {
-                        std::string color = GetStringFromNode(&p_node);
-                        if (key == "shaxian" && color == "#000000") color = "#800000";
-                        pixel_lists[key].push_back(color);
-                    }
-                }
+// 读取旧版单图层 TOML, 未出现在 data 中的像素保持默认颜色 #000000 (字典第 0 项)
+static LayerInput LoadLegacyLayerToml(const std::string& key, const fs::path& fpath) {
+    std::string fname = fpath.string();
+    std::ifstream file(fpath, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("Cannot open file with ifstream: " + fname);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    file.close();
+    auto tbl = toml::parse(buffer.str(), fname);
+
+    LayerInput L;
+    L.present = true;
+    L.width = (int)tbl["width"].as_integer()->get();
+    L.height = (int)tbl["height"].as_integer()->get();
+    YIMA_LOG_INFO("TOML Load") << "Width=" << L.width << ", Height=" << L.height;
+
+    for (auto&& [k, node] : tbl) {
+        if (std::string(k.str()).find("pixels") != std::string::npos && node.is_array()) {
+            auto p_arr = node.as_array();
+            for (auto&& p_node : *p_arr) {
+                std::string color = GetStringFromNode(&p_node);
+                if (key == "shaxian" && color == "#000000") color = "#800000";
+                L.allPixels.push_back(color);
             }
+        }
+    }
 
-            if (auto d_arr = tbl["data"].as_array()) {
-                for (auto&& row_node : *d_arr) {
-                    auto row = row_node.as_array();
-                    int x = (int)row->get(0)->as_integer()->get();
-                    int y = (int)row->get(1)->as_integer()->get();
-                    std::string color = (row->get(2)->is_integer()) ? 
-                        pixel_lists[key][(size_t)row->get(2)->as_integer()->get()] : GetStringFromNode(row->get(2));
-                    if (key == "sema") dataGrid[y][x].sema = color;
-                    else if (key == "shaxian") dataGrid[y][x].shaxian = color;
-                    else if (key == "luola") dataGrid[y][x].luola = color;
-                    else if (key == "dumu") dataGrid[y][x].dumu = color;
-                }
+    int w = std::max(L.width, 0), h = std::max(L.height, 0);
+    L.colors.assign(1, "#000000");
+    L.idx.assign((size_t)w * h, 0);
+    std::unordered_map<std::string, uint8_t> colorIndex = { { "#000000", 0 } };
+    if (auto d_arr = tbl["data"].as_array()) {
+        for (auto&& row_node : *d_arr) {
+            auto row = row_node.as_array();
+            int x = (int)row->get(0)->as_integer()->get();
+            int y = (int)row->get(1)->as_integer()->get();
+            std::string color = (row->get(2)->is_integer()) ? 
+                L.allPixels[(size_t)row->get(2)->as_integer()->get()] : GetStringFromNode(row->get(2));
+            if (x < 1 || y < 1 || x > w || y > h) continue;
+            auto it = colorIndex.find(color);
+            if (it == colorIndex.end()) {
+                if (L.colors.size() >= 256) throw std::runtime_error("too many colors in " + fname);
+                it = colorIndex.emplace(color, (uint8_t)L.colors.size()).first;
+                L.colors.push_back(color);
             }
+            L.idx[(size_t)(y - 1) * w + (x - 1)] = it->second;
         }
+    }
+    return L;
+}
 
-        // 2. 加载配置
-        fs::path colorPath = CreatePathFromUtf8(config_dir) / "color_to_number.toml";
-        std::cout << "[Config] Looking for: " << colorPath.string() << " - Exists: " << (fs::exists(colorPath) ? "YES" : "NO") << std::endl;
-        if (fs::exists(colorPath)) {
-            try {
-                std::ifstream file(colorPath, std::ios::binary);
-                if (!file.is_open()) {
-                    std::cerr << "[Config] Failed to open file with ifstream" << std::endl;
-                    throw std::runtime_error("Cannot open file with ifstream");
-                }
-                std::stringstream buffer;
-                buffer << file.rdbuf();
-                file.close();
-                auto configTbl = toml::parse(buffer.str(), colorPath.string());
-                for (const auto& key : keys) {
-                    if (auto section = configTbl[key].as_table()) {
-                        for (auto&& [k, value] : *section) {
-                            colorMap[key][std::string(k.str())] = GetStringFromNode(&value);
-                        }
-                    }
-                }
-                std::cout << "[Config] Successfully loaded color_to_number.toml" << std::endl;
-            } catch (const std::exception& e) {
-                std::cerr << "[Config] Error loading color_to_number.toml: " << e.what() << std::endl;
-                throw;
+const std::string& MapLayerColor(const YimaConfig& cfg, int layer, const std::string& color) {
+    auto layerIt = cfg.colorMap.find(LAYER_NAMES[layer]);
+    if (layerIt == cfg.colorMap.end()) return color;
+    auto it = layerIt->second.find(color);
+    return it == layerIt->second.end() ? color : it->second;
+}
+
+void CombineLayers(const LayerInput layers[LAYER_COUNT], const YimaConfig& cfg, CombinedDesign& design) {
+    // 宽高取最后一个存在的图层 (与旧版行为一致)
+    int commonWidth = -1, commonHeight = -1;
+    for (int li = 0; li < LAYER_COUNT; ++li) {
+        if (!layers[li].present) continue;
+        if (commonWidth >= 0 && (layers[li].width != commonWidth || layers[li].height != commonHeight)) {
+            YIMA_LOG_WARN("Combine") << "Layer " << LAYER_NAMES[li] << " is " << layers[li].width << "x" << layers[li].height
+                                     << ", previous layers are " << commonWidth << "x" << commonHeight;
+        }
+        commonWidth = layers[li].width;
+        commonHeight = layers[li].height;
+    }
+
+    auto getT = [&](int li, const std::string& color) -> const std::string& { return MapLayerColor(cfg, li, color); };
+    auto intern = [](std::vector<std::string>& dict, std::unordered_map<std::string, uint8_t>& index, const std::string& s) {
+        auto it = index.find(s);
+        if (it != index.end()) return it->second;
+        if (dict.size() >= 256) throw std::runtime_error("too many distinct codes");
+        dict.push_back(s);
+        return index[s] = (uint8_t)(dict.size() - 1);
+    };
+
+    design = CombinedDesign();
+    design.width = std::max(commonWidth, 0);
+    design.height = std::max(commonHeight, 0);
+    std::set<std::string> uniqueShaxian(layers[LAYER_SHAXIAN].allPixels.begin(), layers[LAYER_SHAXIAN].allPixels.end());
+    size_t shaxianTypes = uniqueShaxian.size();
+    design.shaxianTypes = (int)shaxianTypes;
+
+    const std::string black = "#000000";
+    for (int li = 0; li < LAYER_COUNT; ++li) {
+        const LayerInput& L = layers[li];
+        std::vector<std::string>& dict = design.dict[li];
+        std::unordered_map<std::string, uint8_t> index;
+        std::vector<uint8_t> remap(L.colors.size());
+        for (size_t i = 0; i < L.colors.size(); ++i) remap[i] = intern(dict, index, getT(li, L.colors[i]));
+
+        std::vector<uint8_t>& plane = design.codes[li];
+        plane.resize((size_t)design.width * design.height);
+        bool covers = L.present && L.width == design.width && L.height == design.height;
+        if (covers) {
+            RemapPixels(L.idx.data(), plane.size(), remap.data(), plane.data());
+            continue;
+        }
+        for (int y = 1; y <= design.height; ++y) {
+            uint8_t* dst = plane.data() + (size_t)(y - 1) * design.width;
+            // 尺寸不一致或图层缺失时, 超出范围的像素按 #000000 处理
+            for (int x = 1; x <= design.width; ++x) {
+                dst[x - 1] = (L.present && x <= L.width && y <= L.height)
+                    ? remap[L.idx[(size_t)(y - 1) * L.width + (x - 1)]]
+                    : intern(dict, index, getT(li, black));
             }
-        } else {
-            std::cerr << "[Config] Warning: color_to_number.toml not found" << std::endl;
         }
+    }
 
-        fs::path zbPath = CreatePathFromUtf8(config_dir) / "zhenban_qianhou.toml";
-        std::cout << "[Config] Looking for: " << zbPath.string() << " - Exists: " << (fs::exists(zbPath) ? "YES" : "NO") << std::endl;
-        if (fs::exists(zbPath)) {
-            try {
-                std::ifstream file(zbPath, std::ios::binary);
-                if (!file.is_open()) {
-                    std::cerr << "[Config] Failed to open zhenban_qianhou.toml with ifstream" << std::endl;
-                    throw std::runtime_error("Cannot open zhenban_qianhou.toml with ifstream");
-                }
-                std::stringstream buffer;
-                buffer << file.rdbuf();
-                file.close();
-                auto zbTbl = toml::parse(buffer.str(), zbPath.string());
-                if (auto section = zbTbl["zhenban_qianhou"].as_table()) {
-                    for (auto&& [k, value] : *section) {
-                        zhenbanMap[std::string(k.str())] = GetStringFromNode(&value);
-                    }
-                }
-                if (auto signSection = zbTbl["line_sign"].as_table()) {
-                    for (auto&& [k, value] : *signSection) {
-                        if (value.is_array()) {
-                            for (auto&& node : *value.as_array()) signCycles[std::string(k.str())].push_back(GetStringFromNode(&node));
-                        }
-                    }
+    std::unordered_map<std::string, uint8_t> signIndex, zhenbanIndex;
+    auto cycle = cfg.signCycles.find(std::to_string(shaxianTypes));
+    design.rowSign.resize(design.height);
+    for (int y = 1; y <= design.height; ++y) {
+        std::string currentSign = (cycle != cfg.signCycles.end()) ? cycle->second[(y - 1) % cycle->second.size()] : "+";
+        design.rowSign[y - 1] = intern(design.signDict, signIndex, currentSign);
+    }
+    for (const auto& s_id : design.dict[LAYER_SEMA]) {
+        auto zb = cfg.zhenbanMap.find(s_id);
+        design.semaZhenban.push_back(intern(design.zhenbanDict, zhenbanIndex, (zb != cfg.zhenbanMap.end()) ? zb->second : "0"));
+    }
+}
+
+std::string FormatCombinedToml(const CombinedDesign& design, int width, int height) {
+    std::string out;
+    out.reserve((size_t)design.width * design.height * 40 + 128);
+    out += "width = " + std::to_string(width) + "\nheight = " + std::to_string(height) + "\n";
+    out += "shaxian_types = " + std::to_string(design.shaxianTypes) + "\n\ndata = [\n";
+    for (int y = 1; y <= design.height; ++y) {
+        out += "  ";
+        const std::string& currentSign = design.signDict[design.rowSign[y - 1]];
+        std::string ty = std::to_string(y);
+        for (int x = 1; x <= design.width; ++x) {
+            size_t i = (size_t)(y - 1) * design.width + (x - 1);
+            uint8_t s = design.codes[LAYER_SEMA][i];
+            out += "[" + std::to_string(x) + "," + ty + ",\"" + design.dict[LAYER_SEMA][s] + "\",\""
+                + design.dict[LAYER_SHAXIAN][design.codes[LAYER_SHAXIAN][i]] + "\",\""
+                + design.dict[LAYER_LUOLA][design.codes[LAYER_LUOLA][i]] + "\",\""
+                + design.dict[LAYER_DUMU][design.codes[LAYER_DUMU][i]] + "\","
+                + design.zhenbanDict[design.semaZhenban[s]] + ",\"" + currentSign + "\"]";
+            if (!(y == design.height && x == design.width)) out += ", ";
+        }
+        out += "\n";
+    }
+    out += "]";
+    return out;
+}
+
+int CombineLayerDir(const fs::path& layer_dir, const YimaConfig& cfg, bool export_toml) {
+    try {
+        LayerInput layers[LAYER_COUNT];
+        int commonWidth = -1, commonHeight = -1;
+
+        // 1. 读取单体文件 (优先读取 .ylayer 二进制, 不存在时回退到旧版 .toml)
+        for (int li = 0; li < LAYER_COUNT; ++li) {
+            const std::string key = LAYER_NAMES[li];
+            fs::path lpath = layer_dir / (key + ".ylayer");
+            if (fs::exists(lpath)) {
+                YIMA_LOG_INFO("Layer Load") << "Processing: " << lpath.string();
+                YLayerView layer;
+                if (!layer.Open(lpath)) {
+                    YIMA_LOG_ERROR("Layer Load") << "Invalid layer file: " << lpath.string();
+                    return -1;
                 }
-                std::cout << "[Config] Successfully loaded zhenban_qianhou.toml" << std::endl;
-            } catch (const std::exception& e) {
-                std::cerr << "[Config] Error loading zhenban_qianhou.toml: " << e.what() << std::endl;
-                throw;
+                YIMA_LOG_INFO("Layer Load") << "Width=" << layer.width() << ", Height=" << layer.height();
+                LayerGrid grid;
+                grid.width = layer.width();
+                grid.height = layer.height();
+                grid.palette.assign(layer.palette(), layer.palette() + layer.paletteCount());
+                grid.indices.assign(layer.indices(), layer.indices() + (size_t)grid.width * grid.height);
+                layers[li] = MakeLayerInput(key, std::move(grid));
+            } else {
+                fs::path fpath = layer_dir / (key + ".toml");
+                if (!fs::exists(fpath)) continue;
+                YIMA_LOG_INFO("TOML Load") << "Processing: " << fpath.string();
+                layers[li] = LoadLegacyLayerToml(key, fpath);
             }
-        } else {
-            std::cerr << "[Config] Warning: zhenban_qianhou.toml not found" << std::endl;
+            commonWidth = layers[li].width;
+            commonHeight = layers[li].height;
         }
 
-        // 3. 写入 combined.toml
-        fs::path combinedPath = CreatePathFromUtf8(toml_input_dir) / "combined.toml";
-        std::ofstream out(combinedPath.string());
-        out << "width = " << commonWidth << "\nheight = " << commonHeight << "\n";
-        
-        size_t shaxianTypes = 0;
-        if (pixel_lists.count("shaxian")) {
-            std::set<std::string> uniqueShaxian(pixel_lists["shaxian"].begin(), pixel_lists["shaxian"].end());
-            shaxianTypes = uniqueShaxian.size();
+        // 2. 构建列式合并结果并写入 combined.ycomb
+        CombinedDesign design;
+        CombineLayers(layers, cfg, design);
+
+        fs::path binPath = layer_dir / "combined.ycomb";
+        if (!WriteYCombined(binPath, design)) {
+            YIMA_LOG_ERROR("CombineTomlFiles") << "Cannot write " << binPath.string();
+            return -1;
         }
-        out << "shaxian_types = " << shaxianTypes << "\n\ndata = [\n";
-        
-        auto getT = [&](const std::string& key, const std::string& color) {
-            return (colorMap.count(key) && colorMap[key].count(color)) ? colorMap[key][color] : color;
-        };
-
-        std::string signKey = std::to_string(shaxianTypes);
-        for (int y = 1; y <= commonHeight; ++y) {
-            out << "  ";
-            std::string currentSign = (signCycles.count(signKey)) ? signCycles[signKey][(y - 1) % signCycles[signKey].size()] : "+";
-            for (int x = 1; x <= commonWidth; ++x) {
-                const auto& c = dataGrid[y][x];
-                std::string s_id = getT("sema", c.sema);
-                out << "[" << x << "," << y << ",\"" << s_id << "\",\"" << getT("shaxian", c.shaxian) << "\",\"" 
-                    << getT("luola", c.luola) << "\",\"" << getT("dumu", c.dumu) << "\"," 
-                    << ((zhenbanMap.count(s_id)) ? zhenbanMap[s_id] : "0") << ",\"" << currentSign << "\"]";
-                if (!(y == commonHeight && x == commonWidth)) out << ", ";
+        YIMA_LOG_INFO("CombineTomlFiles") << "Successfully wrote combined.ycomb";
+
+        // 3. 按需导出 combined.toml (仅用于人工检查, 后续阶段不再读取)
+        if (export_toml) {
+            fs::path combinedPath = layer_dir / "combined.toml";
+            std::ofstream out(combinedPath);
+            out << FormatCombinedToml(design, commonWidth, commonHeight);
+            out.close();
+            if (!out) {
+                YIMA_LOG_ERROR("CombineTomlFiles") << "Cannot write " << combinedPath.string();
+                return -1;
             }
-            out << "\n";
+            YIMA_LOG_INFO("CombineTomlFiles") << "Successfully wrote combined.toml";
         }
-        out << "]";
-        std::cout << "[CombineTomlFiles] Successfully wrote combined.toml" << std::endl;
         return 0;
     } catch (const std::exception& e) { 
-        std::cerr << "[CombineTomlFiles] Exception: " << e.what() << std::endl;
+        YIMA_LOG_ERROR("CombineTomlFiles") << "Exception: " << e.what();
         return -3;
     } catch (...) { 
-        std::cerr << "[CombineTomlFiles] Unknown exception" << std::endl;
+        YIMA_LOG_ERROR("CombineTomlFiles") << "Unknown exception";
+        return -3;
+    }
+}
+
+YIMA_API int CombineTomlFilesEx(const char* toml_input_dir, const char* config_dir, int export_toml) {
+    try {
+        // 加载配置
+        YimaConfig cfg;
+        LoadColorConfig(CreatePathFromUtf8(config_dir), cfg);
+        return CombineLayerDir(CreatePathFromUtf8(toml_input_dir), cfg, export_toml != 0);
+    } catch (const std::exception& e) {
+        YIMA_LOG_ERROR("CombineTomlFiles") << "Exception: " << e.what();
         return -3;
     }
-}
\ No newline at end of file
+}
+
+YIMA_API int CombineTomlFiles(const char* toml_input_dir, const char* /*csv_output_dir*/, const char* config_dir) {
+    return CombineTomlFilesEx(toml_input_dir, config_dir, 1);
+}
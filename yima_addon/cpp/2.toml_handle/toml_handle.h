@@ -2,17 +2,52 @@
 #define TOML_HANDLE_H
 
 #include "../yima_common.h"
+#include "../ylayer_format.h"
+#include "../ycombined_format.h"
+#include "../yima_config.h"
 #include <string>
+#include <vector>
+#include <filesystem>
+
+// 阶段 2 的单个图层输入: 颜色字典 + 每像素颜色索引 (行主序, 第 0 行对应 y = 1)
+struct LayerInput {
+    bool present = false;
+    int width = 0, height = 0;
+    std::vector<std::string> colors;
+    std::vector<std::string> allPixels;   // 参与 shaxian_types 统计的颜色列表
+    std::vector<uint8_t> idx;
+};
+
+// 由解码后的图层构建阶段 2 输入 (像素索引被移动, 不做拷贝)
+LayerInput MakeLayerInput(const std::string& key, LayerGrid&& grid);
+
+// 图层颜色经 color_to_number.toml 映射后的码值, 未配置时即颜色本身
+const std::string& MapLayerColor(const YimaConfig& cfg, int layer, const std::string& color);
+
+// 合并四个图层 (顺序为 sema/shaxian/luola/dumu), 数据错误时抛出异常
+void CombineLayers(const LayerInput layers[LAYER_COUNT], const YimaConfig& cfg, CombinedDesign& out);
+
+// 将合并结果格式化为旧版 combined.toml 文本
+std::string FormatCombinedToml(const CombinedDesign& design, int width, int height);
+
+// 使用已加载的配置合并 layer_dir 中的图层并写出 combined.ycomb, 返回值同 CombineTomlFilesEx
+int CombineLayerDir(const std::filesystem::path& layer_dir, const YimaConfig& cfg, bool export_toml);
 
 extern "C" {
     /**
-     * @brief 合并指定的四个 TOML 文件
-     * @param toml_input_dir 输入 TOML 文件夹路径
-     * @param csv_output_dir CSV 输出文件夹路径
+     * @brief 合并 sema/shaxian/luola/dumu 四个图层 (.ylayer 优先, 兼容旧版 .toml)
+     * @param toml_input_dir 图层文件夹路径
      * @param config_dir 配置文件夹路径
-     * @return 0: 成功, -1: 文件读取失败, -2: 宽高不一致, -3: 数据格式错误
+     * @param export_toml 非 0 时额外导出 combined.toml 供人工检查 (后续阶段只读取 combined.ycomb)
+     * @return 0: 成功, -1: 文件读写失败, -2: 宽高不一致, -3: 数据格式错误
+     */
+    YIMA_API int CombineTomlFilesEx(const char* toml_input_dir, const char* config_dir, int export_toml);
+
+    /**
+     * @brief 旧版入口: 与 CombineTomlFilesEx(toml_input_dir, config_dir, 1) 相同, 仍导出 combined.toml
+     * @param csv_output_dir 未使用, 保留以兼容原有调用方
      */
     YIMA_API int CombineTomlFiles(const char* toml_input_dir, const char* csv_output_dir, const char* config_dir);
 }
 
-#endif // TOML_HANDLE_H
\ No newline at end of file
+#endif // TOML_HANDLE_H
@@ -7,84 +7,55 @@
  * @Description: 这是默认设置,请设置`customMade`, 打开koroFileHeader查看配置 进行设置: https://github.com/OBKoro1/koro1FileHeader/wiki/%E9%85%8D%E7%BD%AE
  */
 #include "data_csv_handle.h"
-#include "../toml.hpp"
 #include "../encoding_utils.h"
+#include "../ycombined_format.h"
+#include "../yima_log.h"
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <map>
 #include <string>
-#include <iostream>
 #include <filesystem>
 
 namespace fs = std::filesystem;
 
-struct FullPixelData {
-    std::string sema, shaxian, luola, dumu, zhenban, sign;
-};
-
-std::string GetValue(const toml::node* n) {
-    if (!n) return "";
-    if (auto s = n->as_string()) return std::string(s->get());
-    if (auto i = n->as_integer()) return std::to_string(i->get());
-    return "";
-}
-
 YIMA_API int GenerateDataCsv(const char* toml_input_dir, const char* csv_output_dir) {
     try {
-        std::cout << "[Step 3] Starting GenerateDataCsv" << std::endl;
+        YIMA_LOG_INFO("Step 3") << "Starting GenerateDataCsv";
         // Create fs::paths from UTF-8 strings with proper encoding handling
         fs::path csvDir = CreatePathFromUtf8(csv_output_dir);
         fs::path toml_input = CreatePathFromUtf8(toml_input_dir);
         
-        std::cout << "[Step 3] CSV output directory: " << csvDir.string() << std::endl;
-        std::cout << "[Step 3] TOML input directory: " << toml_input.string() << std::endl;
+        YIMA_LOG_INFO("Step 3") << "CSV output directory: " << csvDir.string();
+        YIMA_LOG_INFO("Step 3") << "TOML input directory: " << toml_input.string();
         
         if (!fs::exists(csvDir)) {
-            std::cout << "[Step 3] Creating CSV directory" << std::endl;
+            YIMA_LOG_INFO("Step 3") << "Creating CSV directory";
             fs::create_directories(csvDir);
         }
         
-        fs::path combinedPath = toml_input / "combined.toml";
-        std::cout << "[Step 3] Looking for combined.toml: " << combinedPath.string() << " - Exists: " << (fs::exists(combinedPath) ? "YES" : "NO") << std::endl;
+        fs::path combinedPath = toml_input / "combined.ycomb";
+        YIMA_LOG_INFO("Step 3") << "Looking for combined.ycomb: " << combinedPath.string() << " - Exists: " << (fs::exists(combinedPath) ? "YES" : "NO");
         if (!fs::exists(combinedPath)) {
-            std::cerr << "[Step 3] Error: combined.toml not found" << std::endl;
+            YIMA_LOG_ERROR("Step 3") << "combined.ycomb not found";
             return -1;
         }
 
-        std::cout << "[Step 3] Parsing combined.toml" << std::endl;
-        std::ifstream file(combinedPath, std::ios::binary);
-        if (!file.is_open()) {
-            std::cerr << "[Step 3] Error: Cannot open combined.toml with ifstream" << std::endl;
+        YIMA_LOG_INFO("Step 3") << "Mapping combined.ycomb";
+        YCombinedView grid;
+        if (!grid.Open(combinedPath)) {
+            YIMA_LOG_ERROR("Step 3") << "Cannot map combined.ycomb";
             return -1;
         }
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        file.close();
-        auto config = toml::parse(buffer.str(), combinedPath.string());
-        
-        int width = (int)config["width"].as_integer()->get();
-        int height = (int)config["height"].as_integer()->get();
-        std::cout << "[Step 3] Parsed dimensions: width=" << width << ", height=" << height << std::endl;
-        
-        auto data_arr = config["data"].as_array();
-        std::cout << "[Step 3] Data array size: " << data_arr->size() << std::endl;
-
-        std::map<int, std::map<int, FullPixelData>> grid;
-        for (auto&& row_node : *data_arr) {
-            auto row = row_node.as_array();
-            int x = (int)row->get(0)->as_integer()->get();
-            int y = (int)row->get(1)->as_integer()->get();
-            grid[y][x] = { GetValue(row->get(2)), GetValue(row->get(3)), GetValue(row->get(4)), 
-                           GetValue(row->get(5)), GetValue(row->get(6)), GetValue(row->get(7)) };
-        }
-        std::cout << "[Step 3] Grid populated successfully" << std::endl;
+        int width = grid.width();
+        int height = grid.height();
+        YIMA_LOG_INFO("Step 3") << "Parsed dimensions: width=" << width << ", height=" << height;
 
         fs::path csvPath = csvDir / "pixel_data.csv";
-        std::cout << "[Step 3] Writing CSV to: " << csvPath.string() << std::endl;
+        YIMA_LOG_INFO("Step 3") << "Writing CSV to: " << csvPath.string();
         std::ofstream csv(csvPath);
         if (!csv.is_open()) {
-            std::cerr << "[Step 3] Error: Cannot open CSV file for writing" << std::endl;
+            YIMA_LOG_ERROR("Step 3") << "Cannot open CSV file for writing";
             return -1;
         }
         const unsigned char BOM[] = {0xEF, 0xBB, 0xBF};
@@ -100,7 +71,7 @@ YIMA_API int GenerateDataCsv(const char* toml_input_dir, const char* csv_output_
             else { for (int x = 1; x <= width; ++x) x_order.push_back(x); }
 
             for (int x : x_order) {
-                const auto& d = grid[y][x];
+                const CombinedPixel d = grid.Pixel(x, y);
                 if (!last_shaxian.empty() && d.shaxian != last_shaxian) {
                     csv << ",,,," << last_sign + last_shaxian + d.shaxian << ",,,," << last_sign << ",,,shaxian_switch\n";
                 }
@@ -110,18 +81,18 @@ YIMA_API int GenerateDataCsv(const char* toml_input_dir, const char* csv_output_
                 last_shaxian = d.shaxian; last_zhenban = d.zhenban; last_sign = d.sign;
             }
             if (y < height) {
-                std::string next_sx = ( (y+1) % 2 != 0 ) ? grid[y+1][width].shaxian : grid[y+1][1].shaxian;
-                csv << ",,,," << last_sign + grid[y][x_order.back()].shaxian + next_sx << "," << grid[y][x_order.back()].luola << ",,," << last_sign << ",,,line_switch\n";
+                const std::string& next_sx = ( (y+1) % 2 != 0 ) ? grid.Code(LAYER_SHAXIAN, width, y+1) : grid.Code(LAYER_SHAXIAN, 1, y+1);
+                csv << ",,,," << last_sign + grid.Code(LAYER_SHAXIAN, x_order.back(), y) + next_sx << "," << grid.Code(LAYER_LUOLA, x_order.back(), y) << ",,," << last_sign << ",,,line_switch\n";
             }
         }
         csv.close();
-        std::cout << "[Step 3] Successfully generated pixel_data.csv" << std::endl;
+        YIMA_LOG_INFO("Step 3") << "Successfully generated pixel_data.csv";
         return 0;
     } catch (const std::exception& e) {
-        std::cerr << "[Step 3] Exception: " << e.what() << std::endl;
+        YIMA_LOG_ERROR("Step 3") << "Exception: " << e.what();
         return -3;
     } catch (...) {
-        std::cerr << "[Step 3] Unknown exception" << std::endl;
+        YIMA_LOG_ERROR("Step 3") << "Unknown exception";
         return -3;
     }
 }
\ No newline at end of file
@@ -5,7 +5,7 @@
 
 extern "C" {
     /**
-     * @brief 根据 combined.toml 生成数据 CSV
+     * @brief 根据 combined.ycomb 生成数据 CSV
      * @param toml_input_dir TOML 文件夹路径
      * @param csv_output_dir CSV 输出文件夹路径
      * @return 0: 成功, -1: 文件读取失败
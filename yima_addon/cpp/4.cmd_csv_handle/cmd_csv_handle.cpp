@@ -1,123 +1,119 @@
 #include "cmd_csv_handle.h"
-#include "../toml.hpp"
 #include "../encoding_utils.h"
+#include "../yima_log.h"
+#include "../yima_trace.h"
+#include "../yima_probes.h"
 #include <fstream>
 #include <sstream>
 #include <vector>
-#include <map>
 #include <string>
 #include <filesystem>
-#include <iostream>
+#include <algorithm>
 
 namespace fs = std::filesystem;
 
-// 辅助函数：安全提取字符串内容
-std::string GetV(const toml::node* n) {
-    if (!n) return "";
-    if (auto s = n->as_string()) return std::string(s->get());
-    if (auto i = n->as_integer()) return std::to_string(i->get());
-    return "";
+CmdWalkState CmdEntryState(const YCombinedView& grid, int y) {
+    CmdWalkState st;
+    if (y <= 1) return st;
+    // 上一行的最后一个像素: 奇数行从右向左走到 x = 1, 偶数行走到 x = width
+    int x = ((y - 1) % 2 != 0) ? 1 : grid.width();
+    const CombinedPixel d = grid.Pixel(x, y - 1);
+    st.last_shaxian = d.shaxian;
+    st.last_zhenban = d.zhenban;
+    st.last_sign = d.sign;
+    st.idx = (y - 1) * grid.width() + 1;
+    return st;
 }
 
-YIMA_API int GenerateCmdCsv(const char* toml_input_dir, const char* csv_output_dir, const char* config_dir) {
-    try {
-        std::cout << "[Step 4] Starting GenerateCmdCsv" << std::endl;
+void WalkCmdRow(const YCombinedView& grid, const YimaConfig& cfg, int y, CmdWalkState& st, CmdRowSink& sink) {
+    int width = grid.width();
+    int height = grid.height();
+    std::string& last_shaxian = st.last_shaxian;
+    std::string& last_zhenban = st.last_zhenban;
+    std::string& last_sign = st.last_sign;
+
+    std::vector<int> x_order;
+    if (y % 2 != 0) { for (int x = width; x >= 1; --x) x_order.push_back(x); }
+    else { for (int x = 1; x <= width; ++x) x_order.push_back(x); }
+
+    for (int x : x_order) {
+        const CombinedPixel d = grid.Pixel(x, y);
         
-        #ifdef _WIN32
-        fs::path combinedPath = fs::path(Utf8ToWide(toml_input_dir)) / "combined.toml";
-        #else
-        fs::path combinedPath = fs::path(toml_input_dir) / "combined.toml";
-        #endif
-        std::cout << "[Step 4] Looking for combined.toml: " << combinedPath.string() << " - Exists: " << (fs::exists(combinedPath) ? "YES" : "NO") << std::endl;
-        if (!fs::exists(combinedPath)) {
-            std::cerr << "[Step 4] Error: combined.toml not found" << std::endl;
-            return -1;
+        // shaxian_switch 逻辑
+        if (!last_shaxian.empty() && d.shaxian != last_shaxian) {
+            sink.ShaxianSwitchRow(cfg.Cmd(CMD_SHAXIAN_SWITCH, last_sign + last_shaxian + d.shaxian));
         }
+        
+        std::string pa = last_sign + last_zhenban + d.zhenban;
+        sink.PixelRow(st.idx++, cfg.Cmd(CMD_PRE, pa), cfg.Cmd(CMD_DUMU, d.dumu),
+                      cfg.Cmd(CMD_SEMA, d.sign + d.sema), cfg.Cmd(CMD_POST, pa));
+        
+        last_shaxian = d.shaxian; last_zhenban = d.zhenban; last_sign = d.sign;
+    }
+    
+    // line_switch 逻辑
+    if (y < height) {
+        const std::string& cur_luola = grid.Code(LAYER_LUOLA, x_order.back(), y);
+        const std::string& next_sx = ( (y+1) % 2 != 0 ) ? grid.Code(LAYER_SHAXIAN, width, y+1) : grid.Code(LAYER_SHAXIAN, 1, y+1);
+        std::string ls_key = last_sign + grid.Code(LAYER_SHAXIAN, x_order.back(), y) + next_sx;
+        sink.LineSwitchRow(cfg.Cmd(CMD_LUOLA, cur_luola), cfg.Cmd(CMD_LINE_SWITCH, ls_key));
+    }
+    YIMA_PROBE2(row, y, width);
+}
 
-        // 存储所有映射表
-        std::map<std::string, std::map<std::string, std::string>> maps;
+// 追踪时每个 span 覆盖的行数
+static const int TRACE_ROW_CHUNK = 64;
 
-        // 统一 Lambda 名称为 load_config
-        auto load_config = [&](std::string p, std::string s, std::string key) {
-            std::cout << "[Step 4] Loading config: " << p << " section: " << s << " key: " << key << std::endl;
-            if (fs::exists(p)) {
-                try {
-                    std::ifstream file(p, std::ios::binary);
-                    if (!file.is_open()) {
-                        std::cerr << "[Step 4] Error: Cannot open " << p << " with ifstream" << std::endl;
-                        return;
-                    }
-                    std::stringstream buffer;
-                    buffer << file.rdbuf();
-                    file.close();
-                    auto tbl = toml::parse(buffer.str(), p);
-                    if (auto sect = tbl[s].as_table()) {
-                        for (auto&& [k, v] : *sect) { 
-                            maps[key][std::string(k.str())] = GetV(&v);
-                            std::cout << "[Step 4] Loaded mapping: " << key << "[" << std::string(k.str()) << "]" << std::endl;
-                        }
-                    }
-                    std::cout << "[Step 4] Successfully loaded: " << p << std::endl;
-                } catch (const std::exception& e) {
-                    std::cerr << "[Step 4] Parse error in " << p << ": " << e.what() << std::endl;
-                }
-            } else {
-                std::cerr << "[Step 4] Warning: File not found: " << p << std::endl;
-            }
-        };
+void WalkCmdRows(const YCombinedView& grid, const YimaConfig& cfg, CmdRowSink& sink) {
+    CmdWalkState st;
+    const int H = grid.height();
+    for (int y0 = 1; y0 <= H; y0 += TRACE_ROW_CHUNK) {
+        const int y1 = std::min(H, y0 + TRACE_ROW_CHUNK - 1);
+        TraceSpan span("rows", "cmd");
+        span.Arg("first", y0);
+        span.Arg("count", y1 - y0 + 1);
+        for (int y = y0; y <= y1; ++y) WalkCmdRow(grid, cfg, y, st, sink);
+    }
+}
 
-        // 加载所有配置文件
-        #ifdef _WIN32
-        fs::path cfgDir = fs::path(Utf8ToWide(config_dir));
-        #else
-        fs::path cfgDir = fs::path(config_dir);
-        #endif
-        std::cout << "[Step 4] Config directory: " << cfgDir.string() << std::endl;
-        load_config((cfgDir / "dumu_to_cmd.toml").string(), "dumu", "dumu");
-        load_config((cfgDir / "pre_action_to_cmd.toml").string(), "pre_action", "pre");
-        load_config((cfgDir / "post_action_to_cmd.toml").string(), "post_action", "post");
-        load_config((cfgDir / "sema_to_cmd.toml").string(), "sema", "sema");
-        load_config((cfgDir / "luola_to_cmd.toml").string(), "luola", "luola");
-        load_config((cfgDir / "line_switch_to_cmd.toml").string(), "line_switch", "ls");
-        load_config((cfgDir / "shaxian_switch_to_cmd.toml").string(), "shaxian_switch", "ss");
+void CsvRowSink::PixelRow(int index, const std::string& pre, const std::string& dumu,
+                          const std::string& sema, const std::string& post) {
+    csv_ << index << ",\"" << pre << "\",\"" << dumu << "\",\"" << sema << "\",\"" << post << "\",,,\n";
+}
+
+void CsvRowSink::ShaxianSwitchRow(const std::string& cmd) {
+    csv_ << ",,,,,,,\"" << cmd << "\"\n";
+}
+
+void CsvRowSink::LineSwitchRow(const std::string& luola, const std::string& lineSwitch) {
+    csv_ << ",,,,,\"" << luola << "\",\"" << lineSwitch << "\",\n";
+}
 
-        // 解析 combined.toml
-        std::cout << "[Step 4] Parsing combined.toml" << std::endl;
-        std::ifstream file(combinedPath, std::ios::binary);
-        if (!file.is_open()) {
-            std::cerr << "[Step 4] Error: Cannot open combined.toml with ifstream" << std::endl;
+int WriteCmdCsv(const fs::path& layer_dir, const fs::path& csv_dir, const YimaConfig& cfg) {
+    try {
+        YIMA_LOG_INFO("Step 4") << "Starting GenerateCmdCsv";
+        
+        fs::path combinedPath = layer_dir / "combined.ycomb";
+        YIMA_LOG_INFO("Step 4") << "Looking for combined.ycomb: " << combinedPath.string() << " - Exists: " << (fs::exists(combinedPath) ? "YES" : "NO");
+        if (!fs::exists(combinedPath)) {
+            YIMA_LOG_ERROR("Step 4") << "combined.ycomb not found";
             return -1;
         }
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        file.close();
-        auto config = toml::parse(buffer.str(), combinedPath.string());
-        
-        int width = (int)config["width"].as_integer()->get();
-        int height = (int)config["height"].as_integer()->get();
-        std::cout << "[Step 4] Parsed dimensions: width=" << width << ", height=" << height << std::endl;
-        auto data_arr = config["data"].as_array();
-        std::cout << "[Step 4] Data array size: " << data_arr->size() << std::endl;
 
-        struct PD { std::string sema, shaxian, luola, dumu, zhenban, sign; };
-        std::map<int, std::map<int, PD>> grid;
-        for (auto&& r_n : *data_arr) {
-            auto r = r_n.as_array();
-            grid[(int)r->get(1)->as_integer()->get()][(int)r->get(0)->as_integer()->get()] = 
-                { GetV(r->get(2)), GetV(r->get(3)), GetV(r->get(4)), GetV(r->get(5)), GetV(r->get(6)), GetV(r->get(7)) };
+        // 映射 combined.ycomb
+        YIMA_LOG_INFO("Step 4") << "Mapping combined.ycomb";
+        YCombinedView grid;
+        if (!grid.Open(combinedPath)) {
+            YIMA_LOG_ERROR("Step 4") << "Cannot map combined.ycomb";
+            return -1;
         }
-        std::cout << "[Step 4] Grid populated successfully" << std::endl;
+        YIMA_LOG_INFO("Step 4") << "Parsed dimensions: width=" << grid.width() << ", height=" << grid.height();
 
-        #ifdef _WIN32
-        fs::path csv_out_dir = fs::path(Utf8ToWide(csv_output_dir));
-        #else
-        fs::path csv_out_dir = fs::path(csv_output_dir);
-        #endif
-        
-        std::cout << "[Step 4] Writing CSV to: " << (csv_out_dir / "pixel_cmd.csv").string() << std::endl;
-        std::ofstream csv(csv_out_dir / "pixel_cmd.csv");
+        fs::path csvPath = csv_dir / "pixel_cmd.csv";
+        YIMA_LOG_INFO("Step 4") << "Writing CSV to: " << csvPath.string();
+        std::ofstream csv(csvPath);
         if (!csv.is_open()) {
-            std::cerr << "[Step 4] Error: Cannot open pixel_cmd.csv for writing" << std::endl;
+            YIMA_LOG_ERROR("Step 4") << "Cannot open pixel_cmd.csv for writing";
             return -1;
         }
         const unsigned char BOM[] = {0xEF, 0xBB, 0xBF};
@@ -125,45 +121,28 @@ YIMA_API int GenerateCmdCsv(const char* toml_input_dir, const char* csv_output_d
         // 表头：8 列结构
         csv << "INDEX,PRE_ACTION_CMD,DUMU_CMD,SEMA_CMD,POST_ACTION_CMD,LUOLA_CMD,LINE_SWITCH_CMD,SHAXIAN_SWITCH_CMD\n";
 
-        int idx = 1;
-        std::string last_shaxian = "", last_zhenban = "1", last_sign = "+";
-
-        for (int y = 1; y <= height; ++y) {
-            std::vector<int> x_order;
-            if (y % 2 != 0) { for (int x = width; x >= 1; --x) x_order.push_back(x); }
-            else { for (int x = 1; x <= width; ++x) x_order.push_back(x); }
-
-            for (int x : x_order) {
-                const auto& d = grid[y][x];
-                
-                // shaxian_switch 逻辑
-                if (!last_shaxian.empty() && d.shaxian != last_shaxian) {
-                    csv << ",,,,,,,\"" << maps["ss"][last_sign + last_shaxian + d.shaxian] << "\"\n";
-                }
-                
-                std::string pa = last_sign + last_zhenban + d.zhenban;
-                csv << idx++ << ",\"" << maps["pre"][pa] << "\",\"" << maps["dumu"][d.dumu] << "\",\"" 
-                    << maps["sema"][d.sign + d.sema] << "\",\"" << maps["post"][pa] << "\",,,\n";
-                
-                last_shaxian = d.shaxian; last_zhenban = d.zhenban; last_sign = d.sign;
-            }
-            
-            // line_switch 逻辑
-            if (y < height) {
-                std::string cur_luola = grid[y][x_order.back()].luola;
-                std::string next_sx = ( (y+1) % 2 != 0 ) ? grid[y+1][width].shaxian : grid[y+1][1].shaxian;
-                std::string ls_key = last_sign + grid[y][x_order.back()].shaxian + next_sx;
-                csv << ",,,,,\"" << maps["luola"][cur_luola] << "\",\"" << maps["ls"][ls_key] << "\",\n";
-            }
-        }
+        CsvRowSink sink(csv);
+        WalkCmdRows(grid, cfg, sink);
         csv.close();
-        std::cout << "[Step 4] Successfully generated pixel_cmd.csv" << std::endl;
+        YIMA_LOG_INFO("Step 4") << "Successfully generated pixel_cmd.csv";
         return 0;
     } catch (const std::exception& e) {
-        std::cerr << "[Step 4] Exception: " << e.what() << std::endl;
+        YIMA_LOG_ERROR("Step 4") << "Exception: " << e.what();
         return -4;
     } catch (...) {
-        std::cerr << "[Step 4] Unknown exception" << std::endl;
+        YIMA_LOG_ERROR("Step 4") << "Unknown exception";
         return -4;
     }
-}
\ No newline at end of file
+}
+
+YIMA_API int GenerateCmdCsv(const char* toml_input_dir, const char* csv_output_dir, const char* config_dir) {
+    try {
+        // 加载所有配置文件
+        YimaConfig cfg;
+        LoadCmdConfig(CreatePathFromUtf8(config_dir), cfg);
+        return WriteCmdCsv(CreatePathFromUtf8(toml_input_dir), CreatePathFromUtf8(csv_output_dir), cfg);
+    } catch (const std::exception& e) {
+        YIMA_LOG_ERROR("Step 4") << "Exception: " << e.what();
+        return -4;
+    }
+}
@@ -2,10 +2,62 @@
 #define CMD_CSV_HANDLE_H
 
 #include "../yima_common.h"
+#include "../ycombined_format.h"
+#include "../yima_config.h"
+#include <string>
+#include <ostream>
+#include <filesystem>
+
+// 阶段 4 的逐行回调: 每次调用对应 pixel_cmd.csv 中的一行
+class CmdRowSink {
+public:
+    virtual ~CmdRowSink() = default;
+    // 像素行: PRE_ACTION_CMD, DUMU_CMD, SEMA_CMD, POST_ACTION_CMD
+    virtual void PixelRow(int index, const std::string& pre, const std::string& dumu,
+                          const std::string& sema, const std::string& post) = 0;
+    // 换纱线行: SHAXIAN_SWITCH_CMD
+    virtual void ShaxianSwitchRow(const std::string& cmd) = 0;
+    // 换行: LUOLA_CMD, LINE_SWITCH_CMD
+    virtual void LineSwitchRow(const std::string& luola, const std::string& lineSwitch) = 0;
+};
+
+// 写出 pixel_cmd.csv 的数据行 (8 列结构, 指令块用引号包裹)
+class CsvRowSink : public CmdRowSink {
+public:
+    explicit CsvRowSink(std::ostream& csv) : csv_(csv) {}
+    void PixelRow(int index, const std::string& pre, const std::string& dumu,
+                  const std::string& sema, const std::string& post) override;
+    void ShaxianSwitchRow(const std::string& cmd) override;
+    void LineSwitchRow(const std::string& luola, const std::string& lineSwitch) override;
+
+private:
+    std::ostream& csv_;
+};
+
+// 遍历过程中跨行传递的状态: 上一个像素的 shaxian/zhenban/sign 以及下一个像素序号
+struct CmdWalkState {
+    std::string last_shaxian;
+    std::string last_zhenban = "1";
+    std::string last_sign = "+";
+    int idx = 1;
+};
+
+// 第 y 行开始时的遍历状态 (由上一行最后一个像素直接得出, 无需从头遍历)
+CmdWalkState CmdEntryState(const YCombinedView& grid, int y);
+
+// 遍历第 y 行 (含行末的换行指令), 并更新 st
+void WalkCmdRow(const YCombinedView& grid, const YimaConfig& cfg, int y, CmdWalkState& st, CmdRowSink& sink);
+
+// 按机器编织顺序 (奇数行从右向左, 偶数行从左向右) 遍历合并结果并查表得到指令块
+void WalkCmdRows(const YCombinedView& grid, const YimaConfig& cfg, CmdRowSink& sink);
+
+// 使用已加载的配置, 由 layer_dir/combined.ycomb 生成 csv_dir/pixel_cmd.csv
+// @return 0: 成功, -1: 文件读取失败, -4: 异常
+int WriteCmdCsv(const std::filesystem::path& layer_dir, const std::filesystem::path& csv_dir, const YimaConfig& cfg);
 
 extern "C" {
     /**
-     * @brief 根据 combined.toml 和配置文件生成命令 CSV
+     * @brief 根据 combined.ycomb 和配置文件生成命令 CSV
      * @param toml_input_dir TOML 文件夹路径
      * @param csv_output_dir CSV 输出文件夹路径
      * @param config_dir 配置文件夹路径
@@ -13,4 +65,4 @@ extern "C" {
      */
     YIMA_API int GenerateCmdCsv(const char* toml_input_dir, const char* csv_output_dir, const char* config_dir);
 }
-#endif
\ No newline at end of file
+#endif
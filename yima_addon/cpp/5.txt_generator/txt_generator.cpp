@@ -1,6 +1,6 @@
 #include "txt_generator.h"
-#include "../toml.hpp"
 #include "../encoding_utils.h"
+#include "../program_optimize.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -55,53 +55,91 @@ std::vector<std::vector<std::string>> ParsePixelCmdCsv(const std::string& path)
 
 // 辅助函数：修剪字符串首尾的空白字符和换行符
 std::string TrimCmd(const std::string& s) {
-    auto first = s.find_first_not_of(" \t\n\r");
-    if (first == std::string::npos) return "";
-    auto last = s.find_last_not_of(" \t\n\r");
-    return s.substr(first, last - first + 1);
+    return std::string(TrimCmdView(s));
 }
 
-YIMA_API int GenerateRawTxt(const char* csv_input_dir, const char* txt_output_dir, const char* config_dir) {
+void SimpleProgramSink::PixelRow(int, const std::string& pre, const std::string& dumu,
+                                 const std::string& sema, const std::string& post) {
+    Append(pre); Append(dumu); Append(sema); Append(post);
+}
+
+void SimpleProgramSink::LineSwitchRow(const std::string& luola, const std::string& lineSwitch) {
+    Append(luola); Append(lineSwitch);
+}
+
+void SimpleProgramSink::Append(const std::string& cmd) {
+    std::string_view cleaned = TrimCmdView(cmd);
+    if (cleaned.empty()) return;
+    out_.append(cleaned.data(), cleaned.size());
+    out_ += '\n';
+}
+
+void ProgramTxtSink::PixelRow(int index, const std::string& pre, const std::string& dumu,
+                              const std::string& sema, const std::string& post) {
+    std::string idx = std::to_string(index);
+    Append(idx, "", "PRE_ACTION_CMD", pre);
+    Append(idx, "", "DUMU_CMD", dumu);
+    Append(idx, "", "SEMA_CMD", sema);
+    Append(idx, "", "POST_ACTION_CMD", post);
+}
+
+void ProgramTxtSink::ShaxianSwitchRow(const std::string& cmd) {
+    Append("CONTROL_LINE", "[SHAXIAN_SWITCH] ", "SHAXIAN_SWITCH_CMD", cmd);
+}
+
+void ProgramTxtSink::LineSwitchRow(const std::string& luola, const std::string& lineSwitch) {
+    Append("CONTROL_LINE", "", "LUOLA_CMD", luola);
+    Append("CONTROL_LINE", "[LINE_SWITCH] ", "LINE_SWITCH_CMD", lineSwitch);
+}
+
+void ProgramTxtSink::Append(const std::string& index, const char* tag, const char* label, const std::string& cmd) {
+    std::string_view cleaned = TrimCmdView(cmd);
+    if (cleaned.empty()) return;
+    raw_ += "# INDEX: ";
+    raw_ += index;
+    raw_ += ", Source: ";
+    raw_ += tag;
+    raw_ += label;
+    raw_ += '\n';
+    raw_.append(cleaned.data(), cleaned.size());
+    raw_ += '\n';
+    simple_.append(cleaned.data(), cleaned.size());
+    simple_ += '\n';
+}
+
+void AppendProgramHead(const YimaConfig& cfg, std::string& raw, std::string& simple) {
+    if (cfg.headCmd.empty()) return;
+    raw += "# [HEAD START]\n" + cfg.headCmd + "\n# [HEAD END]\n\n";
+    simple += cfg.headCmd + "\n";
+}
+
+void AppendProgramTail(const YimaConfig& cfg, std::string& raw, std::string& simple) {
+    if (cfg.tailCmd.empty()) return;
+    raw += "\n# [TAIL START]\n" + cfg.tailCmd + "\n# [TAIL END]\n";
+    simple += cfg.tailCmd + "\n";
+}
+
+bool ProgramTxtMatchesCsv(const YimaConfig& cfg) {
+    for (const auto& table : cfg.cmdMaps) {
+        for (const auto& kv : table) if (kv.second.find('"') != std::string::npos) return false;
+    }
+    return true;
+}
+
+std::string GenerateSimpleProgram(const YCombinedView& grid, const YimaConfig& cfg) {
+    std::string out;
+    out.reserve((size_t)grid.width() * grid.height() * 64);
+    if (!cfg.headCmd.empty()) out += cfg.headCmd + "\n";
+    SimpleProgramSink sink(out);
+    WalkCmdRows(grid, cfg, sink);
+    if (!cfg.tailCmd.empty()) out += cfg.tailCmd + "\n";
+    return out;
+}
+
+int WriteRawTxt(const fs::path& csvInputDir, const fs::path& txtDir, const YimaConfig& cfg, unsigned optimize) {
     try {
-        #ifdef _WIN32
-        fs::path txtDir = fs::path(Utf8ToWide(txt_output_dir));
-        fs::path csvInputDir = fs::path(Utf8ToWide(csv_input_dir));
-        #else
-        fs::path txtDir = fs::path(txt_output_dir);
-        fs::path csvInputDir = fs::path(csv_input_dir);
-        #endif
-        
         if (!fs::exists(txtDir)) fs::create_directories(txtDir);
         
-        // --- 1. 加载 head_tail_cmd.toml 配置 ---
-        std::string head_cmd = "";
-        std::string tail_cmd = "";
-        #ifdef _WIN32
-        fs::path configPath = fs::path(Utf8ToWide(config_dir)) / "head_tail_cmd.toml";
-        #else
-        fs::path configPath = fs::path(config_dir) / "head_tail_cmd.toml";
-        #endif
-        
-        if (fs::exists(configPath)) {
-            try {
-                std::ifstream file(configPath, std::ios::binary);
-                if (!file.is_open()) {
-                    std::cerr << "[Step 5] Error: Cannot open head_tail_cmd.toml with ifstream" << std::endl;
-                } else {
-                    std::stringstream buffer;
-                    buffer << file.rdbuf();
-                    file.close();
-                    auto tbl = toml::parse(buffer.str(), configPath.string());
-                    if (auto section = tbl["head_tail_cmd"].as_table()) {
-                        if (auto h = section->get("head")) head_cmd = TrimCmd(h->as_string()->get());
-                        if (auto t = section->get("tail")) tail_cmd = TrimCmd(t->as_string()->get());
-                    }
-                }
-            } catch (const std::exception& e) {
-                std::cerr << "[Step 5] Exception loading head_tail_cmd.toml: " << e.what() << std::endl;
-            }
-        }
-
         fs::path csvPath = csvInputDir / "pixel_cmd.csv";
         if (!fs::exists(csvPath)) return -1;
 
@@ -115,10 +153,25 @@ YIMA_API int GenerateRawTxt(const char* csv_input_dir, const char* txt_output_di
         std::ofstream simpleFile(simplePath.string(), std::ios::binary); // 纯指令
         if (!rawFile.is_open() || !simpleFile.is_open()) return -2;
 
+        // 纯指令经优化遍后写出 (optimize 为 0 时原样写出)
+        ProgramOptimizer optimizer(optimize);
+        std::string optimized;
+        auto writeSimple = [&](const std::string& text) {
+            if (!optimize) {
+                simpleFile << text;
+                return;
+            }
+            optimizer.Push(text, optimized);
+            simpleFile << optimized;
+            optimized.clear();
+        };
+
         // --- 3. 写入头部命令 ---
-        if (!head_cmd.empty()) {
-            rawFile << "# [HEAD START]\n" << head_cmd << "\n# [HEAD END]\n\n";
-            simpleFile << head_cmd << "\n";
+        {
+            std::string rawHead, simpleHead;
+            AppendProgramHead(cfg, rawHead, simpleHead);
+            rawFile << rawHead;
+            writeSimple(simpleHead);
         }
 
         std::vector<std::string> headers = data[0];
@@ -145,14 +198,18 @@ YIMA_API int GenerateRawTxt(const char* csv_input_dir, const char* txt_output_di
                 rawFile << cleaned_cmd << "\n";
 
                 // simple 文件仅写入指令
-                simpleFile << cleaned_cmd << "\n";
+                writeSimple(cleaned_cmd + "\n");
             }
         }
 
         // --- 5. 写入尾部命令 ---
-        if (!tail_cmd.empty()) {
-            rawFile << "\n# [TAIL START]\n" << tail_cmd << "\n# [TAIL END]\n";
-            simpleFile << tail_cmd << "\n";
+        {
+            std::string rawTail, simpleTail;
+            AppendProgramTail(cfg, rawTail, simpleTail);
+            rawFile << rawTail;
+            writeSimple(simpleTail);
+            optimizer.Finish(optimized);
+            simpleFile << optimized;
         }
 
         rawFile.close();
@@ -161,4 +218,20 @@ YIMA_API int GenerateRawTxt(const char* csv_input_dir, const char* txt_output_di
     } catch (...) {
         return -1;
     }
-}
\ No newline at end of file
+}
+
+YIMA_API int GenerateRawTxt(const char* csv_input_dir, const char* txt_output_dir, const char* config_dir) {
+    try {
+        // 加载 head_tail_cmd.toml 配置
+        YimaConfig cfg;
+        #ifdef _WIN32
+        LoadHeadTailConfig(fs::path(Utf8ToWide(config_dir)), cfg);
+        return WriteRawTxt(fs::path(Utf8ToWide(csv_input_dir)), fs::path(Utf8ToWide(txt_output_dir)), cfg);
+        #else
+        LoadHeadTailConfig(fs::path(config_dir), cfg);
+        return WriteRawTxt(fs::path(csv_input_dir), fs::path(txt_output_dir), cfg);
+        #endif
+    } catch (...) {
+        return -1;
+    }
+}
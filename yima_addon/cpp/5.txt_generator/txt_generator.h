@@ -2,6 +2,60 @@
 #define TXT_GENERATOR_H
 
 #include "../yima_common.h"
+#include "../4.cmd_csv_handle/cmd_csv_handle.h"
+#include <string>
+#include <filesystem>
+
+// 直接由阶段 4 的遍历结果生成 cmd_raw.txt 与 cmd_simple.txt 的正文 (不含头尾命令)
+class ProgramTxtSink : public CmdRowSink {
+public:
+    ProgramTxtSink(std::string& raw, std::string& simple) : raw_(raw), simple_(simple) {}
+    void PixelRow(int index, const std::string& pre, const std::string& dumu,
+                  const std::string& sema, const std::string& post) override;
+    void ShaxianSwitchRow(const std::string& cmd) override;
+    void LineSwitchRow(const std::string& luola, const std::string& lineSwitch) override;
+
+private:
+    void Append(const std::string& index, const char* tag, const char* label, const std::string& cmd);
+
+    std::string& raw_;
+    std::string& simple_;
+};
+
+// 直接由阶段 4 的遍历结果拼接纯指令文本, 与 pixel_cmd.csv -> cmd_simple.txt 的结果逐字节一致
+class SimpleProgramSink : public CmdRowSink {
+public:
+    explicit SimpleProgramSink(std::string& out) : out_(out) {}
+    void PixelRow(int index, const std::string& pre, const std::string& dumu,
+                  const std::string& sema, const std::string& post) override;
+    void ShaxianSwitchRow(const std::string& cmd) override { Append(cmd); }
+    void LineSwitchRow(const std::string& luola, const std::string& lineSwitch) override;
+
+private:
+    void Append(const std::string& cmd);
+
+    std::string& out_;
+};
+
+// cmd_raw.txt / cmd_simple.txt 的头尾命令部分
+void AppendProgramHead(const YimaConfig& cfg, std::string& raw, std::string& simple);
+void AppendProgramTail(const YimaConfig& cfg, std::string& raw, std::string& simple);
+
+// 指令块中不含双引号时, 直接生成的结果与经由 pixel_cmd.csv 解析的结果逐字节一致
+bool ProgramTxtMatchesCsv(const YimaConfig& cfg);
+
+/**
+ * @brief 不经过 pixel_cmd.csv, 直接生成 cmd_simple.txt 的内容 (含头尾命令)
+ */
+std::string GenerateSimpleProgram(const YCombinedView& grid, const YimaConfig& cfg);
+
+/**
+ * @brief 使用已加载的配置, 由 csv_dir/pixel_cmd.csv 生成 cmd_raw.txt 与 cmd_simple.txt
+ * @param optimize cmd_simple.txt 使用的优化遍 (见 program_optimize.h), 0 为不优化; cmd_raw.txt 不受影响
+ * @return 0: 成功, -1: 文件读取失败, -2: 文件打开失败
+ */
+int WriteRawTxt(const std::filesystem::path& csv_dir, const std::filesystem::path& txt_dir, const YimaConfig& cfg,
+                unsigned optimize = 0);
 
 extern "C" {
     /**
@@ -8,10 +8,14 @@
  */
 #include "txt_handle.h"
 #include "../encoding_utils.h"
+#include "../mapped_file.h"
+#include "../yima_trace.h"
+#include "../yima_probes.h"
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <filesystem>
 #include <algorithm>
 
@@ -21,7 +25,7 @@ namespace fs = std::filesystem;
 const size_t MAX_PATTERN_LEN = 50;  // 模式长度上限
 const size_t MAX_LOOKAHEAD = 200;   // 向前搜索的范围限制
 
-bool IsSequenceEqual(const std::vector<std::string>& lines, size_t s1, size_t s2, size_t len) {
+bool IsSequenceEqual(const std::vector<std::string_view>& lines, size_t s1, size_t s2, size_t len) {
     if (s2 + len > lines.size()) return false;
     for (size_t i = 0; i < len; ++i) {
         if (lines[s1 + i] != lines[s2 + i]) return false;
@@ -29,42 +33,207 @@ bool IsSequenceEqual(const std::vector<std::string>& lines, size_t s1, size_t s2
     return true;
 }
 
+void FastCompress(const std::vector<std::string_view>& lines, std::string& out);
+
+size_t CompressStep(const std::vector<std::string_view>& lines, size_t i, std::string& out, size_t* read_end) {
+    TraceSpan span("segment", "compress");
+    span.Arg("line", (int64_t)i);
+    const size_t n = lines.size();
+    size_t bestL = 0;
+    size_t bestCount = 0;
+    int maxSavings = 0;
+    // 决策读取过的行的上界; 搜索范围或匹配次数受总行数限制时, 结果与 n 相关, 记为 n
+    size_t readEnd = i + 1;
+    bool endDependent = (n - i) / 2 < MAX_PATTERN_LEN;
+
+    // 在窗口范围内寻找从当前位置 i 开始的最优循环
+    size_t searchL = std::min(MAX_PATTERN_LEN, (n - i) / 2);
+    for (size_t L = 1; L <= searchL; ++L) {
+        size_t count = 1;
+        while (i + (count + 1) * L <= n && IsSequenceEqual(lines, i, i + count * L, L)) {
+            count++;
+        }
+        if (i + (count + 1) * L > n) endDependent = true;
+        else readEnd = std::max(readEnd, i + (count + 1) * L);
+
+        int savings = (int)((count - 1) * L - 2); // 收益计算
+        if (savings > maxSavings) {
+            maxSavings = savings;
+            bestL = L;
+            bestCount = count;
+        }
+    }
+    if (read_end) *read_end = endDependent ? n : readEnd;
+
+    if (maxSavings > 0) {
+        YIMA_PROBE3(loop, i, bestCount, bestL);
+        out += "RS " + std::to_string(bestCount) + "\n";
+        // 对循环体进行递归压缩，以支持嵌套 RS/RE
+        std::vector<std::string_view> body(lines.begin() + i, lines.begin() + i + bestL);
+        FastCompress(body, out);
+        out += "RE\n";
+        span.Arg("lines", (int64_t)(bestCount * bestL));
+        return bestCount * bestL;
+    }
+    out.append(lines[i].data(), lines[i].size());
+    out += '\n';
+    span.Arg("lines", 1);
+    return 1;
+}
+
 // 快速递归压缩：仅对当前位置进行局部最优匹配
-void FastCompress(const std::vector<std::string>& lines, std::ofstream& outFile) {
+void FastCompress(const std::vector<std::string_view>& lines, std::string& out) {
+    size_t i = 0;
+    while (i < lines.size()) i += CompressStep(lines, i, out);
+}
+
+void CompressTracked(const std::vector<std::string_view>& lines, std::string& out, std::vector<CompressToken>& tokens) {
+    tokens.clear();
     size_t i = 0;
     while (i < lines.size()) {
-        size_t bestL = 0;
-        size_t bestCount = 0;
-        int maxSavings = 0;
-
-        // 在窗口范围内寻找从当前位置 i 开始的最优循环
-        size_t searchL = std::min(MAX_PATTERN_LEN, (lines.size() - i) / 2);
-        for (size_t L = 1; L <= searchL; ++L) {
-            size_t count = 1;
-            while (i + (count + 1) * L <= lines.size() && IsSequenceEqual(lines, i, i + count * L, L)) {
-                count++;
-            }
+        CompressToken t;
+        t.line = i;
+        t.out = out.size();
+        size_t readEnd = 0;
+        i += CompressStep(lines, i, out, &readEnd);
+        t.next = i;
+        t.readEnd = readEnd;
+        tokens.push_back(t);
+    }
+}
 
-            int savings = (int)((count - 1) * L - 2); // 收益计算
-            if (savings > maxSavings) {
-                maxSavings = savings;
-                bestL = L;
-                bestCount = count;
+size_t CompressSpliced(const std::vector<std::string_view>& lines, const std::vector<LineBlock>& same,
+                       size_t old_line_count, std::string_view old_out, const std::vector<CompressToken>& old_tokens,
+                       std::string& out, std::vector<CompressToken>& tokens) {
+    tokens.clear();
+    const size_t n = lines.size();
+    size_t reused = 0;
+    size_t bi = 0;
+    size_t i = 0;
+    while (i < n) {
+        CompressToken t;
+        t.line = i;
+        t.out = out.size();
+
+        // 旧片段可复用的条件: 当前位置落在某个相同区间内, 旧片段从对应位置开始,
+        // 且其读取范围没有超出该区间 (与总行数相关的片段还要求区间同时延伸到两侧末尾)
+        while (bi < same.size() && same[bi].newStart + same[bi].len <= i) ++bi;
+        if (bi < same.size() && same[bi].newStart <= i) {
+            const LineBlock& blk = same[bi];
+            size_t a = blk.oldStart + (i - blk.newStart);
+            size_t blockEndOld = blk.oldStart + blk.len;
+            auto it = std::lower_bound(old_tokens.begin(), old_tokens.end(), a,
+                                       [](const CompressToken& tok, size_t v) { return tok.line < v; });
+            if (it != old_tokens.end() && it->line == a && it->readEnd <= blockEndOld &&
+                (it->readEnd < old_line_count || blk.newStart + blk.len == n)) {
+                size_t outEnd = (it + 1 != old_tokens.end()) ? (it + 1)->out : old_out.size();
+                out.append(old_out.data() + it->out, outEnd - it->out);
+                t.next = i + (it->next - it->line);
+                t.readEnd = (it->readEnd == old_line_count) ? n : i + (it->readEnd - it->line);
+                tokens.push_back(t);
+                i = t.next;
+                ++reused;
+                continue;
             }
         }
 
-        if (maxSavings > 0) {
-            outFile << "RS " << bestCount << "\n";
-            // 对循环体进行递归压缩，以支持嵌套 RS/RE
-            std::vector<std::string> body(lines.begin() + i, lines.begin() + i + bestL);
-            FastCompress(body, outFile);
-            outFile << "RE\n";
-            i += bestCount * bestL;
-        } else {
-            outFile << lines[i] << "\n";
-            i++;
+        size_t readEnd = 0;
+        i += CompressStep(lines, i, out, &readEnd);
+        t.next = i;
+        t.readEnd = readEnd;
+        tokens.push_back(t);
+    }
+    return reused;
+}
+
+void StreamingCompressor::Push(std::string_view text) {
+    for (std::string_view line : SplitProgramLines(text)) {
+        storage_.emplace_back(line);
+        lines_.push_back(storage_.back());
+    }
+}
+
+void StreamingCompressor::Drain(std::string& out) {
+    std::string token;
+    while (pos_ < lines_.size() && lines_.size() >= retryAt_) {
+        token.clear();
+        size_t readEnd = 0;
+        size_t used = CompressStep(lines_, pos_, token, &readEnd);
+        if (readEnd >= lines_.size()) {
+            // 决策与窗口末尾相关 (或循环延伸到末尾), 等窗口增长一倍后再试, 避免长循环时反复扫描
+            retryAt_ = lines_.size() + std::max<size_t>(2 * MAX_PATTERN_LEN, lines_.size() - pos_);
+            break;
+        }
+        out += token;
+        pos_ += used;
+    }
+    // 已压缩的行不会再被读取, 窗口过半时丢弃
+    if (pos_ >= 4096 && pos_ * 2 >= lines_.size()) {
+        lines_.erase(lines_.begin(), lines_.begin() + pos_);
+        storage_.erase(storage_.begin(), storage_.begin() + pos_);
+        retryAt_ = retryAt_ > pos_ ? retryAt_ - pos_ : 0;
+        pos_ = 0;
+    }
+}
+
+void StreamingCompressor::Finish(std::string& out) {
+    while (pos_ < lines_.size()) pos_ += CompressStep(lines_, pos_, out);
+    lines_.clear();
+    storage_.clear();
+    pos_ = 0;
+    retryAt_ = 0;
+}
+
+std::vector<std::string_view> SplitProgramLines(std::string_view text) {
+    std::vector<std::string_view> lines;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t nl = text.find('\n', pos);
+        if (nl == std::string_view::npos) nl = text.size();
+        std::string_view line = text.substr(pos, nl - pos);
+        // 移除首尾空白
+        size_t first = line.find_first_not_of(" \t\r\n");
+        if (first != std::string_view::npos) {
+            size_t last = line.find_last_not_of(" \t\r\n");
+            lines.push_back(line.substr(first, last - first + 1));
         }
+        pos = nl + 1;
     }
+    return lines;
+}
+
+std::string CompressProgram(std::string_view simple) {
+    std::string out;
+    FastCompress(SplitProgramLines(simple), out);
+    return out;
+}
+
+// 展开从 pos 开始的行直到匹配的 RE (或文本末尾), 返回 RE 之后的位置; 出错时返回 npos
+static size_t ExpandLines(const std::vector<std::string_view>& lines, size_t pos, bool inLoop, std::string& out) {
+    while (pos < lines.size()) {
+        std::string_view line = lines[pos++];
+        if (line == "RE") return inLoop ? pos : std::string_view::npos;
+        if (line.size() > 3 && line.compare(0, 3, "RS ") == 0) {
+            uint64_t count = 0;
+            for (char c : line.substr(3)) {
+                if (c < '0' || c > '9') return std::string_view::npos;
+                count = count * 10 + (uint64_t)(c - '0');
+            }
+            std::string body;
+            pos = ExpandLines(lines, pos, true, body);
+            if (pos == std::string_view::npos || count == 0) return std::string_view::npos;
+            for (uint64_t k = 0; k < count; ++k) out += body;
+            continue;
+        }
+        out.append(line.data(), line.size());
+        out += '\n';
+    }
+    return inLoop ? std::string_view::npos : pos;
+}
+
+bool ExpandProgram(std::string_view compressed, std::string& out) {
+    out.clear();
+    return ExpandLines(SplitProgramLines(compressed), 0, false, out) != std::string_view::npos;
 }
 
 YIMA_API int PostProcessTxt(const char* txt_input_dir, const char* txt_output_dir) {
@@ -78,22 +247,15 @@ YIMA_API int PostProcessTxt(const char* txt_input_dir, const char* txt_output_di
         #endif
         if (!fs::exists(inputPath)) return -1;
 
-        std::ifstream inFile(inputPath.string());
-        std::vector<std::string> lines;
-        std::string line;
-        while (std::getline(inFile, line)) {
-            std::string trimmed = line;
-            // 移除首尾空白
-            trimmed.erase(0, trimmed.find_first_not_of(" \t\r\n"));
-            trimmed.erase(trimmed.find_last_not_of(" \t\r\n") + 1);
-            if (!trimmed.empty()) lines.push_back(trimmed);
-        }
-        inFile.close();
+        MappedFile inFile(inputPath);
+        if (!inFile.IsOpen()) return -1;
+        std::string compressed = CompressProgram(std::string_view(reinterpret_cast<const char*>(inFile.data()), inFile.size()));
+        inFile.Close();
 
         std::ofstream outFile(outputPath.string());
         if (!outFile.is_open()) return -2;
 
-        FastCompress(lines, outFile);
+        outFile << compressed;
 
         outFile.close();
         return 0;
@@ -2,6 +2,69 @@
 #define TXT_HANDLE_H
 
 #include "../yima_common.h"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+// 压缩输出中的一个片段 (一条指令或一个 RS/RE 循环)
+struct CompressToken {
+    uint64_t line = 0;      // 起始行号 (SplitProgramLines 之后的行)
+    uint64_t next = 0;      // 下一个片段的起始行号
+    uint64_t readEnd = 0;   // 生成该片段时读取过的行的上界 (不含); 等于总行数表示结果与总行数相关
+    uint64_t out = 0;       // 在压缩输出中的字节偏移
+};
+
+// 新旧两份行序列中内容相同的一段区间
+struct LineBlock {
+    uint64_t newStart = 0;
+    uint64_t oldStart = 0;
+    uint64_t len = 0;
+};
+
+// 从第 i 行开始压缩一个片段并追加到 out, 返回消耗的行数; read_end 返回决策读取过的行的上界
+size_t CompressStep(const std::vector<std::string_view>& lines, size_t i, std::string& out, size_t* read_end = nullptr);
+
+// 同 FastCompress, 同时记录每个片段的位置, 供之后的增量压缩复用
+void CompressTracked(const std::vector<std::string_view>& lines, std::string& out, std::vector<CompressToken>& tokens);
+
+/**
+ * @brief 增量压缩: 输入只在 same 之外的区间发生变化时, 复用旧输出中读取范围未受影响的片段
+ * 结果与对 lines 完整执行 FastCompress 逐字节一致
+ * @param same 按 newStart 递增且互不重叠的相同区间
+ * @return 复用的片段个数
+ */
+size_t CompressSpliced(const std::vector<std::string_view>& lines, const std::vector<LineBlock>& same,
+                       size_t old_line_count, std::string_view old_out, const std::vector<CompressToken>& old_tokens,
+                       std::string& out, std::vector<CompressToken>& tokens);
+
+// 边生成边压缩: 只输出由已有的行即可确定的片段, 全部输出与对完整文本执行 CompressProgram 逐字节一致
+class StreamingCompressor {
+public:
+    // 追加指令文本, 须由完整的行组成 (以 \n 结尾)
+    void Push(std::string_view text);
+    // 输出当前已可确定的片段
+    void Drain(std::string& out);
+    // 输入结束, 输出其余全部片段
+    void Finish(std::string& out);
+
+private:
+    std::deque<std::string> storage_;         // 行内容 (deque 追加时不移动已有元素)
+    std::vector<std::string_view> lines_;     // 尚未全部压缩的行窗口
+    size_t pos_ = 0;                          // 下一个片段的起始行
+    size_t retryAt_ = 0;                      // 片段与后续行相关时, 等行数增长到此值再重试
+};
+
+// 按行拆分指令文本, 去除每行首尾空白并丢弃空行 (结果引用 text 中的内存)
+std::vector<std::string_view> SplitProgramLines(std::string_view text);
+
+// 对纯指令文本执行 RS/RE 循环压缩, 返回 cmd_compressed.txt 的内容
+std::string CompressProgram(std::string_view simple);
+
+// 展开 RS/RE 循环 (CompressProgram 的逆操作), 每行以 \n 结尾; RS/RE 不配对或次数无效时返回 false
+bool ExpandProgram(std::string_view compressed, std::string& out);
 
 extern "C" {
     /**
@@ -0,0 +1,104 @@
+#include "batch_runner.h"
+#include "encoding_utils.h"
+#include "yima_trace.h"
+#include "yima_log.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MsSince(Clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+} // namespace
+
+int RunBatch(const std::vector<BatchJob>& jobs, int concurrency,
+             std::vector<BatchJobResult>& results, BatchSummary& summary) {
+    Clock::time_point batchStart = Clock::now();
+    results.assign(jobs.size(), BatchJobResult());
+    summary = BatchSummary();
+
+    // 1. 每个不同的配置目录只加载一次, 之后各线程只读共享
+    std::map<std::string, std::shared_ptr<const YimaConfig>> configs;
+    for (const auto& job : jobs) {
+        if (configs.count(job.config_path)) continue;
+        auto cfg = std::make_shared<YimaConfig>();
+        bool ok = false;
+        try {
+            ok = LoadYimaConfig(CreatePathFromUtf8(job.config_path), *cfg);
+        } catch (const std::exception& e) {
+            YIMA_LOG_ERROR("Batch") << "Exception loading config " << job.config_path << ": " << e.what();
+        }
+        if (ok) ++summary.configCount;
+        configs[job.config_path] = ok ? std::shared_ptr<const YimaConfig>(cfg) : nullptr;
+    }
+    summary.configMs = MsSince(batchStart);
+
+    // 2. 预先标记无法执行的任务 (配置加载失败 / 输出目录重复)
+    std::vector<const YimaConfig*> jobConfig(jobs.size(), nullptr);
+    std::set<std::string> outputs;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (!outputs.insert(OutputDirKey(jobs[i].output_path)).second) {
+            results[i].code = BATCH_DUPLICATE_OUTPUT;
+            results[i].error = "duplicate output directory: " + jobs[i].output_path;
+            continue;
+        }
+        jobConfig[i] = configs[jobs[i].config_path].get();
+        if (!jobConfig[i]) {
+            results[i].code = PIPELINE_CONFIG_FAILED;
+            results[i].error = "failed to load configuration: " + jobs[i].config_path;
+        }
+    }
+
+    // 3. 固定数量的工作线程从共享下标中领取任务
+    if (concurrency <= 0) concurrency = (int)std::max(1u, std::thread::hardware_concurrency());
+    concurrency = (int)std::min<size_t>((size_t)concurrency, std::max<size_t>(jobs.size(), 1));
+    summary.concurrency = concurrency;
+
+    // 工作线程沿用调用方的日志通道与追踪会话
+    const uint64_t logChannel = CurrentLogChannel();
+    const std::shared_ptr<TraceSessionState> trace = CurrentTraceSession();
+    std::atomic<size_t> next{0};
+    auto worker = [&](int id) {
+        LogChannelScope logScope(logChannel);
+        TraceScope traceScope(trace);
+        for (size_t i = next++; i < jobs.size(); i = next++) {
+            if (!jobConfig[i]) continue;
+            TraceSpan span("batch_job", "batch");
+            span.Arg("job", (int64_t)i);
+            span.Arg("worker", id);
+            BatchJobResult& r = results[i];
+            r.worker = id;
+            r.startMs = MsSince(batchStart);
+            Clock::time_point t0 = Clock::now();
+            PipelineOptions options = jobs[i].options;
+            options.report = jobs[i].report ? &r.report : nullptr;
+            r.code = ProcessBmpTranslation(*jobConfig[i], jobs[i].input_path, jobs[i].output_path, options);
+            r.wallMs = MsSince(t0);
+            if (r.code == PIPELINE_OUTPUT_BUSY) r.error = "output directory is in use by another pipeline: " + jobs[i].output_path;
+            else if (r.code != 0) r.error = "pipeline failed with code " + std::to_string(r.code);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < concurrency; ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto& th : pool) th.join();
+
+    summary.wallMs = MsSince(batchStart);
+    int succeeded = 0;
+    for (const auto& r : results) if (r.code == 0) ++succeeded;
+    YIMA_LOG_INFO("Batch") << succeeded << "/" << jobs.size() << " jobs succeeded in " << summary.wallMs
+                           << " ms on " << concurrency << " threads";
+    return succeeded;
+}
@@ -0,0 +1,47 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include "yima_pipeline.h"
+#include "run_report.h"
+#include <string>
+#include <vector>
+
+// 批处理中的单个设计
+struct BatchJob {
+    std::string config_path;
+    std::string input_path;
+    std::string output_path;
+    PipelineOptions options;   // options.report 不使用, 见 report
+    bool report = false;       // 是否在结果中填写运行报告
+};
+
+// 单个设计的处理结果
+struct BatchJobResult {
+    int code = 0;             // ProcessBmpTranslation 的返回值; -101: 与之前的任务输出目录重复, -104: 配置加载失败
+    int worker = -1;          // 执行该任务的工作线程序号
+    double startMs = 0;       // 相对批处理开始的时间
+    double wallMs = 0;        // 任务本身耗时
+    std::string error;
+    RunReport report;         // 仅当 BatchJob::report 为 true 时填写
+};
+
+// 整个批处理的统计
+struct BatchSummary {
+    int concurrency = 0;      // 实际使用的工作线程数
+    int configCount = 0;      // 实际加载的配置份数 (相同路径只加载一次)
+    double configMs = 0;      // 加载配置耗时
+    double wallMs = 0;        // 批处理总耗时
+};
+
+constexpr int BATCH_DUPLICATE_OUTPUT = -101;
+
+/**
+ * @brief 在固定数量的工作线程上并行处理多个设计
+ * 相同 config_path 的任务共享同一份已加载的配置; 同一输出目录只允许出现一次
+ * @param concurrency 工作线程数, <= 0 时取硬件线程数
+ * @return 成功的任务个数
+ */
+int RunBatch(const std::vector<BatchJob>& jobs, int concurrency,
+             std::vector<BatchJobResult>& results, BatchSummary& summary);
+
+#endif // BATCH_RUNNER_H
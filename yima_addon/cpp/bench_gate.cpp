@@ -0,0 +1,287 @@
+#include "bench_gate.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 只支持基线文件用到的 JSON 子集: 对象, 数组, 字符串 (仅 \" \\ 转义), 数字, true/false/null
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+    Type type = Type::Null;
+    double number = 0;
+    std::string str;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* Find(const char* key) const {
+        for (const auto& [k, v] : members) {
+            if (k == key) return &v;
+        }
+        return nullptr;
+    }
+    double Number(const char* key, double fallback) const {
+        const JsonValue* v = Find(key);
+        return v && v->type == Type::Number ? v->number : fallback;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : s_(text) {}
+
+    bool Parse(JsonValue& out, std::string& error) {
+        if (!Value(out, 0)) {
+            error = "invalid JSON at offset " + std::to_string(pos_);
+            return false;
+        }
+        SkipSpace();
+        if (pos_ != s_.size()) {
+            error = "trailing characters at offset " + std::to_string(pos_);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    void SkipSpace() {
+        while (pos_ < s_.size() && std::isspace((unsigned char)s_[pos_])) ++pos_;
+    }
+    bool Eat(char c) {
+        SkipSpace();
+        if (pos_ < s_.size() && s_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+    bool Literal(const char* word) {
+        size_t n = std::char_traits<char>::length(word);
+        if (s_.compare(pos_, n, word) != 0) return false;
+        pos_ += n;
+        return true;
+    }
+    bool String(std::string& out) {
+        if (!Eat('"')) return false;
+        while (pos_ < s_.size() && s_[pos_] != '"') {
+            if (s_[pos_] == '\\' && ++pos_ >= s_.size()) return false;
+            out += s_[pos_++];
+        }
+        return Eat('"');
+    }
+    bool Value(JsonValue& v, int depth) {
+        if (depth > 16) return false;
+        SkipSpace();
+        if (pos_ >= s_.size()) return false;
+        char c = s_[pos_];
+        if (c == '{') {
+            ++pos_;
+            v.type = JsonValue::Type::Object;
+            if (Eat('}')) return true;
+            do {
+                std::pair<std::string, JsonValue> m;
+                if (!String(m.first) || !Eat(':') || !Value(m.second, depth + 1)) return false;
+                v.members.push_back(std::move(m));
+            } while (Eat(','));
+            return Eat('}');
+        }
+        if (c == '[') {
+            ++pos_;
+            v.type = JsonValue::Type::Array;
+            if (Eat(']')) return true;
+            do {
+                v.items.emplace_back();
+                if (!Value(v.items.back(), depth + 1)) return false;
+            } while (Eat(','));
+            return Eat(']');
+        }
+        if (c == '"') {
+            v.type = JsonValue::Type::String;
+            return String(v.str);
+        }
+        if (Literal("true") || Literal("false")) {
+            v.type = JsonValue::Type::Bool;
+            v.number = c == 't';
+            return true;
+        }
+        if (Literal("null")) return true;
+        const char* begin = s_.c_str() + pos_;
+        char* end = nullptr;
+        v.number = std::strtod(begin, &end);
+        if (end == begin) return false;
+        v.type = JsonValue::Type::Number;
+        pos_ += (size_t)(end - begin);
+        return true;
+    }
+
+    const std::string& s_;
+    size_t pos_ = 0;
+};
+
+const BenchCase* FindCase(const std::vector<BenchCase>& cases, const std::string& key) {
+    for (const BenchCase& c : cases) {
+        if (c.key == key) return &c;
+    }
+    return nullptr;
+}
+
+std::string FormatBytes(double bytes) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.1f MiB", bytes / (1024.0 * 1024.0));
+    return buf;
+}
+
+std::string FormatNs(double ns) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f ns", ns);
+    return buf;
+}
+
+void AppendRow(std::string& report, const std::string& key, const char* metric, const std::string& base,
+               const std::string& current, const std::string& limit, double change, const char* result) {
+    char buf[256];
+    std::snprintf(buf, sizeof(buf), "%-22s %-10s %13s %13s %13s %+8.1f%%  %s\n", key.c_str(), metric, base.c_str(),
+                  current.c_str(), limit.c_str(), change * 100.0, result);
+    report += buf;
+}
+
+} // namespace
+
+bool LoadBenchBaseline(const fs::path& p, BenchBaseline& baseline, std::string& error) {
+    std::ifstream in(p, std::ios::binary);
+    if (!in) {
+        error = "cannot open " + p.string();
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    JsonValue root;
+    if (!JsonParser(text).Parse(root, error)) return false;
+    if (root.type != JsonValue::Type::Object) {
+        error = "baseline is not a JSON object";
+        return false;
+    }
+    baseline = BenchBaseline();
+    if (const JsonValue* build = root.Find("build"); build && build->type == JsonValue::Type::String) {
+        baseline.build = build->str;
+    }
+    baseline.timeTolerance = root.Number("time_tolerance", baseline.timeTolerance);
+    baseline.memoryTolerance = root.Number("memory_tolerance", baseline.memoryTolerance);
+    baseline.memorySlackBytes = (uint64_t)root.Number("memory_slack_bytes", (double)baseline.memorySlackBytes);
+    const JsonValue* cases = root.Find("cases");
+    if (!cases || cases->type != JsonValue::Type::Array) {
+        error = "baseline has no \"cases\" array";
+        return false;
+    }
+    for (const JsonValue& item : cases->items) {
+        const JsonValue* key = item.Find("case");
+        if (!key || key->type != JsonValue::Type::String) {
+            error = "baseline case without a \"case\" name";
+            return false;
+        }
+        BenchCase c;
+        c.key = key->str;
+        c.nsPerPixel = item.Number("ns_per_pixel", 0);
+        c.calibrationNs = item.Number("calibration_ns", 0);
+        c.peakRssBytes = (uint64_t)item.Number("peak_rss_bytes", 0);
+        c.peakHeapBytes = (uint64_t)item.Number("peak_heap_bytes", 0);
+        c.timeTolerance = item.Number("time_tolerance", -1);
+        c.memoryTolerance = item.Number("memory_tolerance", -1);
+        baseline.cases.push_back(std::move(c));
+    }
+    return true;
+}
+
+bool SaveBenchBaseline(const fs::path& p, const BenchBaseline& baseline) {
+    std::ofstream out(p, std::ios::binary | std::ios::trunc);
+    out << "{\n";
+    if (!baseline.build.empty()) out << "  \"build\": \"" << baseline.build << "\",\n";
+    char buf[512];
+    std::snprintf(buf, sizeof(buf),
+                  "  \"time_tolerance\": %.3g,\n  \"memory_tolerance\": %.3g,\n"
+                  "  \"memory_slack_bytes\": %llu,\n  \"cases\": [",
+                  baseline.timeTolerance, baseline.memoryTolerance,
+                  (unsigned long long)baseline.memorySlackBytes);
+    out << buf;
+    for (size_t i = 0; i < baseline.cases.size(); ++i) {
+        const BenchCase& c = baseline.cases[i];
+        std::snprintf(buf, sizeof(buf), "%s\n    {\"case\": \"%s\", \"ns_per_pixel\": %.3f, \"calibration_ns\": %.0f, "
+                      "\"peak_rss_bytes\": %llu, \"peak_heap_bytes\": %llu",
+                      i ? "," : "", c.key.c_str(), c.nsPerPixel, c.calibrationNs, (unsigned long long)c.peakRssBytes,
+                      (unsigned long long)c.peakHeapBytes);
+        out << buf;
+        if (c.timeTolerance >= 0) out << ", \"time_tolerance\": " << c.timeTolerance;
+        if (c.memoryTolerance >= 0) out << ", \"memory_tolerance\": " << c.memoryTolerance;
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.good();
+}
+
+BenchBaseline MakeBenchBaseline(const BenchBaseline& previous, const std::vector<BenchCase>& current,
+                                const std::string& build) {
+    BenchBaseline baseline;
+    baseline.build = build;
+    baseline.timeTolerance = previous.timeTolerance;
+    baseline.memoryTolerance = previous.memoryTolerance;
+    baseline.memorySlackBytes = previous.memorySlackBytes;
+    for (BenchCase c : current) {
+        const BenchCase* old = FindCase(previous.cases, c.key);
+        c.timeTolerance = old ? old->timeTolerance : -1;
+        c.memoryTolerance = old ? old->memoryTolerance : -1;
+        baseline.cases.push_back(std::move(c));
+    }
+    return baseline;
+}
+
+int CompareBenchBaseline(const BenchBaseline& baseline, const std::vector<BenchCase>& current, std::string& report) {
+    char buf[256];
+    std::snprintf(buf, sizeof(buf), "%-22s %-10s %13s %13s %13s %9s  %s\n", "case", "metric", "baseline", "current",
+                  "limit", "change", "result");
+    report = buf;
+
+    int regressions = 0;
+    for (const BenchCase& base : baseline.cases) {
+        const BenchCase* cur = FindCase(current, base.key);
+        if (!cur) {
+            report += base.key + ": missing from this run  REGRESSED\n";
+            ++regressions;
+            continue;
+        }
+        const double timeTol = base.timeTolerance >= 0 ? base.timeTolerance : baseline.timeTolerance;
+        const double memTol = base.memoryTolerance >= 0 ? base.memoryTolerance : baseline.memoryTolerance;
+
+        // 当前机器与生成基线时的速度比, 时间基线按此换算
+        const double scale = base.calibrationNs > 0 && cur->calibrationNs > 0 ? cur->calibrationNs / base.calibrationNs : 1.0;
+        const double expected = base.nsPerPixel * scale;
+        if (expected > 0) {
+            const double limit = expected * (1.0 + timeTol);
+            const bool bad = cur->nsPerPixel > limit;
+            regressions += bad;
+            AppendRow(report, base.key, "ns/pixel", FormatNs(expected), FormatNs(cur->nsPerPixel), FormatNs(limit),
+                      cur->nsPerPixel / expected - 1.0,
+                      bad ? "REGRESSED" : cur->nsPerPixel < expected * (1.0 - timeTol) ? "ok (faster)" : "ok");
+        }
+        auto memory = [&](const char* metric, uint64_t baseBytes, uint64_t curBytes) {
+            if (baseBytes == 0 || curBytes == 0) return;
+            const double limit = (double)baseBytes * (1.0 + memTol) + (double)baseline.memorySlackBytes;
+            const bool bad = (double)curBytes > limit;
+            regressions += bad;
+            AppendRow(report, base.key, metric, FormatBytes((double)baseBytes), FormatBytes((double)curBytes),
+                      FormatBytes(limit), (double)curBytes / (double)baseBytes - 1.0, bad ? "REGRESSED" : "ok");
+        };
+        memory("peak_rss", base.peakRssBytes, cur->peakRssBytes);
+        memory("peak_heap", base.peakHeapBytes, cur->peakHeapBytes);
+    }
+    for (const BenchCase& cur : current) {
+        if (!FindCase(baseline.cases, cur.key)) report += cur.key + ": not in baseline (run --update-baseline to add it)\n";
+    }
+    report += "(time baselines are scaled by each case's calibration run)\n";
+    std::snprintf(buf, sizeof(buf), "\n%d regression%s\n", regressions, regressions == 1 ? "" : "s");
+    report += buf;
+    return regressions;
+}
@@ -0,0 +1,62 @@
+#ifndef BENCH_GATE_H
+#define BENCH_GATE_H
+
+/*
+ * 基准回归门限: 把 yima_bench 的结果与保存的基线 (JSON) 比较, 时间或峰值内存超出阈值时判为回归
+ *
+ * 基线文件格式 (yima_bench --update-baseline 生成, 阈值可手工修改; 文件中不能有注释):
+ *   {
+ *     "build": "release default",      // 生成基线的构建 (见下), 与当前构建不同时不比较
+ *     "time_tolerance": 0.30,          // 默认允许的相对增长
+ *     "memory_tolerance": 0.20,
+ *     "memory_slack_bytes": 8388608,   // 内存比较的绝对余量, 避免小用例的抖动
+ *     "cases": [
+ *       { "case": "decode 100x500", "ns_per_pixel": 12.5, "calibration_ns": 21000000,
+ *         "peak_rss_bytes": 20971520, "peak_heap_bytes": 0, "time_tolerance": 0.5 }   // 单个用例可覆盖阈值
+ *     ]
+ *   }
+ * calibration_ns 是紧挨着该用例运行的固定校准负载的耗时。时间按两次校准耗时的比例换算到当前机器
+ * (及当前负载) 后再比较, 使基线在不同速度的机器上可用, 也抵消运行期间机器速度的波动。
+ * build 为 "<release|debug> <yima_profile>", yima_alloc_stats=1 构建再加 " alloc_stats"; 校准负载不能
+ * 抵消编译选项与计数开销的差别, 因此不同构建之间的结果不可比较。
+ */
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// 一个用例的度量, key 为 "<case> <W>x<H>"
+struct BenchCase {
+    std::string key;
+    double nsPerPixel = 0;
+    double calibrationNs = 0;      // 0: 不换算
+    uint64_t peakRssBytes = 0;
+    uint64_t peakHeapBytes = 0;    // 0: 未统计 (非 yima_alloc_stats=1 构建)
+    double timeTolerance = -1;     // < 0: 使用基线的默认值
+    double memoryTolerance = -1;
+};
+
+struct BenchBaseline {
+    std::string build;             // 空: 未记录, 总是比较
+    double timeTolerance = 0.30;
+    double memoryTolerance = 0.20;
+    uint64_t memorySlackBytes = 8u << 20;
+    std::vector<BenchCase> cases;
+};
+
+// 读取基线, 失败时返回 false 并在 error 中说明原因
+bool LoadBenchBaseline(const std::filesystem::path& p, BenchBaseline& baseline, std::string& error);
+bool SaveBenchBaseline(const std::filesystem::path& p, const BenchBaseline& baseline);
+
+// 以当前结果生成新基线 (构建为 build), 保留 previous 中的阈值设置 (全局与单个用例)
+BenchBaseline MakeBenchBaseline(const BenchBaseline& previous, const std::vector<BenchCase>& current,
+                                const std::string& build);
+
+/**
+ * @brief 比较当前结果与基线, 把逐项对比表写入 report
+ * @return 回归的项数; 基线中有而本次没有运行的用例也计为回归
+ */
+int CompareBenchBaseline(const BenchBaseline& baseline, const std::vector<BenchCase>& current, std::string& report);
+
+#endif // BENCH_GATE_H
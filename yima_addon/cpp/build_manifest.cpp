@@ -0,0 +1,140 @@
+#include "build_manifest.h"
+#include "content_hash.h"
+#include "encoding_utils.h"
+#include "yima_log.h"
+#include "toml.hpp"
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int64_t MANIFEST_VERSION = 1;
+
+bool ParseHex(const std::string& s, uint64_t& out) {
+    if (s.empty() || s.size() > 16) return false;
+    out = 0;
+    for (char c : s) {
+        int v = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+        if (v < 0) return false;
+        out = (out << 4) | (uint64_t)v;
+    }
+    return true;
+}
+
+// TOML 基本字符串 (用于键名)
+std::string Quote(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+} // namespace
+
+void BuildManifest::Load(const fs::path& file) {
+    entries_.clear();
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) return;
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    try {
+        auto tbl = toml::parse(buffer.str(), file.string());
+        if (tbl["version"].value_or<int64_t>(0) != MANIFEST_VERSION) return;
+        auto stages = tbl["stages"].as_table();
+        if (!stages) return;
+        for (auto&& [name, node] : *stages) {
+            auto st = node.as_table();
+            if (!st) continue;
+            Entry e;
+            if (!ParseHex(st->get_as<std::string>("input") ? st->get_as<std::string>("input")->get() : "", e.input)) continue;
+            bool ok = true;
+            if (auto outs = st->get_as<toml::table>("outputs")) {
+                for (auto&& [out, h] : *outs) {
+                    uint64_t v = 0;
+                    if (!h.is_string() || !ParseHex(h.as_string()->get(), v)) { ok = false; break; }
+                    e.outputs[std::string(out.str())] = v;
+                }
+            }
+            if (ok) entries_[std::string(name.str())] = std::move(e);
+        }
+    } catch (const std::exception& e) {
+        YIMA_LOG_WARN("Manifest") << "Ignoring unreadable manifest: " << e.what();
+        entries_.clear();
+    }
+}
+
+bool BuildManifest::Save(const fs::path& file) const {
+    std::ostringstream s;
+    s << "# 增量构建清单, 由流水线自动生成\nversion = " << MANIFEST_VERSION << "\n";
+    for (const auto& [name, e] : entries_) {
+        s << "\n[stages." << Quote(name) << "]\ninput = \"" << HashToHex(e.input) << "\"\n";
+        s << "\n[stages." << Quote(name) << ".outputs]\n";
+        for (const auto& [out, h] : e.outputs) s << Quote(out) << " = \"" << HashToHex(h) << "\"\n";
+    }
+    // 先写临时文件再替换, 避免中途失败留下半个清单
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out << s.str();
+        if (!out.good()) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, file, ec);
+    return !ec;
+}
+
+bool BuildManifest::UpToDate(const std::string& stage, uint64_t input_key, const fs::path& base_dir) const {
+    auto it = entries_.find(stage);
+    if (it == entries_.end() || it->second.input != input_key) return false;
+    for (const auto& [out, h] : it->second.outputs) {
+        uint64_t actual = 0;
+        if (!HashFile(base_dir / CreatePathFromUtf8(out), actual) || actual != h) return false;
+    }
+    return true;
+}
+
+bool BuildManifest::Record(const std::string& stage, uint64_t input_key, const fs::path& base_dir,
+                           const std::vector<std::string>& outputs) {
+    Entry e;
+    e.input = input_key;
+    for (const auto& out : outputs) {
+        uint64_t h = 0;
+        if (!HashFile(base_dir / CreatePathFromUtf8(out), h)) {
+            entries_.erase(stage);
+            return false;
+        }
+        e.outputs[out] = h;
+    }
+    entries_[stage] = std::move(e);
+    return true;
+}
+
+void BuildManifest::RecordHashes(const std::string& stage, uint64_t input_key,
+                                 const std::map<std::string, uint64_t>& outputs) {
+    Entry e;
+    e.input = input_key;
+    e.outputs = outputs;
+    entries_[stage] = std::move(e);
+}
+
+bool BuildManifest::OutputHash(const std::string& stage, const std::string& output, uint64_t& hash) const {
+    auto it = entries_.find(stage);
+    if (it == entries_.end()) return false;
+    auto o = it->second.outputs.find(output);
+    if (o == it->second.outputs.end()) return false;
+    hash = o->second;
+    return true;
+}
+
+void BuildManifest::Prune(const std::string& prefix, const std::set<std::string>& keep) {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->first.compare(0, prefix.size(), prefix) == 0 && !keep.count(it->first)) it = entries_.erase(it);
+        else ++it;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef BUILD_MANIFEST_H
+#define BUILD_MANIFEST_H
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/*
+ * 增量构建清单 (输出目录下的 build_manifest.toml)
+ *
+ * 每个阶段记录一个输入键 (该阶段全部输入内容哈希的组合) 以及各输出文件的内容哈希。
+ * 再次运行时, 若某阶段的输入键未变且输出文件仍存在且内容未被改动, 则跳过该阶段。
+ * 输出内容哈希同时作为下游阶段的输入, 因此上游重跑但结果不变时下游仍可跳过。
+ */
+class BuildManifest {
+public:
+    // 读取清单, 文件缺失或格式不符时视为空清单
+    void Load(const std::filesystem::path& file);
+    bool Save(const std::filesystem::path& file) const;
+
+    // 输入键一致且所有已记录的输出 (相对 base_dir) 仍存在且哈希一致时返回 true
+    bool UpToDate(const std::string& stage, uint64_t input_key, const std::filesystem::path& base_dir) const;
+
+    // 阶段成功后记录输入键并哈希其输出文件; 输出缺失时返回 false 且不记录
+    bool Record(const std::string& stage, uint64_t input_key, const std::filesystem::path& base_dir,
+                const std::vector<std::string>& outputs);
+
+    // 记录写出时已计算好的输出哈希 (输出路径 -> 内容哈希), 不再重新读取文件
+    void RecordHashes(const std::string& stage, uint64_t input_key, const std::map<std::string, uint64_t>& outputs);
+
+    void Invalidate(const std::string& stage) { entries_.erase(stage); }
+
+    // 删除名称以 prefix 开头且不在 keep 中的阶段记录
+    void Prune(const std::string& prefix, const std::set<std::string>& keep);
+
+    // 已记录的输出哈希, 没有记录时返回 false
+    bool OutputHash(const std::string& stage, const std::string& output, uint64_t& hash) const;
+
+private:
+    struct Entry {
+        uint64_t input = 0;
+        std::map<std::string, uint64_t> outputs;   // 相对路径 (正斜杠) -> 内容哈希
+    };
+    std::map<std::string, Entry> entries_;
+};
+
+#endif // BUILD_MANIFEST_H
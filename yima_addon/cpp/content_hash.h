@@ -0,0 +1,54 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include "mapped_file.h"
+
+// 64 位 FNV-1a 内容哈希, 用于增量构建判断文件内容是否变化 (非加密用途)
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t h = FNV_OFFSET_BASIS) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+inline uint64_t HashString(std::string_view s, uint64_t h = FNV_OFFSET_BASIS) {
+    return HashBytes(s.data(), s.size(), h);
+}
+
+// 将一个值混入组合哈希 (顺序相关)
+inline uint64_t HashCombine(uint64_t h, uint64_t v) {
+    return HashBytes(&v, sizeof(v), h);
+}
+
+// 快速混合一个 64 位值 (用于逐像素累积行哈希, 比逐字节 FNV 快)
+inline uint64_t HashMix(uint64_t h, uint64_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+// 内存映射并哈希整个文件, 文件不存在或无法打开时返回 false
+inline bool HashFile(const std::filesystem::path& p, uint64_t& out) {
+    MappedFile file;
+    if (!file.Open(p)) return false;
+    out = HashBytes(file.data(), file.size());
+    return true;
+}
+
+inline std::string HashToHex(uint64_t h) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+    return std::string(buf, 16);
+}
+
+#endif // CONTENT_HASH_H
@@ -0,0 +1,243 @@
+#include "design_generator.h"
+#include "1.bmp_extract/bmp_extract.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// splitmix64: 与标准库分布实现无关, 保证跨平台结果一致
+class DesignRng {
+public:
+    explicit DesignRng(uint64_t seed) : state_(seed) {}
+    uint64_t Next() {
+        uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    int Below(int n) { return n <= 1 ? 0 : (int)(Next() % (uint64_t)n); }
+    double Unit() { return (double)(Next() >> 11) / 9007199254740992.0; }
+
+private:
+    uint64_t state_;
+};
+
+bool ParseHexColor(const std::string& s, LayerColor& c) {
+    if (s.size() != 7 || s[0] != '#') return false;
+    uint32_t v = 0;
+    for (size_t i = 1; i < 7; ++i) {
+        char ch = s[i];
+        int d = (ch >= '0' && ch <= '9') ? ch - '0'
+              : (ch >= 'A' && ch <= 'F') ? ch - 'A' + 10
+              : (ch >= 'a' && ch <= 'f') ? ch - 'a' + 10 : -1;
+        if (d < 0) return false;
+        v = (v << 4) | (uint32_t)d;
+    }
+    c.r = (uint8_t)(v >> 16);
+    c.g = (uint8_t)(v >> 8);
+    c.b = (uint8_t)v;
+    c.a = 0;
+    return true;
+}
+
+// 图层可用的颜色, 按码值 (数字按大小) 排序; shaxian 每个码值只取一种颜色, 且不使用 #000000 (合并时视同 #800000)
+std::vector<LayerColor> LayerColors(const YimaConfig& cfg, int layer) {
+    std::vector<std::pair<std::string, std::string>> entries;   // (码值, 颜色)
+    auto it = cfg.colorMap.find(LAYER_NAMES[layer]);
+    if (it != cfg.colorMap.end()) {
+        for (const auto& [color, code] : it->second) entries.emplace_back(code, color);
+    }
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+        if (a.first.size() != b.first.size()) return a.first.size() < b.first.size();
+        return a < b;
+    });
+    std::vector<LayerColor> colors;
+    std::set<std::string> codes;
+    for (const auto& [code, color] : entries) {
+        LayerColor c;
+        if (!ParseHexColor(color, c)) continue;
+        if (layer == LAYER_SHAXIAN && (color == "#000000" || !codes.insert(code).second)) continue;
+        colors.push_back(c);
+        if (colors.size() == 256) break;
+    }
+    return colors;
+}
+
+void InitGrid(LayerGrid& g, const DesignSpec& spec, std::vector<LayerColor> palette) {
+    g.width = spec.width;
+    g.height = spec.height;
+    g.palette = std::move(palette);
+    g.indices.assign((size_t)spec.width * spec.height, 0);
+}
+
+template <typename Fn>
+void Fill(LayerGrid& g, Fn&& fn) {
+    for (int y = 0; y < g.height; ++y) {
+        uint8_t* row = g.indices.data() + (size_t)g.width * y;
+        for (int x = 0; x < g.width; ++x) row[x] = (uint8_t)fn(x, y);
+    }
+}
+
+// 逐行取一个值 (同一行内不变)
+template <typename Fn>
+void FillRows(LayerGrid& g, Fn&& fn) {
+    for (int y = 0; y < g.height; ++y) {
+        uint8_t v = (uint8_t)fn(y);
+        std::fill_n(g.indices.data() + (size_t)g.width * y, g.width, v);
+    }
+}
+
+// side x side 的随机图案, rowWise 时每行取同一个值
+std::vector<uint8_t> Motif(DesignRng& rng, int side, int colors, bool rowWise) {
+    std::vector<uint8_t> m((size_t)side * side);
+    for (int y = 0; y < side; ++y) {
+        int rowValue = rng.Below(colors);
+        for (int x = 0; x < side; ++x) m[(size_t)side * y + x] = (uint8_t)(rowWise ? rowValue : rng.Below(colors));
+    }
+    return m;
+}
+
+// 保证 shaxian 的每种颜色都至少出现一次, 使种类数与 shaxianTypes 一致 (像素数不少于颜色数)
+void EnsureAllUsed(LayerGrid& g) {
+    std::vector<size_t> count(g.palette.size(), 0);
+    for (uint8_t v : g.indices) ++count[v];
+    size_t slot = 0;
+    for (size_t k = 0; k < count.size(); ++k) {
+        if (count[k]) continue;
+        // 从开头起找一个所在颜色出现不止一次的像素改为颜色 k
+        while (count[g.indices[slot]] <= 1) ++slot;
+        --count[g.indices[slot]];
+        g.indices[slot++] = (uint8_t)k;
+        count[k] = 1;
+    }
+}
+
+} // namespace
+
+bool ParseDesignPattern(const std::string& name, DesignPattern& pattern) {
+    static const std::pair<const char*, DesignPattern> names[] = {
+        { "random", DesignPattern::Random }, { "striped", DesignPattern::Striped }, { "tiled", DesignPattern::Tiled },
+        { "sparse", DesignPattern::Sparse }, { "yarn", DesignPattern::YarnSwitch } };
+    for (const auto& [n, p] : names) {
+        if (name == n) {
+            pattern = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* DesignPatternName(DesignPattern pattern) {
+    switch (pattern) {
+        case DesignPattern::Random: return "random";
+        case DesignPattern::Striped: return "striped";
+        case DesignPattern::Tiled: return "tiled";
+        case DesignPattern::Sparse: return "sparse";
+        case DesignPattern::YarnSwitch: return "yarn";
+    }
+    return "random";
+}
+
+std::vector<int> SignCycleTypes(const YimaConfig& cfg) {
+    std::vector<int> types;
+    for (const auto& [key, cycle] : cfg.signCycles) {
+        char* end = nullptr;
+        long n = std::strtol(key.c_str(), &end, 10);
+        if (end && *end == '\0' && n > 0 && !cycle.empty()) types.push_back((int)n);
+    }
+    std::sort(types.begin(), types.end());
+    return types;
+}
+
+int GenerateDesign(const YimaConfig& cfg, const DesignSpec& spec, GeneratedDesign& out) {
+    out = GeneratedDesign();
+    if (spec.width <= 0 || spec.height <= 0) return -1;
+    std::vector<LayerColor> colors[LAYER_COUNT];
+    for (int l = 0; l < LAYER_COUNT; ++l) colors[l] = LayerColors(cfg, l);
+    if (colors[LAYER_SEMA].empty()) return -2;
+    const int yarns = std::max(spec.shaxianTypes, 1);
+    if ((int)colors[LAYER_SHAXIAN].size() < yarns || (size_t)spec.width * spec.height < (size_t)yarns) return -3;
+    colors[LAYER_SHAXIAN].resize(yarns);
+
+    for (int l = 0; l < LAYER_COUNT; ++l) {
+        if (!colors[l].empty()) InitGrid(out.layers[l], spec, colors[l]);
+    }
+    LayerGrid& sema = out.layers[LAYER_SEMA];
+    LayerGrid& shaxian = out.layers[LAYER_SHAXIAN];
+    LayerGrid& luola = out.layers[LAYER_LUOLA];
+    LayerGrid& dumu = out.layers[LAYER_DUMU];
+    const int nSema = (int)sema.palette.size();
+    const int nDumu = (int)dumu.palette.size();
+    const int nLuola = (int)luola.palette.size();
+    const int stripe = std::max(spec.stripe, 1);
+
+    // 每个图层使用独立的随机序列, 修改一个图层的生成方式不影响其他图层
+    DesignRng rngSema(spec.seed * 4 + 0), rngShaxian(spec.seed * 4 + 1), rngDumu(spec.seed * 4 + 2);
+    auto stripes = [&](LayerGrid& g, int n, int offset) { FillRows(g, [&](int y) { return (y / stripe + offset) % n; }); };
+
+    switch (spec.pattern) {
+        case DesignPattern::Random:
+            Fill(sema, [&](int, int) { return rngSema.Below(nSema); });
+            if (nDumu) Fill(dumu, [&](int, int) { return rngDumu.Below(nDumu); });
+            FillRows(shaxian, [&](int) { return rngShaxian.Below(yarns); });
+            break;
+        case DesignPattern::Striped:
+            stripes(sema, nSema, 0);
+            if (nDumu) stripes(dumu, nDumu, 1);
+            stripes(shaxian, yarns, 0);
+            break;
+        case DesignPattern::Tiled: {
+            const int side = std::max(spec.motif, 1);
+            auto tile = [&](LayerGrid& g, DesignRng& rng, int n, bool rowWise) {
+                std::vector<uint8_t> m = Motif(rng, side, n, rowWise);
+                Fill(g, [&](int x, int y) { return m[(size_t)side * (y % side) + (x % side)]; });
+            };
+            tile(sema, rngSema, nSema, false);
+            if (nDumu) tile(dumu, rngDumu, nDumu, false);
+            tile(shaxian, rngShaxian, yarns, true);
+            break;
+        }
+        case DesignPattern::Sparse: {
+            auto sparse = [&](DesignRng& rng, int n) { return rng.Unit() < spec.density ? rng.Below(n) : 0; };
+            Fill(sema, [&](int, int) { return sparse(rngSema, nSema); });
+            if (nDumu) Fill(dumu, [&](int, int) { return sparse(rngDumu, nDumu); });
+            FillRows(shaxian, [&](int) { return sparse(rngShaxian, yarns); });
+            break;
+        }
+        case DesignPattern::YarnSwitch: {
+            stripes(sema, nSema, 0);
+            if (nDumu) stripes(dumu, nDumu, 1);
+            int current = 0, left = 0;
+            Fill(shaxian, [&](int, int) {
+                if (left-- <= 0) {
+                    if (yarns > 1) current = (current + 1 + rngShaxian.Below(yarns - 1)) % yarns;
+                    left = rngShaxian.Below(4);
+                }
+                return current;
+            });
+            break;
+        }
+    }
+    if (nLuola) stripes(luola, nLuola, 0);
+    EnsureAllUsed(shaxian);
+    return 0;
+}
+
+int WriteDesignDir(const GeneratedDesign& design, const fs::path& dir) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    for (int l = 0; l < LAYER_COUNT; ++l) {
+        const LayerGrid& g = design.layers[l];
+        if (g.width == 0) continue;
+        std::vector<uint8_t> bmp = EncodeBmpLayer(g);
+        std::ofstream out(dir / (std::string(LAYER_NAMES[l]) + ".bmp"), std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(bmp.data()), (std::streamsize)bmp.size());
+        if (!out.good()) return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef DESIGN_GENERATOR_H
+#define DESIGN_GENERATOR_H
+
+/*
+ * 合成设计生成器: 按配置生成 sema/shaxian/luola/dumu 四个图层, 用于基准测试与压力测试
+ *
+ * 每个图层只使用 color_to_number.toml 中该图层已配置的颜色, 生成结果可直接交给流水线。
+ * shaxian 实际使用的颜色种类数 (即 zhenban_qianhou.toml 中 line_sign 循环的键) 可以指定,
+ * 从而覆盖各个行符号循环长度。相同的参数与种子在任何平台上生成逐字节相同的设计。
+ */
+
+#include "yima_config.h"
+#include "ylayer_format.h"
+#include "ycombined_format.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+enum class DesignPattern {
+    Random,      // sema/dumu 逐像素随机, shaxian 逐行随机
+    Striped,     // 各图层按 stripe 行一条横纹轮换
+    Tiled,       // motif x motif 的随机图案平铺
+    Sparse,      // 以第一种颜色为底, 约 density 比例的像素随机着色
+    YarnSwitch,  // sema/dumu 横纹, shaxian 每 1-4 个像素换一次纱线 (换纱指令密集)
+};
+
+struct DesignSpec {
+    int width = 100;
+    int height = 500;
+    DesignPattern pattern = DesignPattern::Random;
+    uint64_t seed = 1;
+    int shaxianTypes = 2;      // shaxian 使用的颜色种类数, 不超过配置中可用的种类
+    int stripe = 8;            // Striped / YarnSwitch 的横纹行数
+    int motif = 16;            // Tiled 的图案边长
+    double density = 0.05;     // Sparse 的着色比例
+};
+
+// 生成结果, 图层顺序为 sema/shaxian/luola/dumu; 配置中没有颜色的图层宽高为 0 (视为缺失)
+struct GeneratedDesign {
+    LayerGrid layers[LAYER_COUNT];
+};
+
+// 名称 (random / striped / tiled / sparse / yarn) 与图案互相转换, 无法识别时返回 false
+bool ParseDesignPattern(const std::string& name, DesignPattern& pattern);
+const char* DesignPatternName(DesignPattern pattern);
+
+// 配置中 line_sign 循环对应的 shaxian 种类数 (升序)
+std::vector<int> SignCycleTypes(const YimaConfig& cfg);
+
+/**
+ * @brief 按 spec 生成四个图层
+ * @return 0: 成功, -1: 宽高无效, -2: 配置中缺少 sema 颜色, -3: shaxian 可用颜色少于 shaxianTypes
+ */
+int GenerateDesign(const YimaConfig& cfg, const DesignSpec& spec, GeneratedDesign& out);
+
+// 将图层写为 dir 下的 <layer>.bmp (目录不存在时创建), 成功返回 0, 写入失败返回 -1
+int WriteDesignDir(const GeneratedDesign& design, const std::filesystem::path& dir);
+
+#endif // DESIGN_GENERATOR_H
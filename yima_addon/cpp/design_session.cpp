@@ -0,0 +1,293 @@
+#include "design_session.h"
+#include "encoding_utils.h"
+#include "incremental_rows.h"
+#include "1.bmp_extract/bmp_extract.h"
+#include "2.toml_handle/toml_handle.h"
+#include "4.cmd_csv_handle/cmd_csv_handle.h"
+#include "5.txt_generator/txt_generator.h"
+#include "yima_log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <set>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+// 只保留实际使用的颜色, 与 DecodeBmpLayer 的结果在合并时等价
+static LayerGrid CompactLayer(const LayerGrid& src) {
+    std::vector<int> map(src.palette.size(), -1);
+    for (uint8_t v : src.indices) map[v] = 0;
+    LayerGrid out;
+    out.width = src.width;
+    out.height = src.height;
+    for (size_t i = 0; i < map.size(); ++i) {
+        if (map[i] < 0) continue;
+        map[i] = (int)out.palette.size();
+        out.palette.push_back(src.palette[i]);
+    }
+    out.indices.resize(src.indices.size());
+    for (size_t i = 0; i < src.indices.size(); ++i) out.indices[i] = (uint8_t)map[src.indices[i]];
+    return out;
+}
+
+int DesignSession::Open(std::shared_ptr<const YimaConfig> cfg, const BmpBuffer layers[LAYER_COUNT]) {
+    LayerGrid grids[LAYER_COUNT];
+    bool present[LAYER_COUNT] = {};
+    for (int li = 0; li < LAYER_COUNT; ++li) {
+        if (!layers[li].data) continue;
+        if (!DecodeBmpLayer(layers[li].data, layers[li].size, grids[li])) {
+            YIMA_LOG_ERROR("Session") << "Failed to decode layer: " << LAYER_NAMES[li];
+            return -1;
+        }
+        present[li] = true;
+    }
+    return Adopt(std::move(cfg), grids, present);
+}
+
+int DesignSession::OpenDir(std::shared_ptr<const YimaConfig> cfg, const std::string& input_path) {
+    fs::path dir = CreatePathFromUtf8(input_path);
+    if (!fs::is_directory(dir)) return -1;
+    LayerGrid grids[LAYER_COUNT];
+    bool present[LAYER_COUNT] = {};
+    for (int li = 0; li < LAYER_COUNT; ++li) {
+        fs::path file = dir / (std::string(LAYER_NAMES[li]) + ".bmp");
+        if (!fs::exists(file)) continue;
+        if (!DecodeBmpLayerFile(file, grids[li])) {
+            YIMA_LOG_ERROR("Session") << "Failed to decode layer: " << file.string();
+            return -1;
+        }
+        present[li] = true;
+    }
+    return Adopt(std::move(cfg), grids, present);
+}
+
+int DesignSession::Adopt(std::shared_ptr<const YimaConfig> cfg, LayerGrid grids[LAYER_COUNT], const bool present[LAYER_COUNT]) {
+    // 编辑器中的图层必须同尺寸, 否则编辑坐标没有统一含义
+    int w = -1, h = -1;
+    for (int li = 0; li < LAYER_COUNT; ++li) {
+        if (!present[li]) continue;
+        if (w >= 0 && (grids[li].width != w || grids[li].height != h)) {
+            YIMA_LOG_ERROR("Session") << "Layer " << LAYER_NAMES[li] << " is " << grids[li].width << "x" << grids[li].height
+                                      << ", expected " << w << "x" << h;
+            return -2;
+        }
+        w = grids[li].width;
+        h = grids[li].height;
+    }
+    if (w <= 0 || h <= 0) return -5;
+
+    cfg_ = std::move(cfg);
+    width_ = w;
+    height_ = h;
+    for (int li = 0; li < LAYER_COUNT; ++li) {
+        present_[li] = present[li];
+        layers_[li] = present[li] ? std::move(grids[li]) : LayerGrid();
+    }
+    shaxianCounts_.assign(layers_[LAYER_SHAXIAN].palette.size(), 0);
+    for (uint8_t v : layers_[LAYER_SHAXIAN].indices) ++shaxianCounts_[v];
+
+    dirtyRows_.assign((size_t)height_, 0);
+    anyDirty_ = false;
+    recombine_ = true;
+    rows_.clear();
+    tokens_.clear();
+    lineCount_ = 0;
+    std::lock_guard<std::mutex> lock(programMutex_);
+    simple_.reset();
+    compressed_.reset();
+    return 0;
+}
+
+int DesignSession::AddColor(int layer, const LayerColor& color) {
+    std::vector<LayerColor>& pal = layers_[layer].palette;
+    for (size_t i = 0; i < pal.size(); ++i) {
+        if (pal[i].r == color.r && pal[i].g == color.g && pal[i].b == color.b) return (int)i;
+    }
+    if (pal.size() >= 256) return -1;
+    pal.push_back(color);
+    remap_[layer].push_back(-1);
+    if (layer == LAYER_SHAXIAN) shaxianCounts_.push_back(0);
+    return (int)pal.size() - 1;
+}
+
+int DesignSession::SetPixels(int layer, int x, int y, int w, int h, const uint8_t* data, size_t size) {
+    if (layer < 0 || layer >= LAYER_COUNT || !present_[layer]) return -1;
+    if (x < 0 || y < 0 || w < 0 || h < 0 || x + w > width_ || y + h > height_) return -2;
+    if (size != (size_t)w * h) return -3;
+    LayerGrid& grid = layers_[layer];
+    for (size_t i = 0; i < size; ++i) if (data[i] >= grid.palette.size()) return -4;
+
+    for (int row = 0; row < h; ++row) {
+        uint8_t* dst = grid.indices.data() + (size_t)(y + row) * width_ + x;
+        const uint8_t* src = data + (size_t)row * w;
+        if (layer == LAYER_SHAXIAN) {
+            for (int i = 0; i < w; ++i) { --shaxianCounts_[dst[i]]; ++shaxianCounts_[src[i]]; }
+        }
+        std::memcpy(dst, src, (size_t)w);
+        dirtyRows_[(size_t)(y + row)] = 1;
+    }
+    if (h > 0 && w > 0) anyDirty_ = true;
+    return 0;
+}
+
+int DesignSession::UsedShaxianTypes() const {
+    if (!present_[LAYER_SHAXIAN]) return 0;
+    std::set<std::string> used;
+    for (size_t i = 0; i < shaxianCounts_.size(); ++i) {
+        if (!shaxianCounts_[i]) continue;
+        std::string hex = LayerColorHex(layers_[LAYER_SHAXIAN].palette[i]);
+        used.insert(hex == "#000000" ? "#800000" : hex);   // 与 MakeLayerInput 的 all_pixels 规则一致
+    }
+    return (int)used.size();
+}
+
+// 只更新脏行的码值; 遇到字典中没有的颜色或 sign 周期变化时返回 false, 需要完整合并
+bool DesignSession::UpdateDirtyRows() {
+    if (UsedShaxianTypes() != design_.shaxianTypes) return false;
+    for (int y = 1; y <= height_; ++y) {
+        if (!dirtyRows_[(size_t)y - 1]) continue;
+        size_t offset = (size_t)(y - 1) * width_;
+        for (int li = 0; li < LAYER_COUNT; ++li) {
+            if (!present_[li]) continue;
+            const uint8_t* src = layers_[li].indices.data() + offset;
+            uint8_t* dst = design_.codes[li].data() + offset;
+            for (int x = 0; x < width_; ++x) {
+                int code = remap_[li][src[x]];
+                if (code < 0) return false;
+                dst[x] = (uint8_t)code;
+            }
+        }
+    }
+    return true;
+}
+
+void DesignSession::Combine() {
+    LayerInput inputs[LAYER_COUNT];
+    for (int li = 0; li < LAYER_COUNT; ++li) {
+        if (present_[li]) inputs[li] = MakeLayerInput(LAYER_NAMES[li], CompactLayer(layers_[li]));
+    }
+    CombineLayers(inputs, *cfg_, design_);
+    view_.Attach(design_);
+
+    // 调色板中未使用的颜色可能不在字典中, 记为 -1, 之后被使用时重新合并
+    for (int li = 0; li < LAYER_COUNT; ++li) {
+        std::unordered_map<std::string, int> index;
+        for (size_t i = 0; i < design_.dict[li].size(); ++i) index.emplace(design_.dict[li][i], (int)i);
+        remap_[li].assign(layers_[li].palette.size(), -1);
+        for (size_t i = 0; i < layers_[li].palette.size(); ++i) {
+            auto it = index.find(MapLayerColor(*cfg_, li, LayerColorHex(layers_[li].palette[i])));
+            if (it != index.end()) remap_[li][i] = it->second;
+        }
+    }
+}
+
+void DesignSession::GenerateProgram(SessionStats& stats) {
+    const YimaConfig& cfg = *cfg_;
+    std::shared_ptr<const std::string> oldSimple, oldCompressed;
+    Program(oldSimple, oldCompressed);
+    const bool reuse = oldSimple && rows_.size() == (size_t)height_;
+
+    std::vector<uint64_t> keys = ComputeRowKeys(view_);
+    auto simple = std::make_shared<std::string>();
+    simple->reserve(oldSimple ? oldSimple->size() : (size_t)width_ * height_ * 64);
+    std::string rawHead;
+    AppendProgramHead(cfg, rawHead, *simple);
+    size_t line = SplitProgramLines(*simple).size();
+
+    std::vector<LineBlock> same;
+    auto addSame = [&](size_t newStart, size_t oldStart, size_t len) {
+        if (len == 0) return;
+        if (!same.empty() && same.back().newStart + same.back().len == newStart &&
+            same.back().oldStart + same.back().len == oldStart) {
+            same.back().len += len;
+            return;
+        }
+        LineBlock b;
+        b.newStart = newStart;
+        b.oldStart = oldStart;
+        b.len = len;
+        same.push_back(b);
+    };
+    if (reuse) addSame(0, 0, line);
+
+    std::vector<RowSlice> rows((size_t)height_);
+    SimpleProgramSink sink(*simple);
+    for (int y = 1; y <= height_; ++y) {
+        RowSlice& r = rows[(size_t)y - 1];
+        r.key = keys[(size_t)y - 1];
+        r.begin = simple->size();
+        r.line = line;
+        if (reuse && rows_[(size_t)y - 1].key == r.key) {
+            const RowSlice& o = rows_[(size_t)y - 1];
+            simple->append(*oldSimple, o.begin, o.end - o.begin);
+            r.lines = o.lines;
+            addSame(line, o.line, o.lines);
+        } else {
+            CmdWalkState st = CmdEntryState(view_, y);
+            WalkCmdRow(view_, cfg, y, st, sink);
+            r.lines = SplitProgramLines(std::string_view(*simple).substr(r.begin)).size();
+            ++stats.regeneratedRows;
+        }
+        r.end = simple->size();
+        line += r.lines;
+    }
+
+    std::string rawTail;
+    size_t bodyEnd = simple->size();
+    AppendProgramTail(cfg, rawTail, *simple);
+    size_t tailLines = SplitProgramLines(std::string_view(*simple).substr(bodyEnd)).size();
+    if (reuse) addSame(line, lineCount_ - tailLines, tailLines);
+
+    std::vector<std::string_view> lines = SplitProgramLines(*simple);
+    auto compressed = std::make_shared<std::string>();
+    std::vector<CompressToken> tokens;
+    if (reuse) {
+        stats.reusedSegments = CompressSpliced(lines, same, lineCount_, *oldCompressed, tokens_, *compressed, tokens);
+    } else {
+        CompressTracked(lines, *compressed, tokens);
+    }
+    stats.rows = height_;
+    stats.segments = tokens.size();
+
+    rows_ = std::move(rows);
+    tokens_ = std::move(tokens);
+    lineCount_ = lines.size();
+    std::lock_guard<std::mutex> lock(programMutex_);
+    simple_ = std::move(simple);
+    compressed_ = std::move(compressed);
+}
+
+int DesignSession::Regenerate(SessionStats& stats) {
+    auto t0 = std::chrono::steady_clock::now();
+    stats = SessionStats();
+    try {
+        if (!recombine_ && anyDirty_ && !UpdateDirtyRows()) recombine_ = true;
+        if (recombine_) {
+            try {
+                Combine();
+            } catch (const std::exception& e) {
+                YIMA_LOG_ERROR("Session") << "Combine failed: " << e.what();
+                return -2;
+            }
+            recombine_ = false;
+            stats.recombined = true;
+        }
+        std::fill(dirtyRows_.begin(), dirtyRows_.end(), 0);
+        anyDirty_ = false;
+
+        GenerateProgram(stats);
+    } catch (const std::exception& e) {
+        YIMA_LOG_ERROR("Session") << "Exception: " << e.what();
+        return -100;
+    }
+    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return 0;
+}
+
+void DesignSession::Program(std::shared_ptr<const std::string>& simple, std::shared_ptr<const std::string>& compressed) const {
+    std::lock_guard<std::mutex> lock(programMutex_);
+    simple = simple_;
+    compressed = compressed_;
+}
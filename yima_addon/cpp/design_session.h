@@ -0,0 +1,101 @@
+#ifndef DESIGN_SESSION_H
+#define DESIGN_SESSION_H
+
+/*
+ * 常驻内存的设计会话 (供交互式编辑器使用)
+ *
+ * 会话持有解码后的四个图层, 已加载的配置, 合并结果以及上一次生成的指令。
+ * SetPixels 只修改图层像素并标记脏行; Regenerate 只重新合并脏行,
+ * 再按行键 (见 incremental_rows.h) 复用未变化的行与压缩片段, 结果与 translateBuffers 完全一致。
+ * 以下情况退化为完整合并: 首次生成, 调色板新增颜色后被使用, shaxian 实际使用的颜色种类数变化。
+ */
+
+#include "yima_config.h"
+#include "ylayer_format.h"
+#include "ycombined_format.h"
+#include "yima_pipeline.h"
+#include "6.txt_handle/txt_handle.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct SessionStats {
+    bool recombined = false;       // 是否执行了完整合并
+    int rows = 0;
+    int regeneratedRows = 0;
+    size_t segments = 0;           // 压缩片段总数
+    size_t reusedSegments = 0;
+    double ms = 0;
+};
+
+class DesignSession {
+public:
+    // 由内存中的 BMP 数据 (顺序为 sema/shaxian/luola/dumu, data 为空表示缺失) 建立会话
+    // 返回 0: 成功, -1: BMP 解码失败, -2: 图层宽高不一致, -5: 设计为空
+    int Open(std::shared_ptr<const YimaConfig> cfg, const BmpBuffer layers[LAYER_COUNT]);
+
+    // 同上, 读取 input_path 目录下的 sema/shaxian/luola/dumu.bmp; 目录不存在时返回 -1
+    int OpenDir(std::shared_ptr<const YimaConfig> cfg, const std::string& input_path);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    bool HasLayer(int layer) const { return present_[layer]; }
+    const LayerGrid& Layer(int layer) const { return layers_[layer]; }
+
+    // 在图层调色板末尾追加颜色 (已存在时返回原索引), 调色板已满时返回 -1
+    int AddColor(int layer, const LayerColor& color);
+
+    /**
+     * @brief 写入矩形区域的调色板索引, 坐标 0 起始 (第 0 行对应 y = 1), data 按行主序排列
+     * @return 0: 成功, -1: 图层缺失, -2: 区域越界, -3: 数据长度不符, -4: 索引超出调色板
+     */
+    int SetPixels(int layer, int x, int y, int w, int h, const uint8_t* data, size_t size);
+
+    // 重新生成指令, 返回 0: 成功, -2: 合并失败, -100: 异常
+    int Regenerate(SessionStats& stats);
+
+    // 最近一次生成的指令 (未生成时为空指针); 可与 Regenerate 并发调用
+    void Program(std::shared_ptr<const std::string>& simple, std::shared_ptr<const std::string>& compressed) const;
+
+private:
+    // 每行在 simple 中的位置, 供下一次生成时复用
+    struct RowSlice {
+        uint64_t key = 0;
+        size_t begin = 0;
+        size_t end = 0;
+        size_t line = 0;      // 起始行号 (SplitProgramLines 之后)
+        size_t lines = 0;
+    };
+
+    int Adopt(std::shared_ptr<const YimaConfig> cfg, LayerGrid grids[LAYER_COUNT], const bool present[LAYER_COUNT]);
+    bool UpdateDirtyRows();
+    void Combine();
+    int UsedShaxianTypes() const;
+    void GenerateProgram(SessionStats& stats);
+
+    std::shared_ptr<const YimaConfig> cfg_;
+    LayerGrid layers_[LAYER_COUNT];
+    bool present_[LAYER_COUNT] = {};
+    int width_ = 0;
+    int height_ = 0;
+    std::vector<uint32_t> shaxianCounts_;    // shaxian 图层每个调色板索引的使用次数
+
+    CombinedDesign design_;
+    YCombinedView view_;
+    std::vector<int> remap_[LAYER_COUNT];    // 调色板索引 -> 合并字典索引, -1 表示不在字典中
+    std::vector<uint8_t> dirtyRows_;
+    bool anyDirty_ = false;
+    bool recombine_ = true;
+
+    std::vector<RowSlice> rows_;
+    std::vector<CompressToken> tokens_;
+    size_t lineCount_ = 0;
+    mutable std::mutex programMutex_;
+    std::shared_ptr<const std::string> simple_;
+    std::shared_ptr<const std::string> compressed_;
+};
+
+#endif // DESIGN_SESSION_H
@@ -0,0 +1,405 @@
+#include "incremental_rows.h"
+#include "content_hash.h"
+#include "mapped_file.h"
+#include "yima_trace.h"
+#include "yima_probes.h"
+#include "4.cmd_csv_handle/cmd_csv_handle.h"
+#include "5.txt_generator/txt_generator.h"
+#include "6.txt_handle/txt_handle.h"
+#include "yima_log.h"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint32_t ROW_INDEX_VERSION = 1;
+
+#pragma pack(push, 1)
+struct RowIndexHeader {
+    char     magic[4];      // "YROW"
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint64_t configKey;     // 指令与头尾配置的哈希
+    uint64_t fileHash[4];   // pixel_cmd.csv, cmd_raw.txt, cmd_simple.txt, cmd_compressed.txt
+    uint64_t lineCount;     // cmd_simple.txt 经 SplitProgramLines 后的总行数
+    uint64_t tokenCount;
+};
+
+struct RowSpan {
+    uint64_t key;
+    uint64_t csv;           // 该行在各文件中的起始字节偏移
+    uint64_t raw;
+    uint64_t simple;
+    uint64_t line;          // 该行在 cmd_simple.txt 中的起始行号
+};
+#pragma pack(pop)
+
+// 行索引文件: [RowIndexHeader][RowSpan x (height + 1)][CompressToken x tokenCount]
+// 最后一个 RowSpan 记录正文结束位置 (尾部命令之前)
+struct RowIndex {
+    RowIndexHeader header{};
+    std::vector<RowSpan> rows;
+    std::vector<CompressToken> tokens;
+
+    bool Load(const fs::path& p) {
+        MappedFile file;
+        if (!file.Open(p) || file.size() < sizeof(RowIndexHeader)) return false;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, "YROW", 4) != 0 || header.version != ROW_INDEX_VERSION) return false;
+        size_t rowBytes = ((size_t)header.height + 1) * sizeof(RowSpan);
+        size_t tokenBytes = (size_t)header.tokenCount * sizeof(CompressToken);
+        if (file.size() != sizeof(RowIndexHeader) + rowBytes + tokenBytes) return false;
+        rows.resize((size_t)header.height + 1);
+        tokens.resize((size_t)header.tokenCount);
+        std::memcpy(rows.data(), file.data() + sizeof(RowIndexHeader), rowBytes);
+        if (tokenBytes) std::memcpy(tokens.data(), file.data() + sizeof(RowIndexHeader) + rowBytes, tokenBytes);
+        for (size_t i = 1; i < rows.size(); ++i) {
+            if (rows[i].csv < rows[i - 1].csv || rows[i].raw < rows[i - 1].raw ||
+                rows[i].simple < rows[i - 1].simple || rows[i].line < rows[i - 1].line) return false;
+        }
+        return true;
+    }
+
+    bool Save(const fs::path& p) const {
+        fs::path tmp = p;
+        tmp += ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) return false;
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(rows.data()), rows.size() * sizeof(RowSpan));
+            out.write(reinterpret_cast<const char*>(tokens.data()), tokens.size() * sizeof(CompressToken));
+            if (!out.good()) return false;
+        }
+        std::error_code ec;
+        fs::rename(tmp, p, ec);
+        return !ec;
+    }
+};
+
+// 与 std::ofstream 文本模式写出的字节一致 (Windows 下换行写作 \r\n)
+void AppendTextMode(std::string& dst, std::string_view s) {
+#ifdef _WIN32
+    for (char c : s) {
+        if (c == '\n') dst += '\r';
+        dst += c;
+    }
+#else
+    dst.append(s.data(), s.size());
+#endif
+}
+
+// 写出文件的同时累积 FNV-1a 内容哈希与字节偏移
+class HashedWriter {
+public:
+    bool Open(const fs::path& p) {
+        out_.open(p, std::ios::binary | std::ios::trunc);
+        return out_.is_open();
+    }
+    void Write(std::string_view s) {
+        out_.write(s.data(), s.size());
+        hash_ = HashBytes(s.data(), s.size(), hash_);
+        size_ += s.size();
+    }
+    bool Close() {
+        out_.close();
+        return !out_.fail();
+    }
+    uint64_t offset() const { return size_; }
+    uint64_t hash() const { return hash_; }
+
+private:
+    std::ofstream out_;
+    uint64_t hash_ = FNV_OFFSET_BASIS;
+    uint64_t size_ = 0;
+};
+
+// 同时转发给 CSV 与 TXT 两个输出
+class TeeRowSink : public CmdRowSink {
+public:
+    TeeRowSink(CmdRowSink& a, CmdRowSink& b) : a_(a), b_(b) {}
+    void PixelRow(int index, const std::string& pre, const std::string& dumu,
+                  const std::string& sema, const std::string& post) override {
+        a_.PixelRow(index, pre, dumu, sema, post);
+        b_.PixelRow(index, pre, dumu, sema, post);
+    }
+    void ShaxianSwitchRow(const std::string& cmd) override {
+        a_.ShaxianSwitchRow(cmd);
+        b_.ShaxianSwitchRow(cmd);
+    }
+    void LineSwitchRow(const std::string& luola, const std::string& lineSwitch) override {
+        a_.LineSwitchRow(luola, lineSwitch);
+        b_.LineSwitchRow(luola, lineSwitch);
+    }
+
+private:
+    CmdRowSink& a_;
+    CmdRowSink& b_;
+};
+
+uint64_t ProgramConfigKey(const YimaConfig& cfg) {
+    static const char* const files[] = {
+        "dumu_to_cmd.toml", "pre_action_to_cmd.toml", "post_action_to_cmd.toml", "sema_to_cmd.toml",
+        "luola_to_cmd.toml", "line_switch_to_cmd.toml", "shaxian_switch_to_cmd.toml", "head_tail_cmd.toml" };
+    uint64_t key = HashString("yima-rows-1");
+    for (const char* f : files) key = HashCombine(key, cfg.SourceHash(f));
+    return key;
+}
+
+} // namespace
+
+std::vector<uint64_t> ComputeRowKeys(const YCombinedView& grid) {
+    const int W = grid.width(), H = grid.height();
+    std::vector<uint64_t> dictHash[LAYER_COUNT];
+    for (int l = 0; l < LAYER_COUNT; ++l) {
+        for (const auto& s : grid.Dict(l)) dictHash[l].push_back(HashString(s));
+    }
+    std::vector<uint64_t> signHash, zhenbanHash;
+    for (const auto& s : grid.SignDict()) signHash.push_back(HashString(s));
+    for (size_t k = 0; k < grid.Dict(LAYER_SEMA).size(); ++k) {
+        zhenbanHash.push_back(HashString(grid.ZhenbanDict()[grid.ZhenbanIndex((uint8_t)k)]));
+    }
+
+    std::vector<uint64_t> keys((size_t)H);
+    for (int y = 1; y <= H; ++y) {
+        uint64_t h = HashCombine(HashCombine(FNV_OFFSET_BASIS, (uint64_t)y), (uint64_t)W);
+        for (int x = 1; x <= W; ++x) {
+            for (int l = 0; l < LAYER_COUNT; ++l) h = HashMix(h, dictHash[l][grid.CodeIndex(l, x, y)]);
+            h = HashMix(h, zhenbanHash[grid.CodeIndex(LAYER_SEMA, x, y)]);
+        }
+        h = HashMix(h, signHash[grid.SignIndex(y)]);
+
+        CmdWalkState st = CmdEntryState(grid, y);
+        h = HashMix(h, HashString(st.last_shaxian));
+        h = HashMix(h, HashString(st.last_zhenban));
+        h = HashMix(h, HashString(st.last_sign));
+
+        if (y < H) {
+            int nx = ((y + 1) % 2 != 0) ? W : 1;
+            h = HashMix(h, dictHash[LAYER_SHAXIAN][grid.CodeIndex(LAYER_SHAXIAN, nx, y + 1)]);
+        } else {
+            h = HashMix(h, HashString("end"));
+        }
+        keys[(size_t)y - 1] = h;
+    }
+    return keys;
+}
+
+namespace {
+
+std::string_view Slice(const MappedFile& f, uint64_t begin, uint64_t end) {
+    return std::string_view(reinterpret_cast<const char*>(f.data()) + begin, (size_t)(end - begin));
+}
+
+void RemoveQuietly(const fs::path& p) {
+    std::error_code ec;
+    fs::remove(p, ec);
+}
+
+} // namespace
+
+bool CanWriteProgramRows(const YCombinedView& grid, const YimaConfig& cfg) {
+    return grid.width() > 0 && grid.height() > 0 && ProgramTxtMatchesCsv(cfg);
+}
+
+int WriteProgramRows(const YCombinedView& grid, const YimaConfig& cfg, const fs::path& output_dir,
+                     const fs::path& index_path, bool allow_reuse,
+                     ProgramFileHashes& hashes, RowUpdateStats& stats) {
+    const int W = grid.width(), H = grid.height();
+    stats = RowUpdateStats();
+    stats.rows = H;
+
+    const fs::path paths[4] = { output_dir / "pixel_cmd.csv", output_dir / "cmd_raw.txt",
+                                output_dir / "cmd_simple.txt", output_dir / "cmd_compressed.txt" };
+    fs::path tmps[4];
+    for (int i = 0; i < 4; ++i) { tmps[i] = paths[i]; tmps[i] += ".tmp"; }
+    auto cleanup = [&](int code) {
+        for (const auto& t : tmps) RemoveQuietly(t);
+        return code;
+    };
+
+    const uint64_t configKey = ProgramConfigKey(cfg);
+    const std::vector<uint64_t> keys = ComputeRowKeys(grid);
+
+    // 1. 旧行索引只有在尺寸, 配置以及四个输出文件都与其记录一致时才可复用
+    RowIndex old;
+    MappedFile oldCsv, oldRaw, oldSimple;
+    std::string oldCompressed;
+    bool reuse = allow_reuse && old.Load(index_path) && old.header.width == (uint32_t)W &&
+                 old.header.height == (uint32_t)H && old.header.configKey == configKey;
+    for (int i = 0; reuse && i < 4; ++i) {
+        uint64_t h = 0;
+        reuse = HashFile(paths[i], h) && h == old.header.fileHash[i];
+    }
+    if (reuse) {
+        reuse = oldCsv.Open(paths[0]) && oldRaw.Open(paths[1]) && oldSimple.Open(paths[2]) &&
+                old.rows[H].csv <= oldCsv.size() && old.rows[H].raw <= oldRaw.size() && old.rows[H].simple <= oldSimple.size();
+        // 压缩输出以文本模式写出, 同样以文本模式读回, 片段偏移才与内存中的输出一致
+        std::ifstream in(paths[3]);
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        oldCompressed = buffer.str();
+    }
+    stats.reusedIndex = reuse;
+
+    // 2. 逐行写出 CSV 与 TXT: 键未变的行复制旧字节, 其余行重新遍历生成
+    HashedWriter csv, raw, simple;
+    if (!csv.Open(tmps[0])) return cleanup(-4);
+    if (!raw.Open(tmps[1]) || !simple.Open(tmps[2])) return cleanup(-5);
+
+    std::string header;
+    const unsigned char BOM[] = {0xEF, 0xBB, 0xBF};
+    header.append(reinterpret_cast<const char*>(BOM), sizeof(BOM));
+    AppendTextMode(header, "INDEX,PRE_ACTION_CMD,DUMU_CMD,SEMA_CMD,POST_ACTION_CMD,LUOLA_CMD,LINE_SWITCH_CMD,SHAXIAN_SWITCH_CMD\n");
+    csv.Write(header);
+
+    std::string rawPart, simplePart;
+    AppendProgramHead(cfg, rawPart, simplePart);
+    raw.Write(rawPart);
+    simple.Write(simplePart);
+    uint64_t line = SplitProgramLines(simplePart).size();
+
+    // 新旧 cmd_simple.txt 中内容相同的行区间 (头部, 复用的行, 尾部), 相邻区间合并
+    std::vector<LineBlock> same;
+    auto addSame = [&](uint64_t newStart, uint64_t oldStart, uint64_t len) {
+        if (len == 0) return;
+        if (!same.empty() && same.back().newStart + same.back().len == newStart &&
+            same.back().oldStart + same.back().len == oldStart) {
+            same.back().len += len;
+            return;
+        }
+        LineBlock b;
+        b.newStart = newStart;
+        b.oldStart = oldStart;
+        b.len = len;
+        same.push_back(b);
+    };
+    if (reuse) addSame(0, 0, line);
+
+    RowIndex idx;
+    idx.rows.resize((size_t)H + 1);
+    std::string csvChunk, rawChunk, simpleChunk;
+    for (int y = 1; y <= H; ++y) {
+        RowSpan& r = idx.rows[(size_t)y - 1];
+        r.key = keys[(size_t)y - 1];
+        r.csv = csv.offset();
+        r.raw = raw.offset();
+        r.simple = simple.offset();
+        r.line = line;
+
+        if (reuse && old.rows[(size_t)y - 1].key == r.key) {
+            const RowSpan& o = old.rows[(size_t)y - 1];
+            const RowSpan& on = old.rows[(size_t)y];
+            csv.Write(Slice(oldCsv, o.csv, on.csv));
+            raw.Write(Slice(oldRaw, o.raw, on.raw));
+            simple.Write(Slice(oldSimple, o.simple, on.simple));
+            YIMA_PROBE2(row__reuse, y, on.csv - o.csv);
+            addSame(line, o.line, on.line - o.line);
+            line += on.line - o.line;
+            continue;
+        }
+
+        TraceSpan span("row", "rows");
+        span.Arg("y", y);
+        std::ostringstream csvRows;
+        CsvRowSink csvSink(csvRows);
+        rawChunk.clear();
+        simpleChunk.clear();
+        ProgramTxtSink txtSink(rawChunk, simpleChunk);
+        TeeRowSink tee(csvSink, txtSink);
+        CmdWalkState st = CmdEntryState(grid, y);
+        WalkCmdRow(grid, cfg, y, st, tee);
+
+        csvChunk.clear();
+        AppendTextMode(csvChunk, csvRows.str());
+        csv.Write(csvChunk);
+        raw.Write(rawChunk);
+        simple.Write(simpleChunk);
+        line += SplitProgramLines(simpleChunk).size();
+        ++stats.regeneratedRows;
+    }
+
+    RowSpan& end = idx.rows[(size_t)H];
+    end.key = 0;
+    end.csv = csv.offset();
+    end.raw = raw.offset();
+    end.simple = simple.offset();
+    end.line = line;
+
+    rawPart.clear();
+    simplePart.clear();
+    AppendProgramTail(cfg, rawPart, simplePart);
+    raw.Write(rawPart);
+    simple.Write(simplePart);
+    uint64_t tailLines = SplitProgramLines(simplePart).size();
+    if (reuse) addSame(line, old.rows[(size_t)H].line, tailLines);
+    const uint64_t lineCount = line + tailLines;
+
+    if (!csv.Close()) return cleanup(-4);
+    if (!raw.Close() || !simple.Close()) return cleanup(-5);
+    oldCsv.Close();
+    oldRaw.Close();
+    oldSimple.Close();
+
+    // 3. 压缩: 只在变化的行附近重新计算片段
+    std::string compressed;
+    {
+        TraceSpan span("compress", "rows");
+        MappedFile simpleFile(tmps[2]);
+        if (!simpleFile.IsOpen() && simple.offset() > 0) return cleanup(-6);
+        std::vector<std::string_view> lines = SplitProgramLines(
+            std::string_view(reinterpret_cast<const char*>(simpleFile.data()), simpleFile.size()));
+        if (reuse && lines.size() == lineCount) {
+            stats.reusedTokens = CompressSpliced(lines, same, (size_t)old.header.lineCount, oldCompressed,
+                                                 old.tokens, compressed, idx.tokens);
+        } else {
+            CompressTracked(lines, compressed, idx.tokens);
+        }
+        stats.tokens = idx.tokens.size();
+        span.Arg("segments", (int64_t)stats.tokens);
+        span.Arg("reused", (int64_t)stats.reusedTokens);
+    }
+    {
+        std::ofstream outFile(tmps[3]);
+        if (!outFile.is_open()) return cleanup(-6);
+        outFile << compressed;
+        outFile.close();
+        if (outFile.fail()) return cleanup(-6);
+    }
+
+    hashes.csv = csv.hash();
+    hashes.raw = raw.hash();
+    hashes.simple = simple.hash();
+    if (!HashFile(tmps[3], hashes.compressed)) return cleanup(-6);
+
+    // 4. 替换输出并保存新的行索引
+    for (int i = 0; i < 4; ++i) {
+        std::error_code ec;
+        fs::rename(tmps[i], paths[i], ec);
+        if (ec) {
+            YIMA_LOG_ERROR("Rows") << "Cannot replace " << paths[i].string() << ": " << ec.message();
+            return cleanup(i == 0 ? -4 : (i == 3 ? -6 : -5));
+        }
+    }
+
+    std::memcpy(idx.header.magic, "YROW", 4);
+    idx.header.version = ROW_INDEX_VERSION;
+    idx.header.width = (uint32_t)W;
+    idx.header.height = (uint32_t)H;
+    idx.header.configKey = configKey;
+    idx.header.fileHash[0] = hashes.csv;
+    idx.header.fileHash[1] = hashes.raw;
+    idx.header.fileHash[2] = hashes.simple;
+    idx.header.fileHash[3] = hashes.compressed;
+    idx.header.lineCount = lineCount;
+    idx.header.tokenCount = idx.tokens.size();
+    if (!idx.Save(index_path)) YIMA_LOG_WARN("Rows") << "Cannot write " << index_path.string();
+    return 0;
+}
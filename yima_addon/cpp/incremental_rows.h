@@ -0,0 +1,52 @@
+#ifndef INCREMENTAL_ROWS_H
+#define INCREMENTAL_ROWS_H
+
+/*
+ * 阶段 4-6 的行级增量生成
+ *
+ * 设计的每一行在 pixel_cmd.csv / cmd_raw.txt / cmd_simple.txt 中对应一段连续内容, 这段内容只取决于:
+ *   该行全部像素的码值与行符号, 行首的遍历状态 (上一行最后一个像素的 shaxian/zhenban/sign),
+ *   下一行第一个像素的 shaxian (换行指令), 以及行号 (INDEX 列)。
+ * 这些输入的哈希作为行键, 与上次运行的行索引 (toml/row_index.bin) 比较, 键未变的行直接复制旧文件中的对应字节。
+ * cmd_compressed.txt 按片段 (一条指令或一个 RS/RE 循环) 记录起始行与读取范围,
+ * 读取范围完全落在未变区间内的片段直接复用, 其余位置重新压缩, 结果与完整压缩逐字节一致。
+ */
+
+#include "ycombined_format.h"
+#include "yima_config.h"
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// 四个输出文件的内容哈希 (写出时顺带计算, 供构建清单使用)
+struct ProgramFileHashes {
+    uint64_t csv = 0;          // pixel_cmd.csv
+    uint64_t raw = 0;          // cmd_raw.txt
+    uint64_t simple = 0;       // cmd_simple.txt
+    uint64_t compressed = 0;   // cmd_compressed.txt
+};
+
+struct RowUpdateStats {
+    bool reusedIndex = false;  // 是否找到可用的旧行索引
+    int rows = 0;
+    int regeneratedRows = 0;
+    size_t tokens = 0;
+    size_t reusedTokens = 0;
+};
+
+// 每行的键: 行内全部码值与符号, 行首遍历状态, 下一行首像素的 shaxian 以及行号 (下标 0 对应 y = 1)
+std::vector<uint64_t> ComputeRowKeys(const YCombinedView& grid);
+
+// 直接生成四个文件的前提: 指令块与 CSV 往返一致且设计非空
+bool CanWriteProgramRows(const YCombinedView& grid, const YimaConfig& cfg);
+
+/**
+ * @brief 由 combined 视图写出 pixel_cmd.csv, cmd_raw.txt, cmd_simple.txt, cmd_compressed.txt 以及行索引
+ * @param allow_reuse 为 true 且 index_path 中的旧行索引与现有输出一致时, 只重新生成变化的行与受影响的压缩片段
+ * @return 0: 成功, -4: pixel_cmd.csv 写入失败, -5: TXT 写入失败, -6: 压缩输出写入失败
+ */
+int WriteProgramRows(const YCombinedView& grid, const YimaConfig& cfg, const std::filesystem::path& output_dir,
+                     const std::filesystem::path& index_path, bool allow_reuse,
+                     ProgramFileHashes& hashes, RowUpdateStats& stats);
+
+#endif // INCREMENTAL_ROWS_H
@@ -0,0 +1,14 @@
+#include "pixel_kernels.h"
+
+// target_clones 依赖 glibc 的 ifunc, 只在 x86-64 Linux 的 GCC / Clang 上启用
+#if defined(YIMA_TARGET_CLONES) && defined(__linux__) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define YIMA_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define YIMA_KERNEL
+#endif
+
+// AVX2 版本由编译器用 gather 向量化, 基线 (SSE2) 版本为逐字节查表
+YIMA_KERNEL
+void RemapPixels(const uint8_t* __restrict src, size_t n, const uint8_t* __restrict table, uint8_t* __restrict dst) {
+    for (size_t i = 0; i < n; ++i) dst[i] = table[src[i]];
+}
@@ -0,0 +1,18 @@
+#ifndef PIXEL_KERNELS_H
+#define PIXEL_KERNELS_H
+
+/*
+ * 逐像素的热点循环
+ *
+ * 以 yima_profile=multiversion 构建时 (定义 YIMA_TARGET_CLONES), 在 x86-64 Linux 上这些函数同时编译
+ * AVX2 与基线两个版本, 由动态加载器按 CPU 选择 (ifunc), 不支持 AVX2 的机器运行基线版本。
+ * 其他平台与构建只有基线版本。
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+// dst[i] = table[src[i]] (i < n), table 须覆盖 src 中出现的所有值; src 与 dst 不能重叠
+void RemapPixels(const uint8_t* src, size_t n, const uint8_t* table, uint8_t* dst);
+
+#endif // PIXEL_KERNELS_H
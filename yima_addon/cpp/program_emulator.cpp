@@ -0,0 +1,158 @@
+#include "program_emulator.h"
+#include "content_hash.h"
+#include <algorithm>
+#include <numeric>
+
+const Instr* ExpandedCursor::Next() {
+    const std::vector<Instr>& code = program_.code;
+    while (pc_ < code.size()) {
+        const Instr& in = code[pc_];
+        if (in.op == Op::Loop) {
+            ++loopInstructions_;
+            stack_.push_back({ pc_ + 1, in.count });
+            ++pc_;
+            continue;
+        }
+        if (in.op == Op::EndLoop) {
+            ++loopInstructions_;
+            Frame& top = stack_.back();
+            if (--top.left > 0) {
+                pc_ = top.start;
+            } else {
+                stack_.pop_back();
+                ++pc_;
+            }
+            continue;
+        }
+        ++pc_;
+        return &in;
+    }
+    return nullptr;
+}
+
+bool CompareExpanded(std::string_view compressed, std::string_view simple, ProgramDiff& diff) {
+    diff = ProgramDiff();
+    Program program;
+    if (!ParseProgram(compressed, program, &diff.error)) return false;
+
+    ExpandedCursor cursor(program);
+    size_t pos = 0;
+    std::string_view expected;
+    uint64_t line = 0;
+    for (;;) {
+        const Instr* in = cursor.Next();
+        const bool more = NextProgramLine(simple, pos, expected);
+        if (!in && !more) break;
+        ++line;
+        if (!in || !more || in->text != expected) {
+            diff.line = line;
+            if (more) diff.expected = std::string(expected);
+            if (in) diff.actual = std::string(in->text);
+            diff.expectedLines = more ? line : line - 1;
+            return false;
+        }
+    }
+    diff.equal = true;
+    diff.expectedLines = line;
+    return true;
+}
+
+int EmulateProgram(std::string_view text, const EmulatorOptions& options, EmulatorResult& result) {
+    result = EmulatorResult();
+    Program program;
+    if (!ParseProgram(text, program, &result.error)) return -1;
+
+    std::vector<Fixed> values(program.regs.size(), 0);
+    std::vector<char> traced(program.regs.size(), 0);
+    for (const std::string& name : options.traceRegisters) {
+        int id = program.regs.Find(name);
+        if (id >= 0) traced[(size_t)id] = 1;
+    }
+
+    // effectHash 中寄存器按名称顺序混入, 值为 0 的寄存器跳过: 只在一个程序中出现 (例如被优化删除) 的寄存器不影响结果
+    std::vector<size_t> byName(values.size());
+    std::vector<uint64_t> nameHash(values.size());
+    std::iota(byName.begin(), byName.end(), 0);
+    std::sort(byName.begin(), byName.end(), [&](size_t a, size_t b) { return program.regs.Name((int)a) < program.regs.Name((int)b); });
+    for (size_t i = 0; i < values.size(); ++i) nameHash[i] = HashString(program.regs.Name((int)i));
+    uint64_t effect = FNV_OFFSET_BASIS;
+
+    ExpandedCursor cursor(program);
+    uint64_t openIfs = 0;     // 已执行且尚未遇到 ENDIF 的 IF
+    uint64_t skipDepth = 0;   // 正在跳过的 IF 嵌套深度, 0 为不在跳过
+    while (const Instr* in = cursor.Next()) {
+        ++result.lines;
+        if (skipDepth) {
+            if (in->op == Op::If) ++skipDepth;
+            else if (in->op == Op::EndIf && --skipDepth == 0) {
+                ++result.steps;
+                ++result.opCounts[(int)Op::EndIf];
+                continue;
+            }
+            ++result.skipped;
+            continue;
+        }
+        ++result.steps;
+        ++result.opCounts[(int)in->op];
+        if (in->op != Op::Assign && in->op != Op::Add && in->op != Op::Sub) {
+            effect = HashString(in->text, effect);
+            if (in->reg >= 0) {
+                effect = HashMix(effect, (uint64_t)values[(size_t)in->reg]);
+            } else if (in->op == Op::T || in->op == Op::Other) {
+                for (size_t i : byName) {
+                    if (values[i] != 0) effect = HashMix(HashMix(effect, nameHash[i]), (uint64_t)values[i]);
+                }
+            }
+        }
+        switch (in->op) {
+            case Op::Assign:
+            case Op::Add:
+            case Op::Sub: {
+                Fixed& v = values[(size_t)in->reg];
+                v = in->op == Op::Assign ? in->value : in->op == Op::Add ? v + in->value : v - in->value;
+                if (traced[(size_t)in->reg] && (options.traceLimit == 0 || result.trace.size() < options.traceLimit)) {
+                    result.trace.push_back({ result.lines, in->reg, v });
+                }
+                break;
+            }
+            case Op::If:
+                if (EvalCompare(in->cmp, values[(size_t)in->reg], in->value)) ++openIfs;
+                else skipDepth = 1;
+                break;
+            case Op::EndIf:
+                if (openIfs == 0) {
+                    result.error = "ENDIF without IF at expanded line " + std::to_string(result.lines);
+                    return -2;
+                }
+                --openIfs;
+                break;
+            default:
+                break;
+        }
+    }
+    if (openIfs || skipDepth) {
+        result.error = "IF without ENDIF";
+        return -2;
+    }
+    result.loopInstructions = cursor.loopInstructions();
+    result.effectHash = effect;
+    for (size_t i = 0; i < values.size(); ++i) result.registers.emplace_back(program.regs.Name((int)i), values[i]);
+    std::sort(result.registers.begin(), result.registers.end());
+    result.regs = std::move(program.regs);
+    return 0;
+}
+
+bool SameEffects(const EmulatorResult& a, const EmulatorResult& b) {
+    if (a.effectHash != b.effectHash) return false;
+    // registers 均按名称排序, 跳过值为 0 的寄存器后逐个比较
+    auto next = [](const EmulatorResult& r, size_t& i) {
+        while (i < r.registers.size() && r.registers[i].second == 0) ++i;
+        return i < r.registers.size();
+    };
+    size_t i = 0, j = 0;
+    for (;; ++i, ++j) {
+        const bool ma = next(a, i), mb = next(b, j);
+        if (!ma || !mb) return ma == mb;
+        if (a.registers[i] != b.registers[j]) return false;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef PROGRAM_EMULATOR_H
+#define PROGRAM_EMULATOR_H
+
+/*
+ * 输出方言的模拟器: 验证压缩输出与展开后的程序等价, 并统计程序实际执行的机器指令数
+ *
+ * 压缩程序不展开成文本, 而是由 ExpandedCursor 按 RS/RE 结构逐条给出展开后的指令,
+ * 因此比较与模拟的时间与展开后的行数成正比, 额外内存只与嵌套深度有关。
+ *
+ * 模拟规则:
+ *   - 寄存器初始为 0, DAT 指令按定点数精确计算
+ *   - IF 条件不成立时跳过到配对的 ENDIF (按展开后的顺序配对, 允许 IF/ENDIF 跨越循环边界)
+ *   - IF / ENDIF 本身计为执行, 被跳过的指令不计
+ *   - RS / RE 单独计数 (loopInstructions): 压缩程序在机器上每次循环都要执行 RE
+ *   - effectHash 按执行顺序记录每条非 DAT 指令及其读取的寄存器值 (T 与无法识别的指令读取全部寄存器),
+ *     两个程序 effectHash 与最终寄存器都相同时, 在机器上的效果相同 (用于验证 program_optimize.h 的优化)
+ */
+
+#include "program_ir.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 按 RS/RE 结构逐条给出展开后的指令 (不含 RS/RE 本身)
+class ExpandedCursor {
+public:
+    explicit ExpandedCursor(const Program& program) : program_(program) {}
+    // 下一条指令, 结束时返回 nullptr
+    const Instr* Next();
+    // 已经过的 RS / RE 次数 (RS 每个循环一次, RE 每次迭代一次)
+    uint64_t loopInstructions() const { return loopInstructions_; }
+
+private:
+    struct Frame {
+        size_t start;     // 循环体第一条指令
+        uint64_t left;    // 剩余迭代次数 (含当前)
+    };
+    const Program& program_;
+    size_t pc_ = 0;
+    std::vector<Frame> stack_;
+    uint64_t loopInstructions_ = 0;
+};
+
+struct ProgramDiff {
+    bool equal = false;
+    uint64_t line = 0;          // 第一处不同的展开后行号 (从 1 开始); 相同时为 0
+    std::string expected;       // 该行在 simple 中的内容 (simple 已结束时为空)
+    std::string actual;         // 该行展开后的内容 (展开已结束时为空)
+    uint64_t expectedLines = 0; // 比较到的 simple 行数 (相同时为总行数)
+    std::string error;          // compressed 结构错误
+};
+
+/**
+ * @brief 流式展开 compressed 并与 simple 逐行比较 (行的切分与 SplitProgramLines 相同)
+ * @return 逐行相同时返回 true; compressed 的 RS/RE 结构无效时返回 false 并设置 diff.error
+ */
+bool CompareExpanded(std::string_view compressed, std::string_view simple, ProgramDiff& diff);
+
+struct EmulatorOptions {
+    std::vector<std::string> traceRegisters;   // 记录这些寄存器的每次写入
+    size_t traceLimit = 0;                     // 最多记录的写入次数, 0 为不限
+};
+
+struct RegisterWrite {
+    uint64_t line = 0;      // 展开后的行号 (从 1 开始)
+    int reg = -1;
+    Fixed value = 0;        // 写入后的值
+};
+
+struct EmulatorResult {
+    std::string error;
+    uint64_t lines = 0;                 // 展开后的总行数 (不含 RS/RE)
+    uint64_t steps = 0;                 // 实际执行的指令数 (不含 RS/RE 与被跳过的指令)
+    uint64_t skipped = 0;               // 因 IF 条件不成立而跳过的指令数
+    uint64_t loopInstructions = 0;      // 执行的 RS / RE 次数
+    uint64_t opCounts[OP_COUNT] = {};   // 按指令类别统计的执行次数
+    uint64_t effectHash = 0;            // 外部可见行为的哈希, 与寄存器编号无关
+    std::vector<std::pair<std::string, Fixed>> registers;   // 结束时的寄存器值, 按名称排序
+    std::vector<RegisterWrite> trace;
+    RegisterTable regs;                 // trace 中 reg 的名称
+};
+
+/**
+ * @brief 执行程序 (simple 或 compressed 均可)
+ * @return 0: 成功, -1: RS/RE 结构无效, -2: IF/ENDIF 不配对; 失败时 result.error 给出原因
+ */
+int EmulateProgram(std::string_view text, const EmulatorOptions& options, EmulatorResult& result);
+
+// 两次模拟的外部效果 (effectHash) 与最终寄存器相同; 只在一个程序中出现的寄存器按 0 比较
+bool SameEffects(const EmulatorResult& a, const EmulatorResult& b);
+
+#endif // PROGRAM_EMULATOR_H
@@ -0,0 +1,197 @@
+#include "program_ir.h"
+#include <utility>
+
+namespace {
+
+constexpr int FIXED_DECIMALS = 6;
+constexpr int FIXED_MAX_INT_DIGITS = 12;   // 保证乘以 1e6 后不溢出
+
+// 按空格 / 制表符切分, 最多 max 个, 超出时返回 max + 1 表示过多
+size_t Tokenize(std::string_view line, std::string_view* out, size_t max) {
+    size_t n = 0, pos = 0;
+    while (pos < line.size()) {
+        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t')) ++pos;
+        if (pos >= line.size()) break;
+        size_t end = pos;
+        while (end < line.size() && line[end] != ' ' && line[end] != '\t') ++end;
+        if (n == max) return max + 1;
+        out[n++] = line.substr(pos, end - pos);
+        pos = end;
+    }
+    return n;
+}
+
+bool IsRegister(std::string_view s) {
+    return s.size() > 3 && s.compare(0, 3, "DAT") == 0;
+}
+
+bool ParseCount(std::string_view s, uint64_t& v) {
+    if (s.empty() || s.size() > 18) return false;
+    v = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + (uint64_t)(c - '0');
+    }
+    return true;
+}
+
+bool ParseCmp(std::string_view s, Cmp& cmp) {
+    static const std::pair<const char*, Cmp> ops[] = {
+        { "==", Cmp::Eq }, { "!=", Cmp::Ne }, { "<", Cmp::Lt }, { "<=", Cmp::Le }, { ">", Cmp::Gt }, { ">=", Cmp::Ge } };
+    for (const auto& [name, c] : ops) {
+        if (s == name) {
+            cmp = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool ParseFixed(std::string_view s, Fixed& v) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < s.size() && (s[i] == '+' || s[i] == '-')) negative = s[i++] == '-';
+    Fixed intPart = 0, frac = 0;
+    int intDigits = 0, fracDigits = 0;
+    while (i < s.size() && s[i] >= '0' && s[i] <= '9') {
+        if (++intDigits > FIXED_MAX_INT_DIGITS) return false;
+        intPart = intPart * 10 + (s[i++] - '0');
+    }
+    if (i < s.size() && s[i] == '.') {
+        ++i;
+        while (i < s.size() && s[i] >= '0' && s[i] <= '9') {
+            if (++fracDigits > FIXED_DECIMALS) return false;
+            frac = frac * 10 + (s[i++] - '0');
+        }
+    }
+    if (i != s.size() || intDigits + fracDigits == 0) return false;
+    for (int d = fracDigits; d < FIXED_DECIMALS; ++d) frac *= 10;
+    v = intPart * FIXED_ONE + frac;
+    if (negative) v = -v;
+    return true;
+}
+
+std::string FormatFixed(Fixed v) {
+    std::string out;
+    uint64_t mag = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+    if (v < 0) out += '-';
+    out += std::to_string(mag / FIXED_ONE);
+    uint64_t frac = mag % FIXED_ONE;
+    if (frac) {
+        char digits[FIXED_DECIMALS + 1] = {};
+        for (int d = FIXED_DECIMALS - 1; d >= 0; --d, frac /= 10) digits[d] = (char)('0' + frac % 10);
+        int len = FIXED_DECIMALS;
+        while (digits[len - 1] == '0') --len;
+        out += '.';
+        out.append(digits, (size_t)len);
+    }
+    return out;
+}
+
+const char* OpName(Op op) {
+    static const char* const names[OP_COUNT] = { "T", "DAT=", "DAT+=", "DAT-=", "IF", "ENDIF", "MDP", "MTP", "RS", "RE", "other" };
+    return names[(int)op];
+}
+
+int RegisterTable::Intern(std::string_view name) {
+    auto it = ids_.find(std::string(name));
+    if (it != ids_.end()) return it->second;
+    names_.emplace_back(name);
+    return ids_[names_.back()] = (int)names_.size() - 1;
+}
+
+int RegisterTable::Find(std::string_view name) const {
+    auto it = ids_.find(std::string(name));
+    return it == ids_.end() ? -1 : it->second;
+}
+
+Instr ParseInstr(std::string_view line, RegisterTable& regs) {
+    Instr in;
+    in.text = line;
+    std::string_view tok[6];
+    const size_t n = Tokenize(line, tok, 6);
+    if (n == 0 || n > 6) return in;
+
+    const std::string_view head = tok[0];
+    if (head == "RE" && n == 1) {
+        in.op = Op::EndLoop;
+    } else if (head == "ENDIF" && n == 1) {
+        in.op = Op::EndIf;
+    } else if (head == "RS" && n == 2) {
+        if (ParseCount(tok[1], in.count)) in.op = Op::Loop;
+    } else if (head == "T" && n == 2) {
+        if (ParseFixed(tok[1], in.value)) in.op = Op::T;
+    } else if (head == "IF" && n == 4) {
+        if (IsRegister(tok[1]) && ParseCmp(tok[2], in.cmp) && ParseFixed(tok[3], in.value)) {
+            in.op = Op::If;
+            in.reg = regs.Intern(tok[1]);
+        }
+    } else if ((head == "MDP" && n == 4) || (head == "MTP" && n == 6)) {
+        if (IsRegister(tok[n - 1])) {
+            in.op = head == "MDP" ? Op::Mdp : Op::Mtp;
+            in.reg = regs.Intern(tok[n - 1]);
+        }
+    } else if (IsRegister(head) && n == 3) {
+        Op op = tok[1] == "=" ? Op::Assign : tok[1] == "+=" ? Op::Add : tok[1] == "-=" ? Op::Sub : Op::Other;
+        if (op != Op::Other && ParseFixed(tok[2], in.value)) {
+            in.op = op;
+            in.reg = regs.Intern(head);
+        }
+    }
+    return in;
+}
+
+bool EvalCompare(Cmp cmp, Fixed lhs, Fixed rhs) {
+    switch (cmp) {
+        case Cmp::Eq: return lhs == rhs;
+        case Cmp::Ne: return lhs != rhs;
+        case Cmp::Lt: return lhs < rhs;
+        case Cmp::Le: return lhs <= rhs;
+        case Cmp::Gt: return lhs > rhs;
+        case Cmp::Ge: return lhs >= rhs;
+    }
+    return false;
+}
+
+bool NextProgramLine(std::string_view text, size_t& pos, std::string_view& line) {
+    while (pos < text.size()) {
+        size_t nl = text.find('\n', pos);
+        if (nl == std::string_view::npos) nl = text.size();
+        std::string_view raw = text.substr(pos, nl - pos);
+        pos = nl + 1;
+        size_t first = raw.find_first_not_of(" \t\r\n");
+        if (first == std::string_view::npos) continue;
+        size_t last = raw.find_last_not_of(" \t\r\n");
+        line = raw.substr(first, last - first + 1);
+        return true;
+    }
+    return false;
+}
+
+bool ParseProgram(std::string_view text, Program& program, std::string* error) {
+    program = Program();
+    std::vector<size_t> loops;   // 未闭合的 RS 所在行号
+    size_t pos = 0;
+    std::string_view line;
+    auto fail = [&](size_t lineNo, const char* what) {
+        if (error) *error = "line " + std::to_string(lineNo) + ": " + what;
+        return false;
+    };
+    while (NextProgramLine(text, pos, line)) {
+        Instr in = ParseInstr(line, program.regs);
+        const size_t lineNo = program.code.size() + 1;
+        if (in.op == Op::Other && line.size() > 3 && line.compare(0, 3, "RS ") == 0) return fail(lineNo, "invalid RS count");
+        if (in.op == Op::Loop) {
+            if (in.count == 0) return fail(lineNo, "RS count is 0");
+            loops.push_back(lineNo);
+        } else if (in.op == Op::EndLoop) {
+            if (loops.empty()) return fail(lineNo, "RE without RS");
+            loops.pop_back();
+        }
+        program.code.push_back(in);
+    }
+    if (!loops.empty()) return fail(loops.back(), "RS without RE");
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef PROGRAM_IR_H
+#define PROGRAM_IR_H
+
+/*
+ * 指令 IR: 把输出方言 (cmd_simple.txt / cmd_compressed.txt) 的每一行解析为结构化指令,
+ * 供模拟器与优化遍使用
+ *
+ *   T <n>                              T 动作
+ *   DAT<r> = <v> / += <v> / -= <v>     寄存器赋值与加减 (DAT_INDEX 等非数字后缀同样是寄存器)
+ *   IF DAT<r> <op> <v> ... ENDIF       条件块, op 为 == != < <= > >=
+ *   MDP <a> <b> DAT<r>                 读取寄存器的 MDP 动作
+ *   MTP <a> <b> <c> <d> DAT<r>         读取寄存器的 MTP 动作
+ *   RS <n> ... RE                      重复 n 次, 可嵌套
+ * 无法识别的行解析为 Other, 原样保留。
+ * 数值为 6 位小数的定点数, 加减与比较都是精确的, 不受浮点误差影响;
+ * 超出精度或范围的数值所在的行同样解析为 Other。
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using Fixed = int64_t;                    // 定点数, 单位 1e-6
+constexpr Fixed FIXED_ONE = 1000000;
+
+// 解析 [+-]整数[.小数] (小数最多 6 位), 失败返回 false
+bool ParseFixed(std::string_view s, Fixed& v);
+// 最短十进制表示: 4.5, -10, 0
+std::string FormatFixed(Fixed v);
+
+enum class Op : uint8_t { T, Assign, Add, Sub, If, EndIf, Mdp, Mtp, Loop, EndLoop, Other };
+constexpr int OP_COUNT = 11;
+
+enum class Cmp : uint8_t { Eq, Ne, Lt, Le, Gt, Ge };
+
+// 指令名 (T / DAT= / DAT+= / DAT-= / IF / ENDIF / MDP / MTP / RS / RE / other), 用于统计输出
+const char* OpName(Op op);
+
+struct Instr {
+    Op op = Op::Other;
+    Cmp cmp = Cmp::Ne;       // IF 的比较方式
+    int reg = -1;            // 寄存器编号 (见 RegisterTable), 没有寄存器时为 -1
+    Fixed value = 0;         // DAT 的立即数, IF 的比较值, T 的参数
+    uint64_t count = 0;      // RS 的重复次数
+    std::string_view text;   // 原始行 (引用程序文本)
+};
+
+// 寄存器名与编号的映射, 编号按首次出现的顺序分配
+class RegisterTable {
+public:
+    int Intern(std::string_view name);
+    int Find(std::string_view name) const;   // 不存在时返回 -1
+    const std::string& Name(int id) const { return names_[(size_t)id]; }
+    size_t size() const { return names_.size(); }
+
+private:
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, int> ids_;
+};
+
+struct Program {
+    std::vector<Instr> code;
+    RegisterTable regs;
+};
+
+// 解析一行 (首尾空白已去除)
+Instr ParseInstr(std::string_view line, RegisterTable& regs);
+
+// 比较 IF 条件
+bool EvalCompare(Cmp cmp, Fixed lhs, Fixed rhs);
+
+/**
+ * @brief 解析整个程序, 行的切分与 SplitProgramLines 相同; 指令引用 text 的内存, text 须在 program 使用期间有效
+ * @return RS/RE 不配对或 RS 次数无效时返回 false, error 中给出行号 (从 1 开始, 不计空行)
+ */
+bool ParseProgram(std::string_view text, Program& program, std::string* error = nullptr);
+
+// 逐行遍历程序文本: 去除首尾空白并跳过空行, 与 SplitProgramLines 一致; 没有更多行时返回 false
+bool NextProgramLine(std::string_view text, size_t& pos, std::string_view& line);
+
+#endif // PROGRAM_IR_H
@@ -0,0 +1,269 @@
+#include "program_optimize.h"
+#include <algorithm>
+
+namespace {
+
+// ParseFixed 可表示的最大绝对值, 合并结果超出时不再合并, 保证重新生成的数值仍能解析
+constexpr Fixed FIXED_LIMIT = 999999999999 * FIXED_ONE + (FIXED_ONE - 1);
+// 窗口中没有屏障时最多保留的指令数, 超出时直接输出 (只影响合并的范围, 不影响正确性)
+constexpr size_t MAX_WINDOW = 4096;
+
+bool IsBarrier(Op op) {
+    return op != Op::Assign && op != Op::Add && op != Op::Sub && op != Op::Mdp && op != Op::Mtp;
+}
+
+// 与 code[begin] 的 RS 配对的 RE, 没有时返回 end
+template <typename Code>
+size_t MatchLoop(const Code& code, size_t begin, size_t end) {
+    int depth = 0;
+    for (size_t i = begin; i < end; ++i) {
+        if (code[i].op == Op::Loop) ++depth;
+        else if (code[i].op == Op::EndLoop && --depth == 0) return i;
+    }
+    return end;
+}
+
+} // namespace
+
+void ProgramOptimizer::Push(std::string_view text, std::string& out) {
+    size_t pos = 0;
+    std::string_view line;
+    while (NextProgramLine(text, pos, line)) {
+        ++stats_.inputLines;
+        const Instr in = ParseInstr(line, regs_);
+        if (in.reg >= 0 && (size_t)in.reg >= pending_.size()) pending_.resize(regs_.size(), -1);
+        if (passes_ & PROGRAM_PASS_FOLD) Fold(in);
+        else Append(in);
+        if (IsBarrier(in.op) || window_.size() >= MAX_WINDOW) Flush(out);
+    }
+}
+
+void ProgramOptimizer::Finish(std::string& out) {
+    Flush(out);
+    // RS 没有配对的 RE: 原样输出, 之后的状态未知
+    for (const Slot& s : loop_) Write(s, out);
+    loop_.clear();
+    loopDepth_ = 0;
+    state_.clear();
+}
+
+void ProgramOptimizer::Fold(const Instr& in) {
+    if (in.op == Op::Mdp || in.op == Op::Mtp) {
+        pending_[(size_t)in.reg] = -1;
+        Append(in);
+        return;
+    }
+    if (in.op != Op::Assign && in.op != Op::Add && in.op != Op::Sub) {
+        Append(in);
+        return;
+    }
+    const int p = pending_[(size_t)in.reg];
+    if (p >= 0) {
+        Slot& s = window_[(size_t)p];
+        Fixed v = in.op == Op::Assign ? in.value : s.value + (in.op == Op::Add ? in.value : -in.value);
+        if (v >= -FIXED_LIMIT && v <= FIXED_LIMIT) {
+            if (in.op == Op::Assign) s.op = Op::Assign;
+            s.value = v;
+            s.folded = true;
+            ++stats_.folded;
+            return;
+        }
+    }
+    Append(in);
+    pending_[(size_t)in.reg] = (int)window_.size() - 1;
+}
+
+void ProgramOptimizer::Append(const Instr& in) {
+    Slot s{ in.op, in.reg, in.value, false, std::string(in.text) };
+    if (in.op == Op::Sub) {
+        s.op = Op::Add;
+        s.value = -in.value;
+    }
+    window_.push_back(std::move(s));
+}
+
+void ProgramOptimizer::Flush(std::string& out) {
+    for (Slot& s : window_) {
+        if (s.reg >= 0) pending_[(size_t)s.reg] = -1;
+        if ((passes_ & PROGRAM_PASS_FOLD) && s.op == Op::Add && s.value == 0) {
+            ++stats_.removed;
+            continue;
+        }
+        Emit(std::move(s), out);
+    }
+    window_.clear();
+}
+
+void ProgramOptimizer::Emit(Slot&& s, std::string& out) {
+    if (!passes_) {
+        Write(s, out);
+        return;
+    }
+    // 循环整体确定后才能求不动点, 也才知道循环体是否为空, 先缓存
+    if (loopDepth_ > 0 || s.op == Op::Loop) {
+        if (s.op == Op::Loop) ++loopDepth_;
+        else if (s.op == Op::EndLoop) --loopDepth_;
+        loop_.push_back(std::move(s));
+        if (loopDepth_ == 0) EmitLoop(out);
+        return;
+    }
+    if (!(passes_ & PROGRAM_PASS_CONST)) {
+        Write(s, out);
+        return;
+    }
+    if (Step(s, state_, ifs_)) {
+        ++stats_.unchanged;
+        return;
+    }
+    Write(s, out);
+}
+
+void ProgramOptimizer::EmitLoop(std::string& out) {
+    // drop: 1 为不改变寄存器值的赋值, 2 为空循环的 RS / RE
+    std::vector<char> drop(loop_.size(), 0);
+    if (passes_ & PROGRAM_PASS_CONST) Propagate(loop_, 0, loop_.size(), state_, ifs_, &drop);
+    // 内层循环先于外层结束, 因此外层循环体只剩空的内层循环时也会删除
+    std::vector<size_t> open;
+    for (size_t i = 0; i < loop_.size(); ++i) {
+        if (loop_[i].op == Op::Loop) {
+            open.push_back(i);
+        } else if (loop_[i].op == Op::EndLoop) {
+            const size_t rs = open.back();
+            open.pop_back();
+            if (std::all_of(drop.begin() + (std::ptrdiff_t)rs + 1, drop.begin() + (std::ptrdiff_t)i,
+                            [](char d) { return d != 0; })) {
+                drop[rs] = drop[i] = 2;
+            }
+        }
+    }
+    for (size_t i = 0; i < loop_.size(); ++i) {
+        if (drop[i] == 1) ++stats_.unchanged;
+        else if (drop[i] == 2) ++stats_.removed;
+        else Write(loop_[i], out);
+    }
+    loop_.clear();
+}
+
+void ProgramOptimizer::Write(const Slot& s, std::string& out) {
+    ++stats_.outputLines;
+    if (!s.folded) {
+        out += s.text;
+    } else {
+        out += regs_.Name(s.reg);
+        if (s.op == Op::Assign) out += " = " + FormatFixed(s.value);
+        else out += s.value > 0 ? " += " + FormatFixed(s.value) : " -= " + FormatFixed(-s.value);
+    }
+    out += '\n';
+}
+
+namespace {
+
+template <typename State>
+typename State::value_type& At(State& st, int reg) {
+    if ((size_t)reg >= st.size()) st.resize((size_t)reg + 1);
+    return st[(size_t)reg];
+}
+
+// a = a 与 b 的交集: 两边都已知且相等的寄存器仍已知
+template <typename State>
+void Meet(State& a, const State& b) {
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (i >= b.size() || !b[i].known || b[i].value != a[i].value) a[i].known = false;
+    }
+}
+
+template <typename State>
+bool SameState(const State& a, const State& b) {
+    for (size_t i = 0; i < a.size() || i < b.size(); ++i) {
+        bool ka = i < a.size() && a[i].known, kb = i < b.size() && b[i].known;
+        if (ka != kb || (ka && a[i].value != b[i].value)) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool ProgramOptimizer::Step(const Slot& s, RegState& st, IfStack& ifs) {
+    switch (s.op) {
+        case Op::Assign: {
+            RegValue& r = At(st, s.reg);
+            if (r.known && r.value == s.value) return true;
+            r.known = true;
+            r.value = s.value;
+            break;
+        }
+        case Op::Add: {
+            RegValue& r = At(st, s.reg);
+            if (r.known) {
+                r.value += s.value;
+                r.known = r.value >= -FIXED_LIMIT && r.value <= FIXED_LIMIT;
+            }
+            break;
+        }
+        case Op::If:
+            ifs.saved.push_back(st);
+            break;
+        case Op::EndIf:
+            // IF 不成立时从 IF 直接跳到这里
+            if (ifs.saved.empty()) {
+                ifs.paired = false;
+                st.clear();
+            } else {
+                Meet(st, ifs.saved.back());
+                ifs.saved.pop_back();
+            }
+            break;
+        case Op::T:
+        case Op::Mdp:
+        case Op::Mtp:
+            break;
+        default:   // 无法识别的指令, 以及没有配对 RS 的 RE
+            st.clear();
+            break;
+    }
+    return false;
+}
+
+void ProgramOptimizer::Propagate(const std::vector<Slot>& code, size_t begin, size_t end, RegState& st, IfStack& ifs,
+                                 std::vector<char>* drop) {
+    for (size_t i = begin; i < end; ++i) {
+        if (code[i].op != Op::Loop) {
+            if (Step(code[i], st, ifs) && drop) (*drop)[i] = 1;
+            continue;
+        }
+        const size_t re = MatchLoop(code, i, end);
+        if (re == end) {
+            st.clear();
+            continue;
+        }
+        // 循环体入口: 第一次迭代为 st, 之后为上一次迭代结束时的状态, 取交集直到不再变化
+        RegState in = st;
+        for (;;) {
+            RegState after = in;
+            IfStack body;
+            Propagate(code, i + 1, re, after, body, nullptr);
+            RegState next = st;
+            Meet(next, after);
+            if (SameState(next, in)) break;
+            in = std::move(next);
+        }
+        IfStack body;
+        Propagate(code, i + 1, re, in, body, drop);
+        // 循环体内 IF / ENDIF 不配对时, 展开后的配对关系与文本不同, 外层尚未配对的 IF 不再可信
+        if (!body.paired || !body.saved.empty()) {
+            for (RegState& saved : ifs.saved) saved.clear();
+        }
+        st = std::move(in);
+        i = re;
+    }
+}
+
+std::string OptimizeProgram(std::string_view text, unsigned passes, OptimizeStats* stats) {
+    ProgramOptimizer optimizer(passes);
+    std::string out;
+    out.reserve(text.size());
+    optimizer.Push(text, out);
+    optimizer.Finish(out);
+    if (stats) *stats = optimizer.stats();
+    return out;
+}
@@ -0,0 +1,117 @@
+#ifndef PROGRAM_OPTIMIZE_H
+#define PROGRAM_OPTIMIZE_H
+
+/*
+ * 指令优化遍: 位于指令生成与压缩之间, 在指令 IR (见 program_ir.h) 上减少机器实际执行的指令数
+ *
+ * 寄存器的读取者:
+ *   - MDP / MTP 读取其最后一个参数指定的寄存器
+ *   - IF 读取比较的寄存器, 并且改变控制流
+ *   - T 与无法识别的指令视为读取全部寄存器 (机器在 T 动作时使用 DAT_INDEX 等寄存器)
+ *   - RS / RE / ENDIF 改变控制流
+ * 除 MDP / MTP 外, 以上指令都是优化的屏障, 屏障两侧的指令不会合并。
+ *
+ * 遍:
+ *   PROGRAM_PASS_FOLD   同一寄存器上相邻的 DATn += / -= / = 在中间没有指令读取它时合并为一条,
+ *                       放在第一条的位置: DAT2 -= 10, DAT2 += 2.25 -> DAT2 -= 7.75;
+ *                       DAT2 = 0, DAT2 += 1 -> DAT2 = 1; 合并后为 += 0 的指令直接删除
+ *   PROGRAM_PASS_CONST  沿执行顺序跟踪取值已知的寄存器 (常量传播), 删除不改变寄存器值的赋值,
+ *                       例如每个像素都写一次的 DAT910 = 0。数据流规则:
+ *                         - 程序开始时全部寄存器未知 (不假定机器初始为 0)
+ *                         - T / MDP / MTP 不写寄存器; 无法识别的指令使全部寄存器未知
+ *                         - ENDIF 之后取 IF 之前与 IF 体结束时两种状态的交集;
+ *                           找不到配对 IF 的 ENDIF 使全部寄存器未知
+ *                         - RS 循环体的入口状态迭代到不动点 (入口状态与上一次迭代结束状态的交集),
+ *                           因此只删除每次迭代都不改变寄存器值的赋值; IF / ENDIF 在循环体内不配对时
+ *                           (按展开后的顺序配对), 循环之外尚未配对的 IF 不再用于求交集
+ *                       在 FOLD 之后运行, 循环整体确定后才输出
+ * 两遍之后循环体为空 (或只剩空循环) 的 RS n / RE 一并删除。
+ *
+ * 优化后的程序与原程序在每个屏障处的寄存器值相同 (由 EmulatorResult::effectHash 验证)。
+ * 未改动的指令保留原文。cmd_raw.txt 按配置块注释, 始终是优化前的内容。
+ */
+
+#include "program_ir.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 优化遍, 可按位组合
+enum ProgramPass : unsigned {
+    PROGRAM_PASS_FOLD = 1u << 0,    // 合并相邻的寄存器加减与赋值
+    PROGRAM_PASS_CONST = 1u << 1,   // 删除不改变寄存器值的赋值
+    PROGRAM_PASS_ALL = PROGRAM_PASS_FOLD | PROGRAM_PASS_CONST,
+};
+
+struct OptimizeStats {
+    uint64_t inputLines = 0;
+    uint64_t outputLines = 0;
+    uint64_t folded = 0;     // 合并进前一条指令的指令数
+    uint64_t removed = 0;    // 合并后为 += 0 而删除的指令数, 以及空循环的 RS / RE 行数
+    uint64_t unchanged = 0;  // 寄存器已是该值而删除的赋值数
+};
+
+/**
+ * 流式优化器: 按行推入程序文本, 只有遇到屏障 (或循环结束) 后才确定的部分留在窗口中,
+ * 因此逐块推入与一次推入整个程序的结果逐字节一致
+ */
+class ProgramOptimizer {
+public:
+    explicit ProgramOptimizer(unsigned passes = PROGRAM_PASS_ALL) : passes_(passes) {}
+
+    // 推入若干完整的行 (空行忽略), 已确定的输出追加到 out, 每行以 \n 结尾
+    void Push(std::string_view text, std::string& out);
+    // 输出窗口中剩余的指令
+    void Finish(std::string& out);
+
+    const OptimizeStats& stats() const { return stats_; }
+
+private:
+    struct Slot {
+        Op op;
+        int reg;
+        Fixed value;         // Assign 为赋值, Add 为累计的增量 (Sub 以负数记录)
+        bool folded;         // 已合并其他指令, 输出时按 value 重新生成
+        std::string text;
+    };
+
+    struct RegValue {
+        bool known = false;
+        Fixed value = 0;
+    };
+    using RegState = std::vector<RegValue>;   // 按寄存器编号, 超出范围的寄存器未知
+
+    struct IfStack {
+        std::vector<RegState> saved;   // 尚未配对的 IF 之前的状态
+        bool paired = true;            // 是否每个 ENDIF 都找到了配对的 IF
+    };
+
+    void Fold(const Instr& in);
+    void Append(const Instr& in);
+    void Flush(std::string& out);
+    void Emit(Slot&& s, std::string& out);
+    void Write(const Slot& s, std::string& out);
+    void EmitLoop(std::string& out);
+
+    // 常量传播: Step 应用一条非循环指令, 返回该指令是否为不改变寄存器值的赋值
+    static bool Step(const Slot& s, RegState& st, IfStack& ifs);
+    // 依次应用 code[begin, end) (循环迭代到不动点), drop 非空时标记可删除的赋值
+    static void Propagate(const std::vector<Slot>& code, size_t begin, size_t end, RegState& st, IfStack& ifs,
+                          std::vector<char>* drop);
+
+    unsigned passes_;
+    RegisterTable regs_;
+    std::vector<Slot> window_;
+    std::vector<int> pending_;   // 寄存器 -> 仍可合并的 window_ 下标, -1 为没有
+    RegState state_;             // 已输出部分结束时的寄存器状态
+    IfStack ifs_;
+    std::vector<Slot> loop_;     // 尚未结束的最外层循环 (从 RS 开始), 整体确定后由 EmitLoop 输出
+    int loopDepth_ = 0;
+    OptimizeStats stats_;
+};
+
+// 优化整个程序, 结果与 ProgramOptimizer 逐块推入一致
+std::string OptimizeProgram(std::string_view text, unsigned passes = PROGRAM_PASS_ALL, OptimizeStats* stats = nullptr);
+
+#endif // PROGRAM_OPTIMIZE_H
@@ -0,0 +1,83 @@
+#include "program_stream.h"
+#include "4.cmd_csv_handle/cmd_csv_handle.h"
+#include "5.txt_generator/txt_generator.h"
+#include "6.txt_handle/txt_handle.h"
+#include "program_optimize.h"
+#include <algorithm>
+
+namespace {
+
+// 按固定大小切块输出
+class ChunkWriter {
+public:
+    ChunkWriter(size_t chunk_size, const ProgramChunkSink& sink) : chunk_(chunk_size), sink_(sink) {}
+
+    std::string& buffer() { return buf_; }
+
+    // 输出所有已凑满的块; final 为 true 时连同不足一块的剩余部分
+    bool Flush(bool final) {
+        size_t pos = 0;
+        while (buf_.size() - pos >= chunk_ || (final && pos < buf_.size())) {
+            size_t n = std::min(chunk_, buf_.size() - pos);
+            if (!sink_(buf_.substr(pos, n))) return false;
+            pos += n;
+        }
+        buf_.erase(0, pos);
+        return true;
+    }
+
+private:
+    size_t chunk_;
+    const ProgramChunkSink& sink_;
+    std::string buf_;
+};
+
+} // namespace
+
+int StreamProgram(const YCombinedView& grid, const YimaConfig& cfg, ProgramFormat format,
+                  size_t chunk_size, const ProgramChunkSink& sink, unsigned optimize) {
+    ChunkWriter writer(chunk_size ? chunk_size : 64 * 1024, sink);
+    std::string& out = writer.buffer();
+    StreamingCompressor compressor;
+    ProgramOptimizer optimizer(optimize);
+    std::string optimized;
+
+    std::string raw, simple;
+    AppendProgramHead(cfg, raw, simple);
+    // 每行生成后立即转交, simple / raw 只保存当前行
+    auto emit = [&](bool final) {
+        if (optimize && format != ProgramFormat::Raw) {
+            // 优化器窗口中仍可能合并的指令留到后续行
+            optimizer.Push(simple, optimized);
+            if (final) optimizer.Finish(optimized);
+            simple.swap(optimized);
+            optimized.clear();
+        }
+        if (format == ProgramFormat::Raw) {
+            out += raw;
+        } else if (format == ProgramFormat::Simple) {
+            out += simple;
+        } else {
+            compressor.Push(simple);
+            if (final) compressor.Finish(out);
+            else compressor.Drain(out);
+        }
+        raw.clear();
+        simple.clear();
+        return writer.Flush(final);
+    };
+    if (!emit(false)) return PROGRAM_STREAM_CANCELLED;
+
+    ProgramTxtSink txtSink(raw, simple);
+    SimpleProgramSink simpleSink(simple);
+    CmdRowSink& rowSink = (format == ProgramFormat::Raw) ? static_cast<CmdRowSink&>(txtSink) : simpleSink;
+    CmdWalkState st;
+    for (int y = 1; y <= grid.height(); ++y) {
+        WalkCmdRow(grid, cfg, y, st, rowSink);
+        if (!emit(false)) return PROGRAM_STREAM_CANCELLED;
+    }
+
+    AppendProgramTail(cfg, raw, simple);
+    if (!emit(true)) return PROGRAM_STREAM_CANCELLED;
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef PROGRAM_STREAM_H
+#define PROGRAM_STREAM_H
+
+/*
+ * 流式输出指令
+ *
+ * 逐行遍历设计生成指令, 每凑满 chunk_size 字节就交给回调, 不在内存中保留完整的程序文本。
+ * 压缩格式借助 StreamingCompressor 边生成边压缩, 只有仍可能与后续行合并的部分留在窗口中。
+ */
+
+#include "ycombined_format.h"
+#include "yima_config.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+
+enum class ProgramFormat {
+    Simple,       // 与 cmd_simple.txt 一致
+    Raw,          // 与 cmd_raw.txt 一致 (带 # INDEX 注释)
+    Compressed,   // 与 cmd_compressed.txt 一致
+};
+
+// 回调返回 false 表示取消, 此时 StreamProgram 返回 PROGRAM_STREAM_CANCELLED
+using ProgramChunkSink = std::function<bool(std::string&& chunk)>;
+
+constexpr int PROGRAM_STREAM_CANCELLED = -102;
+
+// 除最后一块外每块恰好 chunk_size 字节 (chunk_size 为 0 时按 64 KiB)
+// optimize 为 Simple / Compressed 格式使用的优化遍 (见 program_optimize.h), 0 为不优化
+int StreamProgram(const YCombinedView& grid, const YimaConfig& cfg, ProgramFormat format,
+                  size_t chunk_size, const ProgramChunkSink& sink, unsigned optimize = 0);
+
+#endif // PROGRAM_STREAM_H
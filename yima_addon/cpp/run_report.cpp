@@ -0,0 +1,129 @@
+#include "run_report.h"
+#include "yima_config.h"
+#include "yima_probes.h"
+#include "6.txt_handle/txt_handle.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+double WallNowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double ThreadCpuMs() {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user)) return 0;
+    auto ticks = [](const FILETIME& t) { return ((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime; };
+    return (double)(ticks(kernel) + ticks(user)) / 1e4;   // 100ns 为单位
+#else
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+#endif
+}
+
+// 逐行遍历文本, 去除首尾空白后交给 fn
+template <typename Fn>
+void ForEachLine(std::string_view text, Fn&& fn) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string_view::npos) end = text.size();
+        fn(TrimCmdView(text.substr(pos, end - pos)));
+        pos = end + 1;
+    }
+}
+
+} // namespace
+
+StageTimer::StageTimer() : wall0_(WallNowMs()), cpu0_(ThreadCpuMs()) {}
+
+double StageTimer::WallMs() const { return WallNowMs() - wall0_; }
+
+double StageTimer::CpuMs() const { return ThreadCpuMs() - cpu0_; }
+
+StageScope::StageScope(RunReport* report, int step, const char* name) : report_(report) {
+    YIMA_PROBE1(stage__start, step);
+    metrics_.step = step;
+    if (report_) metrics_.name = name;
+}
+
+StageScope::~StageScope() {
+    if (!done_) Finish(-100);
+}
+
+int StageScope::Finish(int code, bool skipped) {
+    if (!done_) YIMA_PROBE3(stage__done, metrics_.step, code, (int)skipped);
+    if (done_ || !report_) {
+        done_ = true;
+        return code;
+    }
+    done_ = true;
+    metrics_.code = code;
+    metrics_.skipped = skipped;
+    metrics_.wallMs = timer_.WallMs();
+    metrics_.cpuMs = timer_.CpuMs();
+    metrics_.peakRssBytes = PeakRssBytes();
+    metrics_.alloc = alloc_.Finish();
+    report_->stages.push_back(std::move(metrics_));
+    return code;
+}
+
+uint64_t PeakRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+    return (uint64_t)pmc.PeakWorkingSetSize;
+#else
+    rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#ifdef __APPLE__
+    return (uint64_t)ru.ru_maxrss;            // macOS 以字节为单位
+#else
+    return (uint64_t)ru.ru_maxrss * 1024;     // Linux 以 KiB 为单位
+#endif
+#endif
+}
+
+uint64_t FileBytes(const fs::path& p) {
+    std::error_code ec;
+    uintmax_t size = fs::file_size(p, ec);
+    return ec ? 0 : (uint64_t)size;
+}
+
+int64_t CountCommandLines(std::string_view text) {
+    int64_t n = 0;
+    ForEachLine(text, [&](std::string_view line) {
+        if (!line.empty() && line[0] != '#') ++n;
+    });
+    return n;
+}
+
+CompressionMetrics AnalyzeCompression(std::string_view raw, std::string_view compressed) {
+    CompressionMetrics m;
+    m.rawLines = (int64_t)SplitProgramLines(raw).size();
+    int depth = 0;
+    ForEachLine(compressed, [&](std::string_view line) {
+        if (line.empty()) return;
+        ++m.compressedLines;
+        if (line.size() > 3 && line.compare(0, 3, "RS ") == 0) {
+            ++m.loops;
+            m.maxDepth = std::max(m.maxDepth, ++depth);
+        } else if (line == "RE") {
+            depth = std::max(depth - 1, 0);
+        }
+    });
+    return m;
+}
@@ -0,0 +1,110 @@
+#ifndef RUN_REPORT_H
+#define RUN_REPORT_H
+
+/*
+ * 流水线运行报告
+ *
+ * 每个阶段记录耗时, 输入输出字节数, 处理的行数与像素数, 输出的指令行数以及内存峰值;
+ * 另外统计循环压缩的效果。只在调用方请求时收集 (见 PipelineOptions::report), 不影响正常运行的开销。
+ * 以 yima_alloc_stats=1 构建时另外记录每个阶段的堆分配 (见 yima_alloc_stats.h)。
+ */
+
+#include "yima_alloc_stats.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 单个阶段的指标
+struct StageMetrics {
+    int step = 0;                 // 阶段序号; 行级增量生成 (阶段 4-6 一次完成) 记为 4
+    std::string name;             // extract / combine / data_csv / cmd_csv / txt / compress / rows
+    int code = 0;                 // 阶段返回值
+    bool skipped = false;         // 增量构建中输入未变而跳过
+    double wallMs = 0;
+    double cpuMs = 0;             // 调用线程的 CPU 时间
+    uint64_t inputBytes = 0;      // 阶段读取的文件总大小
+    uint64_t outputBytes = 0;     // 阶段写出的文件总大小 (跳过时为已有输出的大小)
+    int64_t rows = 0;             // 设计行数 (不处理像素的阶段为 0)
+    int64_t pixels = 0;           // 设计像素数 (宽 x 高)
+    int64_t commandLines = 0;     // 输出的指令行数, 不含注释与空行
+    uint64_t peakRssBytes = 0;    // 阶段结束时进程常驻内存的历史峰值
+    AllocStats alloc;             // 堆分配统计, 仅在 RunReport::allocStats 为 true 时有效
+};
+
+// cmd_simple.txt -> cmd_compressed.txt 的压缩效果
+struct CompressionMetrics {
+    int64_t rawLines = 0;         // 压缩前的指令行数
+    int64_t compressedLines = 0;  // 压缩后的行数 (含 RS/RE)
+    int64_t loops = 0;            // RS 循环个数
+    int maxDepth = 0;             // 循环的最大嵌套层数
+};
+
+// 行级增量生成 (rows 阶段) 复用上次输出的情况
+struct RowReuseMetrics {
+    bool reusedIndex = false;     // 是否使用了上次运行的行索引
+    int64_t rows = 0;
+    int64_t regeneratedRows = 0;  // 重新生成的行数, 其余行复制上次的输出
+    int64_t segments = 0;         // cmd_compressed.txt 的片段数
+    int64_t reusedSegments = 0;   // 直接复用的片段数
+};
+
+struct RunReport {
+    int code = 0;                 // 与 ProcessBmpTranslation 的返回值相同
+    double wallMs = 0;
+    double cpuMs = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<StageMetrics> stages;   // 按执行顺序, 失败时只包含已开始的阶段
+    CompressionMetrics compression;
+    RowReuseMetrics rowReuse;     // 只在运行了 rows 阶段时填写
+    bool allocStats = false;      // 是否统计了堆分配 (见 AllocStatsEnabled)
+    AllocStats alloc;             // 整次运行的堆分配统计
+};
+
+// 同时记录墙钟时间与当前线程的 CPU 时间
+class StageTimer {
+public:
+    StageTimer();
+    double WallMs() const;
+    double CpuMs() const;
+
+private:
+    double wall0_;
+    double cpu0_;
+};
+
+// 记录一个阶段的指标并追加到 report->stages; report 为空时只触发阶段边界的 USDT 探针 (见 yima_probes.h)
+// 未调用 Finish 即离开作用域 (异常) 时按 -100 记录
+class StageScope {
+public:
+    StageScope(RunReport* report, int step, const char* name);
+    ~StageScope();
+    StageScope(const StageScope&) = delete;
+    StageScope& operator=(const StageScope&) = delete;
+
+    // 记录返回值与耗时, 原样返回 code
+    int Finish(int code, bool skipped = false);
+
+private:
+    RunReport* report_;
+    StageMetrics metrics_;
+    StageTimer timer_;
+    AllocScope alloc_;
+    bool done_ = false;
+};
+
+// 进程常驻内存的历史峰值 (字节), 无法获取时为 0
+uint64_t PeakRssBytes();
+
+// 文件大小, 文件缺失时为 0
+uint64_t FileBytes(const std::filesystem::path& p);
+
+// 统计指令文本中非空且不以 # 开头的行数
+int64_t CountCommandLines(std::string_view text);
+
+// 扫描压缩输出中的 RS/RE, 统计循环个数与最大嵌套层数; raw 为压缩前的纯指令文本
+CompressionMetrics AnalyzeCompression(std::string_view raw, std::string_view compressed);
+
+#endif // RUN_REPORT_H
@@ -0,0 +1,237 @@
+#ifndef YCOMBINED_FORMAT_H
+#define YCOMBINED_FORMAT_H
+
+/*
+ * combined.ycomb 列式二进制格式 (阶段 2 输出, 阶段 3/4 输入)
+ *
+ *   [YCombinedHeader 56 字节]
+ *   [字典区]  依次为 sema/shaxian/luola/dumu/sign/zhenban 六个字符串字典:
+ *             uint16 count, 然后 count 个 {uint16 len, bytes}
+ *             其后是 uint16 count + count 个 uint8, 为每个 sema 码给出 zhenban 字典索引
+ *   [码值区]  4 个图层平面, 每个 width x height 字节 (字典索引, 行主序, 第 0 行对应 y = 1)
+ *   [符号区]  height 字节, 每行的 sign 字典索引
+ *
+ * zhenban 完全由 sema 码决定, 因此按 sema 码存储而不是逐像素存储。
+ * 所有整数均为小端序, 文件可直接内存映射。
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include "mapped_file.h"
+
+enum YLayerKind { LAYER_SEMA = 0, LAYER_SHAXIAN, LAYER_LUOLA, LAYER_DUMU, LAYER_COUNT };
+
+// 图层名称, 按 YLayerKind 顺序; 同时是输入 BMP 的文件名 (<name>.bmp), 配置中的颜色表名与 JS 对象的键
+inline constexpr const char* LAYER_NAMES[LAYER_COUNT] = { "sema", "shaxian", "luola", "dumu" };
+
+#pragma pack(push, 1)
+struct YCombinedHeader {
+    char     magic[4];      // "YCMB"
+    uint16_t version;       // 当前为 1
+    uint16_t layerCount;    // 固定为 LAYER_COUNT
+    uint32_t width;
+    uint32_t height;
+    uint32_t shaxianTypes;
+    uint32_t reserved;
+    uint64_t dictOffset;
+    uint64_t codesOffset;
+    uint64_t signOffset;
+    uint64_t fileSize;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(YCombinedHeader) == 56, "YCombinedHeader must be 56 bytes");
+
+constexpr uint16_t YCOMBINED_VERSION = 1;
+
+// 阶段 2 在内存中构建的合并结果
+struct CombinedDesign {
+    int width = 0;
+    int height = 0;
+    int shaxianTypes = 0;
+    std::vector<std::string> dict[LAYER_COUNT];   // 每个图层的码值字典 (去重)
+    std::vector<uint8_t> codes[LAYER_COUNT];      // 每个图层的字典索引平面
+    std::vector<std::string> signDict;
+    std::vector<uint8_t> rowSign;                 // height 个 sign 字典索引
+    std::vector<std::string> zhenbanDict;
+    std::vector<uint8_t> semaZhenban;             // 每个 sema 码对应的 zhenban 字典索引
+};
+
+inline std::vector<uint8_t> SerializeYCombined(const CombinedDesign& d) {
+    std::vector<uint8_t> dictBytes;
+    auto put16 = [&](size_t v) {
+        dictBytes.push_back((uint8_t)(v & 0xFF));
+        dictBytes.push_back((uint8_t)((v >> 8) & 0xFF));
+    };
+    auto putDict = [&](const std::vector<std::string>& dict) {
+        put16(dict.size());
+        for (const auto& s : dict) {
+            put16(s.size());
+            dictBytes.insert(dictBytes.end(), s.begin(), s.end());
+        }
+    };
+    for (int l = 0; l < LAYER_COUNT; ++l) putDict(d.dict[l]);
+    putDict(d.signDict);
+    putDict(d.zhenbanDict);
+    put16(d.semaZhenban.size());
+    dictBytes.insert(dictBytes.end(), d.semaZhenban.begin(), d.semaZhenban.end());
+
+    size_t pixels = (size_t)d.width * d.height;
+    YCombinedHeader h;
+    std::memcpy(h.magic, "YCMB", 4);
+    h.version = YCOMBINED_VERSION;
+    h.layerCount = LAYER_COUNT;
+    h.width = (uint32_t)d.width;
+    h.height = (uint32_t)d.height;
+    h.shaxianTypes = (uint32_t)d.shaxianTypes;
+    h.reserved = 0;
+    h.dictOffset = sizeof(YCombinedHeader);
+    h.codesOffset = h.dictOffset + dictBytes.size();
+    h.signOffset = h.codesOffset + pixels * LAYER_COUNT;
+    h.fileSize = h.signOffset + (size_t)d.height;
+
+    std::vector<uint8_t> out((size_t)h.fileSize);
+    std::memcpy(out.data(), &h, sizeof(h));
+    if (!dictBytes.empty()) std::memcpy(out.data() + h.dictOffset, dictBytes.data(), dictBytes.size());
+    for (int l = 0; l < LAYER_COUNT; ++l) {
+        if (pixels) std::memcpy(out.data() + h.codesOffset + pixels * l, d.codes[l].data(), pixels);
+    }
+    if (d.height > 0) std::memcpy(out.data() + h.signOffset, d.rowSign.data(), (size_t)d.height);
+    return out;
+}
+
+inline bool WriteYCombined(const std::filesystem::path& p, const CombinedDesign& d) {
+    std::vector<uint8_t> bytes = SerializeYCombined(d);
+    std::ofstream out(p, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return out.good();
+}
+
+// 单个像素的完整字段 (引用字典中的字符串, 不做拷贝)
+struct CombinedPixel {
+    const std::string& sema;
+    const std::string& shaxian;
+    const std::string& luola;
+    const std::string& dumu;
+    const std::string& zhenban;
+    const std::string& sign;
+};
+
+// combined.ycomb 的只读视图: 码值平面直接指向映射内存, 字典在打开时解析
+class YCombinedView {
+public:
+    bool Open(const std::filesystem::path& p) {
+        if (!file_.Open(p)) return false;
+        return Parse(file_.data(), file_.size());
+    }
+
+    // 解析一段已在内存中的 combined 数据 (调用方负责保证其生命周期)
+    bool Parse(const uint8_t* data, size_t size) {
+        if (!data || size < sizeof(YCombinedHeader)) return false;
+        std::memcpy(&header_, data, sizeof(header_));
+        if (std::memcmp(header_.magic, "YCMB", 4) != 0 || header_.version != YCOMBINED_VERSION ||
+            header_.layerCount != LAYER_COUNT || header_.fileSize > size) return false;
+        size_t pixels = (size_t)header_.width * header_.height;
+        if (header_.codesOffset + pixels * LAYER_COUNT > header_.signOffset ||
+            header_.signOffset + header_.height > header_.fileSize) return false;
+
+        const uint8_t* p = data + header_.dictOffset;
+        const uint8_t* end = data + header_.codesOffset;
+        auto get16 = [&](size_t& v) {
+            if (end - p < 2) return false;
+            v = (size_t)p[0] | ((size_t)p[1] << 8);
+            p += 2;
+            return true;
+        };
+        auto getDict = [&](std::vector<std::string>& dict) {
+            size_t count = 0;
+            if (!get16(count)) return false;
+            dict.clear();
+            dict.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                size_t len = 0;
+                if (!get16(len) || (size_t)(end - p) < len) return false;
+                dict.emplace_back(reinterpret_cast<const char*>(p), len);
+                p += len;
+            }
+            return true;
+        };
+        for (int l = 0; l < LAYER_COUNT; ++l) if (!getDict(dict_[l])) return false;
+        if (!getDict(signDict_) || !getDict(zhenbanDict_)) return false;
+        size_t zbCount = 0;
+        if (!get16(zbCount) || (size_t)(end - p) < zbCount || zbCount != dict_[LAYER_SEMA].size()) return false;
+        semaZhenban_.assign(p, p + zbCount);
+        for (uint8_t z : semaZhenban_) if (z >= zhenbanDict_.size()) return false;
+
+        for (int l = 0; l < LAYER_COUNT; ++l) codes_[l] = data + header_.codesOffset + pixels * l;
+        rowSign_ = data + header_.signOffset;
+
+        // 校验所有索引均落在字典范围内, 之后的访问无需再做边界检查
+        for (int l = 0; l < LAYER_COUNT; ++l) {
+            uint8_t maxIdx = 0;
+            for (size_t i = 0; i < pixels; ++i) maxIdx = codes_[l][i] > maxIdx ? codes_[l][i] : maxIdx;
+            if (pixels && maxIdx >= dict_[l].size()) return false;
+        }
+        for (uint32_t y = 0; y < header_.height; ++y) if (rowSign_[y] >= signDict_.size()) return false;
+        return true;
+    }
+
+    // 直接引用内存中的合并结果 (调用方负责保证 design 的生命周期)
+    void Attach(const CombinedDesign& d) {
+        file_.Close();
+        header_ = YCombinedHeader{};
+        std::memcpy(header_.magic, "YCMB", 4);
+        header_.version = YCOMBINED_VERSION;
+        header_.layerCount = LAYER_COUNT;
+        header_.width = (uint32_t)d.width;
+        header_.height = (uint32_t)d.height;
+        header_.shaxianTypes = (uint32_t)d.shaxianTypes;
+        for (int l = 0; l < LAYER_COUNT; ++l) {
+            dict_[l] = d.dict[l];
+            codes_[l] = d.codes[l].data();
+        }
+        signDict_ = d.signDict;
+        zhenbanDict_ = d.zhenbanDict;
+        semaZhenban_ = d.semaZhenban;
+        rowSign_ = d.rowSign.data();
+    }
+
+    int width() const { return (int)header_.width; }
+    int height() const { return (int)header_.height; }
+    int shaxianTypes() const { return (int)header_.shaxianTypes; }
+
+    // 1 起始坐标
+    uint8_t CodeIndex(int layer, int x, int y) const { return codes_[layer][(size_t)(y - 1) * header_.width + (x - 1)]; }
+    const std::string& Code(int layer, int x, int y) const { return dict_[layer][CodeIndex(layer, x, y)]; }
+    const std::string& Sign(int y) const { return signDict_[rowSign_[y - 1]]; }
+    const std::string& Zhenban(int x, int y) const { return zhenbanDict_[semaZhenban_[CodeIndex(LAYER_SEMA, x, y)]]; }
+
+    // 字典及索引, 供按索引批量处理 (如逐行哈希) 时避免逐像素的字符串访问
+    const std::vector<std::string>& Dict(int layer) const { return dict_[layer]; }
+    const std::vector<std::string>& SignDict() const { return signDict_; }
+    const std::vector<std::string>& ZhenbanDict() const { return zhenbanDict_; }
+    uint8_t SignIndex(int y) const { return rowSign_[y - 1]; }
+    uint8_t ZhenbanIndex(uint8_t semaIndex) const { return semaZhenban_[semaIndex]; }
+
+    CombinedPixel Pixel(int x, int y) const {
+        return { Code(LAYER_SEMA, x, y), Code(LAYER_SHAXIAN, x, y), Code(LAYER_LUOLA, x, y),
+                 Code(LAYER_DUMU, x, y), Zhenban(x, y), Sign(y) };
+    }
+
+private:
+    MappedFile file_;
+    YCombinedHeader header_{};
+    std::vector<std::string> dict_[LAYER_COUNT];
+    std::vector<std::string> signDict_;
+    std::vector<std::string> zhenbanDict_;
+    std::vector<uint8_t> semaZhenban_;
+    const uint8_t* codes_[LAYER_COUNT] = {};
+    const uint8_t* rowSign_ = nullptr;
+};
+
+#endif // YCOMBINED_FORMAT_H
@@ -1,135 +1,103 @@
 #include <napi.h>
-#include <iostream>
-#include <vector>
 #include <string>
-#include <filesystem>
-#include <fstream>
+#include <vector>
 #include "encoding_utils.h"
+#include "yima_pipeline.h"
+#include "batch_runner.h"
+#include "design_session.h"
+#include "mapped_file.h"
+#include "program_optimize.h"
+#include "run_report.h"
+#include "yima_log.h"
+#include "yima_trace.h"
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
 
-namespace fs = std::filesystem;
-
-// 引入各模块的头文件
-#include "1.bmp_extract/bmp_extract.h"
-#include "2.toml_handle/toml_handle.h"
-#include "3.data_csv_handle/data_csv_handle.h"
-#include "4.cmd_csv_handle/cmd_csv_handle.h"
-#include "5.txt_generator/txt_generator.h"
-#include "6.txt_handle/txt_handle.h"
-
-namespace fs = std::filesystem;
-
-// 辅助函数：确保目录存在
-void ensure_directory_exists(const fs::path& p) {
-    if (!fs::exists(p)) {
-        fs::create_directories(p);
-    }
-}
-
-// 包装 Step 1: 遍历目录处理 BMP
-int extract_bmp_to_toml_dir(const std::string& input_dir, const std::string& output_dir) {
-    try {
-        fs::path input_path = CreatePathFromUtf8(input_dir);
-        fs::path output_path = CreatePathFromUtf8(output_dir);
-        
-        ensure_directory_exists(output_path);
-        bool found = false;
-        if (fs::exists(input_path) && fs::is_directory(input_path)) {
-             for (const auto& entry : fs::directory_iterator(input_path)) {
-                if (entry.is_regular_file() && entry.path().extension() == ".bmp") {
-                    found = true;
-                    // std::cout << "Processing BMP: " << entry.path().string() << std::endl;
-                    char* result = process_bmp_to_toml(entry.path().string().c_str());
-                    if (result) {
-                        fs::path out_path = output_path / entry.path().filename().replace_extension(".toml");
-                        std::ofstream out(out_path);
-                        if (out.is_open()) {
-                            out << result;
-                            out.close();
-                        }
-                        free_toml_buffer(result);
-                    } else {
-                        std::cerr << "Failed to process: " << entry.path() << std::endl;
-                        return -1;
-                    }
-                }
-            }
-        } else {
-            #ifdef _WIN32
-            std::cerr << "Input directory not found: " << WideToUtf8(input_path.wstring()) << std::endl;
-            #else
-            std::cerr << "Input directory not found: " << input_dir << std::endl;
-            #endif
-            return -1;
-        }
-
-        if (!found) std::cout << "No .bmp files found in " << input_dir << std::endl;
-        return 0;
-    } catch (const std::exception& e) {
-        std::cerr << "Exception in step 1: " << e.what() << std::endl;
-        return -1;
-    }
+// Helper function to convert UTF-8 string properly on Windows
+std::string ConvertToUtf8(const std::string& utf8_from_js) {
+    // JavaScript strings are already UTF-8, just return them directly
+    return utf8_from_js;
 }
 
-// Main logic
-int ProcessBmpTranslation(const std::string& config_path, const std::string& input_path, const std::string& output_path) {
-    try {
-        // Create fs::path objects from UTF-8 strings with proper encoding handling
-        fs::path input_dir = CreatePathFromUtf8(input_path);
-        fs::path output_dir = CreatePathFromUtf8(output_path);
-        fs::path config_dir = CreatePathFromUtf8(config_path);
-
-        // 1. 定义中间路径
-        fs::path toml_dir = output_dir / "toml";
-
-        ensure_directory_exists(output_dir);
-        ensure_directory_exists(toml_dir);
-
-        // Convert paths to UTF-8 strings for passing to C-style functions
-        std::string toml_dir_str = PathToUtf8String(toml_dir);
-        std::string output_dir_str = PathToUtf8String(output_dir);
-        std::string config_path_str = PathToUtf8String(config_dir);
-
-        // Step 1: Extract BMP to TOML
-        std::cout << "[Step 1] Extracting BMP to TOML..." << std::endl;
-        if (extract_bmp_to_toml_dir(input_path, toml_dir_str) != 0) return -1;
+// 每个 Node 环境 (主线程与每个 worker_threads) 各自一份的插件状态, 经 SetInstanceData 绑定,
+// 环境销毁时随之释放; 插件不保存任何跨环境共享的 JS 对象
+struct YimaAddonData {
+    Napi::FunctionReference programStream;   // ProgramStream 构造函数, 只在本环境内使用
+    uint64_t logChannel = 0;                 // 本环境的日志通道 (见 setLogOptions), 0 表示使用进程级设置
+    Napi::Env::CleanupHook<void (*)(YimaAddonData*), YimaAddonData> logHook;
 
-        // Step 2: Combine TOML
-        std::cout << "[Step 2] Combining TOML files..." << std::endl;
-        if (CombineTomlFiles(toml_dir_str.c_str(), output_dir_str.c_str(), config_path_str.c_str()) != 0) return -2;
-
-        // Step 3: Generate Data CSV
-        std::cout << "[Step 3] Generating Data CSV..." << std::endl;
-        if (GenerateDataCsv(toml_dir_str.c_str(), output_dir_str.c_str()) != 0) return -3;
-
-        // Step 4: Generate Command CSV
-        std::cout << "[Step 4] Generating Command CSV..." << std::endl;
-        if (GenerateCmdCsv(toml_dir_str.c_str(), output_dir_str.c_str(), config_path_str.c_str()) != 0) return -4;
-
-        // Step 5: Generate TXT
-        std::cout << "[Step 5] Generating TXT from CSV..." << std::endl;
-        if (GenerateRawTxt(output_dir_str.c_str(), output_dir_str.c_str(), config_path_str.c_str()) != 0) return -5;
-
-        // Step 6: Finalize TXT
-        std::cout << "[Step 6] Finalizing TXT handle..." << std::endl;
-        if (PostProcessTxt(output_dir_str.c_str(), output_dir_str.c_str()) != 0) return -6;
+    // 环境销毁时删除本环境的日志通道 (在回调的 ThreadSafeFunction 被清理之前执行)
+    static void DestroyLogChannelHook(YimaAddonData* data) {
+        DestroyLogChannel(data->logChannel);
+        data->logChannel = 0;
+    }
+};
 
-        std::cout << "--- All steps completed successfully! ---" << std::endl;
-        return 0;
+// 本环境发起的调用 (包括其工作线程) 写入的日志通道
+static uint64_t EnvLogChannel(Napi::Env env) {
+    return env.GetInstanceData<YimaAddonData>()->logChannel;
+}
 
-    } catch (const std::exception& e) {
-        std::cerr << "Exception: " << e.what() << std::endl;
-        return -100;
+// 运行报告 -> { code, wallMs, cpuMs, width, height, stages: [...], compression: {...}, rowReuse: {...} }
+static Napi::Object RunReportObject(Napi::Env env, const RunReport& report) {
+    Napi::Array stages = Napi::Array::New(env, report.stages.size());
+    for (size_t i = 0; i < report.stages.size(); ++i) {
+        const StageMetrics& m = report.stages[i];
+        Napi::Object o = Napi::Object::New(env);
+        o.Set("step", Napi::Number::New(env, m.step));
+        o.Set("name", Napi::String::New(env, m.name));
+        o.Set("code", Napi::Number::New(env, m.code));
+        o.Set("skipped", Napi::Boolean::New(env, m.skipped));
+        o.Set("wallMs", Napi::Number::New(env, m.wallMs));
+        o.Set("cpuMs", Napi::Number::New(env, m.cpuMs));
+        o.Set("inputBytes", Napi::Number::New(env, (double)m.inputBytes));
+        o.Set("outputBytes", Napi::Number::New(env, (double)m.outputBytes));
+        o.Set("rows", Napi::Number::New(env, (double)m.rows));
+        o.Set("pixels", Napi::Number::New(env, (double)m.pixels));
+        o.Set("commandLines", Napi::Number::New(env, (double)m.commandLines));
+        o.Set("peakRssBytes", Napi::Number::New(env, (double)m.peakRssBytes));
+        stages.Set((uint32_t)i, o);
     }
+    const CompressionMetrics& c = report.compression;
+    Napi::Object compression = Napi::Object::New(env);
+    compression.Set("rawLines", Napi::Number::New(env, (double)c.rawLines));
+    compression.Set("compressedLines", Napi::Number::New(env, (double)c.compressedLines));
+    compression.Set("loops", Napi::Number::New(env, (double)c.loops));
+    compression.Set("maxDepth", Napi::Number::New(env, c.maxDepth));
+    const RowReuseMetrics& r = report.rowReuse;
+    Napi::Object rowReuse = Napi::Object::New(env);
+    rowReuse.Set("reusedIndex", Napi::Boolean::New(env, r.reusedIndex));
+    rowReuse.Set("rows", Napi::Number::New(env, (double)r.rows));
+    rowReuse.Set("regeneratedRows", Napi::Number::New(env, (double)r.regeneratedRows));
+    rowReuse.Set("segments", Napi::Number::New(env, (double)r.segments));
+    rowReuse.Set("reusedSegments", Napi::Number::New(env, (double)r.reusedSegments));
+
+    Napi::Object out = Napi::Object::New(env);
+    out.Set("code", Napi::Number::New(env, report.code));
+    out.Set("wallMs", Napi::Number::New(env, report.wallMs));
+    out.Set("cpuMs", Napi::Number::New(env, report.cpuMs));
+    out.Set("width", Napi::Number::New(env, report.width));
+    out.Set("height", Napi::Number::New(env, report.height));
+    out.Set("stages", stages);
+    out.Set("compression", compression);
+    out.Set("rowReuse", rowReuse);
+    return out;
 }
 
-// Helper function to convert UTF-8 string properly on Windows
-std::string ConvertToUtf8(const std::string& utf8_from_js) {
-    // JavaScript strings are already UTF-8, just return them directly
-    return utf8_from_js;
+// 选项中的 optimize: true 为全部优化遍, 数字为 ProgramPass 的按位组合, 其它值为不优化
+static unsigned OptimizeOption(const Napi::Object& opts) {
+    Napi::Value v = opts.Get("optimize");
+    if (v.IsBoolean()) return v.As<Napi::Boolean>().Value() ? (unsigned)PROGRAM_PASS_ALL : 0u;
+    if (v.IsNumber()) return v.As<Napi::Number>().Uint32Value() & PROGRAM_PASS_ALL;
+    return 0;
 }
 
 // N-API Wrapper
-Napi::Number ProcessWrapped(const Napi::CallbackInfo& info) {
+Napi::Value ProcessWrapped(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 3) {
@@ -138,7 +106,7 @@ Napi::Number ProcessWrapped(const Napi::CallbackInfo& info) {
     }
 
     if (!info[0].IsString() || !info[1].IsString() || !info[2].IsString()) {
-        Napi::TypeError::New(env, "Wrong arguments: expected (config_path, input_path, output_path)").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Wrong arguments: expected (config_path, input_path, output_path[, options])").ThrowAsJavaScriptException();
         return Napi::Number::New(env, -1);
     }
 
@@ -148,12 +116,1072 @@ Napi::Number ProcessWrapped(const Napi::CallbackInfo& info) {
     std::string input_path = info[1].As<Napi::String>().Utf8Value();
     std::string output_path = info[2].As<Napi::String>().Utf8Value();
 
-    int result = ProcessBmpTranslation(config_path, input_path, output_path);
+    // 可选参数: { exportToml: true } 额外导出各图层与 combined 的 .toml 便于人工检查
+    //          { incremental: false } 忽略 build_manifest.toml, 强制重跑全部阶段
+    //          { report: true } 返回运行报告对象 (见 RunReportObject) 而不是返回码
+    //          { trace: true | "file" } 记录 Chrome trace, 写入 output_path/trace.json 或指定文件
+    //          { optimize: true | passes } 对指令执行优化遍 (见 OptimizeOption)
+    PipelineOptions options;
+    RunReport report;
+    if (info.Length() > 3 && info[3].IsObject()) {
+        Napi::Object opts = info[3].As<Napi::Object>();
+        Napi::Value v = opts.Get("exportToml");
+        options.export_toml = v.IsBoolean() && v.As<Napi::Boolean>().Value();
+        Napi::Value inc = opts.Get("incremental");
+        if (inc.IsBoolean()) options.incremental = inc.As<Napi::Boolean>().Value();
+        Napi::Value rep = opts.Get("report");
+        if (rep.IsBoolean() && rep.As<Napi::Boolean>().Value()) options.report = &report;
+        Napi::Value tr = opts.Get("trace");
+        if (tr.IsString()) options.trace_path = tr.As<Napi::String>().Utf8Value();
+        else if (tr.IsBoolean() && tr.As<Napi::Boolean>().Value()) options.trace_path = PathToUtf8String(CreatePathFromUtf8(output_path) / "trace.json");
+        options.optimize = OptimizeOption(opts);
+    }
+
+    LogChannelScope logScope(EnvLogChannel(env));
+    int result = ProcessBmpTranslation(config_path, input_path, output_path, options);
+    if (options.report) return RunReportObject(env, report);
     return Napi::Number::New(env, result);
 }
 
+// 从 Buffer / TypedArray / ArrayBuffer 中取得数据指针 (不复制)
+static bool GetBmpBytes(const Napi::Value& v, BmpBuffer& out) {
+    if (v.IsTypedArray()) {
+        Napi::TypedArray t = v.As<Napi::TypedArray>();
+        out.data = static_cast<const uint8_t*>(t.ArrayBuffer().Data()) + t.ByteOffset();
+        out.size = t.ByteLength();
+        return true;
+    }
+    if (v.IsArrayBuffer()) {
+        Napi::ArrayBuffer ab = v.As<Napi::ArrayBuffer>();
+        out.data = static_cast<const uint8_t*>(ab.Data());
+        out.size = ab.ByteLength();
+        return true;
+    }
+    return false;
+}
+
+// 将 std::string 的所有权交给 JS Buffer; 运行时禁止外部缓冲区 (如 Electron 的 V8 沙箱) 时退化为一次拷贝
+static Napi::Buffer<char> ExternalStringBuffer(Napi::Env env, std::string&& s) {
+    std::string* holder = new std::string(std::move(s));
+    return Napi::Buffer<char>::NewOrCopy(env, holder->data(), holder->size(),
+        [](Napi::Env, char*, std::string* h) { delete h; }, holder);
+}
+
+// 调色板转为 RGBA 查找表 (每项 4 字节, alpha 固定为 255), 渲染时可直接按索引取色
+static Napi::Buffer<uint8_t> PaletteTable(Napi::Env env, const std::vector<LayerColor>& palette) {
+    Napi::Buffer<uint8_t> table = Napi::Buffer<uint8_t>::New(env, palette.size() * 4);
+    for (size_t i = 0; i < palette.size(); ++i) {
+        table.Data()[i * 4 + 0] = palette[i].r;
+        table.Data()[i * 4 + 1] = palette[i].g;
+        table.Data()[i * 4 + 2] = palette[i].b;
+        table.Data()[i * 4 + 3] = 255;
+    }
+    return table;
+}
+
+// 图层预览: { width, height, indices, palette, shared }
+// indices 为行主序的调色板索引 (第 0 行对应 y = 1); shared 表示 indices 直接引用原生内存 (否则为副本)
+static Napi::Object LayerPreviewObject(Napi::Env env, const LayerGrid& grid, const Napi::Buffer<uint8_t>& indices, bool shared) {
+    Napi::Object o = Napi::Object::New(env);
+    o.Set("width", Napi::Number::New(env, grid.width));
+    o.Set("height", Napi::Number::New(env, grid.height));
+    o.Set("indices", indices);
+    o.Set("palette", PaletteTable(env, grid.palette));
+    o.Set("shared", Napi::Boolean::New(env, shared));
+    return o;
+}
+
+// 将解码后的图层整体交给 JS: indices 引用图层自身的像素内存, 随 Buffer 回收一并释放
+static Napi::Object OwnedLayerPreview(Napi::Env env, LayerGrid&& grid) {
+    LayerGrid* holder = new LayerGrid(std::move(grid));
+    uint8_t* native = holder->indices.data();
+    Napi::Object o = Napi::Object::New(env);
+    o.Set("width", Napi::Number::New(env, holder->width));
+    o.Set("height", Napi::Number::New(env, holder->height));
+    o.Set("palette", PaletteTable(env, holder->palette));
+    // NewOrCopy 退化为拷贝时会立即调用回收回调, 之后不能再访问 holder
+    Napi::Buffer<uint8_t> indices = Napi::Buffer<uint8_t>::NewOrCopy(env, native, holder->indices.size(),
+        [](Napi::Env, uint8_t*, LayerGrid* g) { delete g; }, holder);
+    o.Set("indices", indices);
+    o.Set("shared", Napi::Boolean::New(env, indices.Data() == native));
+    return o;
+}
+
+// translateBuffers 的后台任务: 在工作线程上解码、合并并生成指令
+class TranslateBuffersWorker : public Napi::AsyncWorker {
+public:
+    TranslateBuffersWorker(Napi::Env env, std::string config_path, unsigned optimize)
+        : Napi::AsyncWorker(env), deferred_(Napi::Promise::Deferred::New(env)), config_path_(std::move(config_path)),
+          optimize_(optimize), logChannel_(EnvLogChannel(env)) {}
+
+    // 记录一个图层的输入, 并保持其 JS 对象在任务完成前存活
+    void SetLayer(int index, const Napi::Value& v, const BmpBuffer& bytes) {
+        buffers_[index] = bytes;
+        refs_.push_back(Napi::Persistent(v.As<Napi::Object>()));
+    }
+
+    Napi::Promise Promise() { return deferred_.Promise(); }
+
+    void Execute() override {
+        LogChannelScope logScope(logChannel_);
+        YimaConfig cfg;
+        if (!LoadYimaConfig(CreatePathFromUtf8(config_path_), cfg)) {
+            result_ = -100;
+            SetError("Failed to load configuration from " + config_path_);
+            return;
+        }
+        result_ = TranslateBmpBuffers(cfg, buffers_, output_, optimize_);
+        if (result_ != 0) SetError("translateBuffers failed with code " + std::to_string(result_));
+    }
+
+    void OnOK() override {
+        Napi::Env env = Env();
+        Napi::Object out = Napi::Object::New(env);
+        out.Set("simple", ExternalStringBuffer(env, std::move(output_.simple)));
+        out.Set("compressed", ExternalStringBuffer(env, std::move(output_.compressed)));
+        deferred_.Resolve(out);
+    }
+
+    void OnError(const Napi::Error& e) override {
+        e.Value().Set("code", Napi::Number::New(Env(), result_));
+        deferred_.Reject(e.Value());
+    }
+
+private:
+    Napi::Promise::Deferred deferred_;
+    std::string config_path_;
+    unsigned optimize_;
+    uint64_t logChannel_;
+    BmpBuffer buffers_[LAYER_COUNT];
+    std::vector<Napi::ObjectReference> refs_;
+    ProgramOutput output_;
+    int result_ = 0;
+};
+
+// translateBuffers(config_path, { sema, shaxian, luola, dumu }[, { optimize }]) -> Promise<{ simple: Buffer, compressed: Buffer }>
+// 图层可以是 Buffer / Uint8Array / ArrayBuffer, 也可以按上述顺序传入数组; 全程不读写临时文件
+Napi::Value TranslateBuffersWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsObject()) {
+        Napi::TypeError::New(env, "Wrong arguments: expected (config_path, { sema, shaxian, luola, dumu })").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    Napi::Object layers = info[1].As<Napi::Object>();
+    bool isArray = info[1].IsArray();
+
+    unsigned optimize = info.Length() > 2 && info[2].IsObject() ? OptimizeOption(info[2].As<Napi::Object>()) : 0;
+    TranslateBuffersWorker* worker = new TranslateBuffersWorker(env, info[0].As<Napi::String>().Utf8Value(), optimize);
+    for (int li = 0; li < LAYER_COUNT; ++li) {
+        Napi::Value v = isArray ? layers.Get((uint32_t)li) : layers.Get(LAYER_NAMES[li]);
+        if (v.IsUndefined() || v.IsNull()) continue;
+        BmpBuffer bytes;
+        if (!GetBmpBytes(v, bytes)) {
+            delete worker;
+            Napi::TypeError::New(env, std::string("Layer '") + LAYER_NAMES[li] + "' must be a Buffer, TypedArray or ArrayBuffer").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        worker->SetLayer(li, v, bytes);
+    }
+
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+// decodeLayers 的后台任务: 在工作线程上解码四个图层
+class DecodeLayersWorker : public Napi::AsyncWorker {
+public:
+    DecodeLayersWorker(Napi::Env env, std::string input_path)
+        : Napi::AsyncWorker(env), deferred_(Napi::Promise::Deferred::New(env)), input_path_(std::move(input_path)),
+          logChannel_(EnvLogChannel(env)) {}
+
+    void SetLayer(int index, const Napi::Value& v, const BmpBuffer& bytes) {
+        buffers_[index] = bytes;
+        refs_.push_back(Napi::Persistent(v.As<Napi::Object>()));
+    }
+
+    Napi::Promise Promise() { return deferred_.Promise(); }
+
+    void Execute() override {
+        LogChannelScope logScope(logChannel_);
+        for (int li = 0; li < LAYER_COUNT; ++li) {
+            bool ok = true;
+            if (!input_path_.empty()) {
+                std::filesystem::path file = CreatePathFromUtf8(input_path_) / (std::string(LAYER_NAMES[li]) + ".bmp");
+                if (!std::filesystem::exists(file)) continue;
+                ok = DecodeBmpLayerFile(file, grids_[li]);
+            } else if (buffers_[li].data) {
+                ok = DecodeBmpLayer(buffers_[li].data, buffers_[li].size, grids_[li]);
+            } else {
+                continue;
+            }
+            if (!ok) {
+                SetError(std::string("Failed to decode layer '") + LAYER_NAMES[li] + "'");
+                return;
+            }
+            present_[li] = true;
+        }
+    }
+
+    void OnOK() override {
+        Napi::Env env = Env();
+        Napi::Object out = Napi::Object::New(env);
+        for (int li = 0; li < LAYER_COUNT; ++li) {
+            out.Set(LAYER_NAMES[li], present_[li] ? Napi::Value(OwnedLayerPreview(env, std::move(grids_[li]))) : env.Null());
+        }
+        deferred_.Resolve(out);
+    }
+
+    void OnError(const Napi::Error& e) override {
+        deferred_.Reject(e.Value());
+    }
+
+private:
+    Napi::Promise::Deferred deferred_;
+    std::string input_path_;
+    uint64_t logChannel_;
+    BmpBuffer buffers_[LAYER_COUNT];
+    std::vector<Napi::ObjectReference> refs_;
+    LayerGrid grids_[LAYER_COUNT];
+    bool present_[LAYER_COUNT] = {};
+};
+
+// decodeLayers(input_dir | { sema, shaxian, luola, dumu }) -> Promise<{ sema: { width, height, indices, palette, shared } | null, ... }>
+// 供渲染进程直接绘制图层预览, 无需在 JS 中再次解码 BMP; indices 在运行时允许时直接引用原生内存
+Napi::Value DecodeLayersWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !(info[0].IsString() || info[0].IsObject())) {
+        Napi::TypeError::New(env, "Wrong arguments: expected (input_dir | { sema, shaxian, luola, dumu })").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    DecodeLayersWorker* worker = new DecodeLayersWorker(env, info[0].IsString() ? info[0].As<Napi::String>().Utf8Value() : std::string());
+    if (!info[0].IsString()) {
+        Napi::Object layers = info[0].As<Napi::Object>();
+        bool isArray = info[0].IsArray();
+        for (int li = 0; li < LAYER_COUNT; ++li) {
+            Napi::Value v = isArray ? layers.Get((uint32_t)li) : layers.Get(LAYER_NAMES[li]);
+            if (v.IsUndefined() || v.IsNull()) continue;
+            BmpBuffer bytes;
+            if (!GetBmpBytes(v, bytes)) {
+                delete worker;
+                Napi::TypeError::New(env, std::string("Layer '") + LAYER_NAMES[li] + "' must be a Buffer, TypedArray or ArrayBuffer").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            worker->SetLayer(li, v, bytes);
+        }
+    }
+
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+// processBatch 的后台任务: 在固定大小的原生线程池上处理全部设计
+class BatchWorker : public Napi::AsyncWorker {
+public:
+    BatchWorker(Napi::Env env, std::vector<BatchJob> jobs, int concurrency, std::string trace_path)
+        : Napi::AsyncWorker(env), deferred_(Napi::Promise::Deferred::New(env)),
+          jobs_(std::move(jobs)), concurrency_(concurrency), tracePath_(std::move(trace_path)),
+          logChannel_(EnvLogChannel(env)) {}
+
+    Napi::Promise Promise() { return deferred_.Promise(); }
+
+    void Execute() override {
+        LogChannelScope logScope(logChannel_);
+        std::unique_ptr<TraceSession> trace;
+        if (!tracePath_.empty()) trace = std::make_unique<TraceSession>(CreatePathFromUtf8(tracePath_));
+        RunBatch(jobs_, concurrency_, results_, summary_);
+    }
+
+    void OnOK() override {
+        Napi::Env env = Env();
+        Napi::Array results = Napi::Array::New(env, results_.size());
+        for (size_t i = 0; i < results_.size(); ++i) {
+            const BatchJobResult& r = results_[i];
+            Napi::Object o = Napi::Object::New(env);
+            o.Set("input", Napi::String::New(env, jobs_[i].input_path));
+            o.Set("output", Napi::String::New(env, jobs_[i].output_path));
+            o.Set("ok", Napi::Boolean::New(env, r.code == 0));
+            o.Set("code", Napi::Number::New(env, r.code));
+            o.Set("worker", Napi::Number::New(env, r.worker));
+            o.Set("startMs", Napi::Number::New(env, r.startMs));
+            o.Set("wallMs", Napi::Number::New(env, r.wallMs));
+            if (!r.error.empty()) o.Set("error", Napi::String::New(env, r.error));
+            if (jobs_[i].report) o.Set("report", RunReportObject(env, r.report));
+            results.Set((uint32_t)i, o);
+        }
+        Napi::Object out = Napi::Object::New(env);
+        out.Set("results", results);
+        out.Set("concurrency", Napi::Number::New(env, summary_.concurrency));
+        out.Set("configCount", Napi::Number::New(env, summary_.configCount));
+        out.Set("configMs", Napi::Number::New(env, summary_.configMs));
+        out.Set("wallMs", Napi::Number::New(env, summary_.wallMs));
+        deferred_.Resolve(out);
+    }
+
+    void OnError(const Napi::Error& e) override {
+        deferred_.Reject(e.Value());
+    }
+
+private:
+    Napi::Promise::Deferred deferred_;
+    std::vector<BatchJob> jobs_;
+    int concurrency_;
+    std::string tracePath_;
+    uint64_t logChannel_;
+    std::vector<BatchJobResult> results_;
+    BatchSummary summary_;
+};
+
+// processBatch(jobs, { concurrency, config, exportToml, incremental, report, trace, optimize }) -> Promise<{ results, concurrency, wallMs, ... }>
+// jobs: [{ config?, input, output, exportToml?, report? }], 未指定 config 的任务使用 options.config
+// report 为 true 的任务在结果中附带运行报告 (同 processBmpTranslation 的 { report: true })
+// trace 为文件路径时把整个批处理 (全部工作线程) 记录为一个 Chrome trace
+// 相同配置目录只加载一次并在线程间共享; 单个任务失败不影响其它任务, 结果按 jobs 顺序返回
+Napi::Value ProcessBatchWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsArray()) {
+        Napi::TypeError::New(env, "Wrong arguments: expected (jobs[, { concurrency, config, exportToml, incremental, report, trace }])").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    int concurrency = 0;
+    std::string default_config;
+    bool default_export = false;
+    bool incremental = true;
+    bool default_report = false;
+    unsigned optimize = 0;
+    std::string trace_path;
+    if (info.Length() > 1 && info[1].IsObject()) {
+        Napi::Object opts = info[1].As<Napi::Object>();
+        Napi::Value c = opts.Get("concurrency");
+        if (c.IsNumber()) concurrency = c.As<Napi::Number>().Int32Value();
+        Napi::Value cfg = opts.Get("config");
+        if (cfg.IsString()) default_config = cfg.As<Napi::String>().Utf8Value();
+        Napi::Value t = opts.Get("exportToml");
+        default_export = t.IsBoolean() && t.As<Napi::Boolean>().Value();
+        Napi::Value inc = opts.Get("incremental");
+        if (inc.IsBoolean()) incremental = inc.As<Napi::Boolean>().Value();
+        Napi::Value rep = opts.Get("report");
+        default_report = rep.IsBoolean() && rep.As<Napi::Boolean>().Value();
+        Napi::Value tr = opts.Get("trace");
+        if (tr.IsString()) trace_path = tr.As<Napi::String>().Utf8Value();
+        optimize = OptimizeOption(opts);
+    }
+
+    Napi::Array arr = info[0].As<Napi::Array>();
+    std::vector<BatchJob> jobs;
+    jobs.reserve(arr.Length());
+    for (uint32_t i = 0; i < arr.Length(); ++i) {
+        Napi::Value v = arr.Get(i);
+        if (!v.IsObject()) {
+            Napi::TypeError::New(env, "jobs[" + std::to_string(i) + "] must be an object").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        Napi::Object o = v.As<Napi::Object>();
+        Napi::Value cfg = o.Get("config"), in = o.Get("input"), out = o.Get("output"), t = o.Get("exportToml");
+        if (!in.IsString() || !out.IsString() || !(cfg.IsString() || !default_config.empty())) {
+            Napi::TypeError::New(env, "jobs[" + std::to_string(i) + "] needs string input, output and config").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        BatchJob job;
+        job.config_path = cfg.IsString() ? cfg.As<Napi::String>().Utf8Value() : default_config;
+        job.input_path = in.As<Napi::String>().Utf8Value();
+        job.output_path = out.As<Napi::String>().Utf8Value();
+        job.options.export_toml = t.IsBoolean() ? t.As<Napi::Boolean>().Value() : default_export;
+        job.options.incremental = incremental;
+        job.options.optimize = optimize;
+        Napi::Value rep = o.Get("report");
+        job.report = rep.IsBoolean() ? rep.As<Napi::Boolean>().Value() : default_report;
+        jobs.push_back(std::move(job));
+    }
+
+    BatchWorker* worker = new BatchWorker(env, std::move(jobs), concurrency, std::move(trace_path));
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+// streamProgram 的共享状态: 生产线程逐块生成指令, 经 ThreadSafeFunction 交给主线程上的迭代器
+struct ProgramStreamState {
+    // 生产线程与主线程共享 (受 mutex 保护)
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t outstanding = 0;      // 已发出但尚未被 next() 取走的块数, 用于限制内存占用
+    bool cancelled = false;
+
+    // 以下仅在主线程访问
+    std::deque<std::string> ready;
+    std::deque<Napi::Promise::Deferred> waiting;
+    std::vector<Napi::ObjectReference> inputs;   // 输入 Buffer 在生成结束前保持存活
+    bool finished = false;
+    bool closed = false;         // 已通过 return() 结束或已向 JS 报告完成/错误
+    int code = 0;
+    std::string error;
+
+    // 只由生产线程访问
+    std::string config_path;
+    std::string input_path;
+    BmpBuffer buffers[LAYER_COUNT];
+    ProgramFormat format = ProgramFormat::Simple;
+    size_t chunk_size = 0;
+    unsigned optimize = 0;
+    uint64_t logChannel = 0;
+
+    Napi::ThreadSafeFunction tsfn;
+    std::thread producer;
+    Napi::Env::CleanupHook<void (*)(ProgramStreamState*), ProgramStreamState> cleanup;
+
+    void Cancel() {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        cv.notify_all();
+    }
+    void Consumed() {
+        std::lock_guard<std::mutex> lock(mutex);
+        --outstanding;
+        cv.notify_all();
+    }
+    static void CancelOnTeardown(ProgramStreamState* s) { s->Cancel(); }
+};
+
+// 生产线程最多领先消费者的块数
+static const size_t PROGRAM_STREAM_MAX_OUTSTANDING = 8;
+
+static Napi::Object IteratorResult(Napi::Env env, Napi::Value value, bool done) {
+    Napi::Object r = Napi::Object::New(env);
+    r.Set("value", value);
+    r.Set("done", Napi::Boolean::New(env, done));
+    return r;
+}
+
+// 异步迭代器对象: for await (const chunk of addon.streamProgram(...))
+class ProgramStreamWrap : public Napi::ObjectWrap<ProgramStreamWrap> {
+public:
+    static void Define(Napi::Env env, YimaAddonData& data) {
+        Napi::Function cls = DefineClass(env, "ProgramStream", {
+            InstanceMethod("next", &ProgramStreamWrap::Next),
+            InstanceMethod("return", &ProgramStreamWrap::Return),
+            InstanceMethod(Napi::Symbol::WellKnown(env, "asyncIterator"), &ProgramStreamWrap::Self),
+        });
+        data.programStream = Napi::Persistent(cls);
+    }
+
+    ProgramStreamWrap(const Napi::CallbackInfo& info) : Napi::ObjectWrap<ProgramStreamWrap>(info) {}
+
+    // 迭代器被回收时通知生产线程停止
+    ~ProgramStreamWrap() override {
+        if (state_) state_->Cancel();
+    }
+
+    void Start(Napi::Env env, std::shared_ptr<ProgramStreamState> state) {
+        state_ = std::move(state);
+        ProgramStreamState* st = state_.get();
+        std::shared_ptr<ProgramStreamState> keep = state_;
+        st->tsfn = Napi::ThreadSafeFunction::New(env, Napi::Function(), "yimaProgramStream", 0, 1,
+            [keep](Napi::Env) { if (keep->producer.joinable()) keep->producer.join(); });
+        // worker 退出时环境清理钩子按注册的逆序执行: 先取消生产线程, 否则等待消费者的生产线程
+        // 会让上面的 finalizer 在 join 时卡住。生成正常结束后由 Finish 移除
+        st->cleanup = env.AddCleanupHook(&ProgramStreamState::CancelOnTeardown, st);
+        st->producer = std::thread([keep] { Produce(keep); });
+    }
+
+    // 主线程: 收到一块数据
+    static void Deliver(Napi::Env env, ProgramStreamState& st, std::string&& chunk) {
+        if (st.closed) {
+            st.Consumed();
+            return;
+        }
+        if (!st.waiting.empty()) {
+            Napi::Promise::Deferred d = st.waiting.front();
+            st.waiting.pop_front();
+            st.Consumed();
+            d.Resolve(IteratorResult(env, ExternalStringBuffer(env, std::move(chunk)), false));
+            return;
+        }
+        st.ready.push_back(std::move(chunk));
+    }
+
+    // 主线程: 生成结束
+    static void Finish(Napi::Env env, ProgramStreamState& st, int code, std::string error) {
+        st.finished = true;
+        st.code = code;
+        st.error = std::move(error);
+        st.inputs.clear();
+        st.cleanup.Remove(env);
+        while (!st.waiting.empty()) {
+            Napi::Promise::Deferred d = st.waiting.front();
+            st.waiting.pop_front();
+            Settle(env, st, d);
+        }
+    }
+
+private:
+    // 生产线程: 加载配置, 读取图层并逐块生成
+    static void Produce(std::shared_ptr<ProgramStreamState> st) {
+        LogChannelScope logScope(st->logChannel);
+        int rc = 0;
+        std::string error;
+        YimaConfig cfg;
+        MappedFile files[LAYER_COUNT];
+        if (!LoadYimaConfig(CreatePathFromUtf8(st->config_path), cfg)) {
+            rc = -100;
+            error = "Failed to load configuration from " + st->config_path;
+        } else {
+            if (!st->input_path.empty()) {
+                for (int li = 0; li < LAYER_COUNT; ++li) {
+                    std::filesystem::path file = CreatePathFromUtf8(st->input_path) / (std::string(LAYER_NAMES[li]) + ".bmp");
+                    if (!files[li].Open(file)) continue;
+                    st->buffers[li].data = files[li].data();
+                    st->buffers[li].size = files[li].size();
+                }
+            }
+            rc = StreamBmpTranslation(cfg, st->buffers, st->format, st->chunk_size, [&](std::string&& chunk) {
+                {
+                    std::unique_lock<std::mutex> lock(st->mutex);
+                    st->cv.wait(lock, [&] { return st->cancelled || st->outstanding < PROGRAM_STREAM_MAX_OUTSTANDING; });
+                    if (st->cancelled) return false;
+                    ++st->outstanding;
+                }
+                std::string* data = new std::string(std::move(chunk));
+                napi_status status = st->tsfn.BlockingCall(data, [st](Napi::Env env, Napi::Function, std::string* c) {
+                    Deliver(env, *st, std::move(*c));
+                    delete c;
+                });
+                if (status != napi_ok) {
+                    delete data;
+                    return false;
+                }
+                return true;
+            }, st->optimize);
+            if (rc != 0 && rc != PROGRAM_STREAM_CANCELLED) error = "streamProgram failed with code " + std::to_string(rc);
+        }
+        for (auto& f : files) f.Close();
+
+        struct Done { int code; std::string error; };
+        Done* done = new Done{ rc, std::move(error) };
+        if (st->tsfn.BlockingCall(done, [st](Napi::Env env, Napi::Function, Done* d) {
+                Finish(env, *st, d->code, std::move(d->error));
+                delete d;
+            }) != napi_ok) {
+            delete done;
+        }
+        st->tsfn.Release();
+    }
+
+    // 生成结束后回应一次 next(): 先报告错误 (如有), 之后始终为 done
+    static void Settle(Napi::Env env, ProgramStreamState& st, const Napi::Promise::Deferred& d) {
+        if (!st.closed && st.code != 0 && st.code != PROGRAM_STREAM_CANCELLED) {
+            st.closed = true;
+            Napi::Error e = Napi::Error::New(env, st.error);
+            e.Set("code", Napi::Number::New(env, st.code));
+            d.Reject(e.Value());
+            return;
+        }
+        st.closed = true;
+        d.Resolve(IteratorResult(env, env.Undefined(), true));
+    }
+
+    Napi::Value Next(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        Napi::Promise::Deferred d = Napi::Promise::Deferred::New(env);
+        ProgramStreamState& st = *state_;
+        if (!st.ready.empty() && !st.closed) {
+            std::string chunk = std::move(st.ready.front());
+            st.ready.pop_front();
+            st.Consumed();
+            d.Resolve(IteratorResult(env, ExternalStringBuffer(env, std::move(chunk)), false));
+        } else if (st.finished || st.closed) {
+            Settle(env, st, d);
+        } else {
+            st.waiting.push_back(d);
+        }
+        return d.Promise();
+    }
+
+    // 提前结束迭代 (for await 中 break / return 时调用)
+    Napi::Value Return(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        ProgramStreamState& st = *state_;
+        st.Cancel();
+        st.closed = true;
+        for (size_t i = 0; i < st.ready.size(); ++i) st.Consumed();
+        st.ready.clear();
+        while (!st.waiting.empty()) {
+            st.waiting.front().Resolve(IteratorResult(env, env.Undefined(), true));
+            st.waiting.pop_front();
+        }
+        Napi::Promise::Deferred d = Napi::Promise::Deferred::New(env);
+        d.Resolve(IteratorResult(env, info.Length() > 0 ? info[0] : env.Undefined(), true));
+        return d.Promise();
+    }
+
+    Napi::Value Self(const Napi::CallbackInfo& info) { return info.This(); }
+
+    std::shared_ptr<ProgramStreamState> state_;
+};
+
+// streamProgram(config_path, input_dir | { sema, shaxian, luola, dumu }, { format, chunkSize, optimize }) -> AsyncIterable<Buffer>
+// format: "simple" (默认) / "raw" / "compressed"; chunkSize 默认 64 KiB, 除最后一块外每块大小相同
+// optimize 同 processBmpTranslation, 对 raw 格式无效
+// 生成在原生线程上进行, 最多领先消费者 8 块; 提前 break 会停止生成
+Napi::Value StreamProgramWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsString() || !(info[1].IsString() || info[1].IsObject())) {
+        Napi::TypeError::New(env, "Wrong arguments: expected (config_path, input_dir | { sema, shaxian, luola, dumu }[, { format, chunkSize }])").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto state = std::make_shared<ProgramStreamState>();
+    state->config_path = info[0].As<Napi::String>().Utf8Value();
+    state->logChannel = EnvLogChannel(env);
+    if (info.Length() > 2 && info[2].IsObject()) {
+        Napi::Object opts = info[2].As<Napi::Object>();
+        Napi::Value f = opts.Get("format");
+        if (f.IsString()) {
+            std::string name = f.As<Napi::String>().Utf8Value();
+            if (name == "simple") state->format = ProgramFormat::Simple;
+            else if (name == "raw") state->format = ProgramFormat::Raw;
+            else if (name == "compressed") state->format = ProgramFormat::Compressed;
+            else {
+                Napi::TypeError::New(env, "format must be \"simple\", \"raw\" or \"compressed\"").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+        }
+        Napi::Value c = opts.Get("chunkSize");
+        if (c.IsNumber() && c.As<Napi::Number>().Int64Value() > 0) state->chunk_size = (size_t)c.As<Napi::Number>().Int64Value();
+        state->optimize = OptimizeOption(opts);
+    }
+
+    if (info[1].IsString()) {
+        state->input_path = info[1].As<Napi::String>().Utf8Value();
+    } else {
+        Napi::Object layers = info[1].As<Napi::Object>();
+        bool isArray = info[1].IsArray();
+        for (int li = 0; li < LAYER_COUNT; ++li) {
+            Napi::Value v = isArray ? layers.Get((uint32_t)li) : layers.Get(LAYER_NAMES[li]);
+            if (v.IsUndefined() || v.IsNull()) continue;
+            if (!GetBmpBytes(v, state->buffers[li])) {
+                Napi::TypeError::New(env, std::string("Layer '") + LAYER_NAMES[li] + "' must be a Buffer, TypedArray or ArrayBuffer").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            state->inputs.push_back(Napi::Persistent(v.As<Napi::Object>()));
+        }
+    }
+
+    Napi::Object iterator = env.GetInstanceData<YimaAddonData>()->programStream.New({});
+    ProgramStreamWrap::Unwrap(iterator)->Start(env, state);
+    return iterator;
+}
+
+// probeDesign(input_path) -> { ok, width, height, layers: { sema: {...}, ... }, mismatches: [], errors: [] }
+// 只读取各 BMP 的文件头与调色板, 可在运行流水线前同步校验设计
+Napi::Value ProbeDesignWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Wrong arguments: expected (input_path)").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    LogChannelScope logScope(EnvLogChannel(env));
+    DesignProbe probe;
+    if (ProbeDesign(info[0].As<Napi::String>().Utf8Value(), probe) != 0) {
+        Napi::Error::New(env, "Input directory not found").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto toArray = [&](const std::vector<std::string>& v) {
+        Napi::Array a = Napi::Array::New(env, v.size());
+        for (size_t i = 0; i < v.size(); ++i) a.Set((uint32_t)i, Napi::String::New(env, v[i]));
+        return a;
+    };
+
+    Napi::Object layers = Napi::Object::New(env);
+    for (int li = 0; li < LAYER_COUNT; ++li) {
+        const LayerProbe& L = probe.layers[li];
+        if (!L.present) {
+            layers.Set(LAYER_NAMES[li], env.Null());
+            continue;
+        }
+        Napi::Object o = Napi::Object::New(env);
+        o.Set("valid", Napi::Boolean::New(env, L.valid));
+        if (L.valid) {
+            o.Set("width", Napi::Number::New(env, L.info.width));
+            o.Set("height", Napi::Number::New(env, L.info.height));
+            o.Set("topDown", Napi::Boolean::New(env, L.info.topDown));
+            o.Set("bitDepth", Napi::Number::New(env, L.info.bitCount));
+            o.Set("compression", Napi::Number::New(env, L.info.compression));
+            o.Set("paletteSize", Napi::Number::New(env, L.info.paletteSize));
+            o.Set("paletteColors", Napi::Number::New(env, L.info.paletteColors));
+            o.Set("fileSize", Napi::Number::New(env, (double)L.info.fileSize));
+            o.Set("truncated", Napi::Boolean::New(env, L.info.truncated));
+        }
+        layers.Set(LAYER_NAMES[li], o);
+    }
+
+    Napi::Object out = Napi::Object::New(env);
+    out.Set("ok", Napi::Boolean::New(env, probe.ok()));
+    out.Set("width", Napi::Number::New(env, probe.width));
+    out.Set("height", Napi::Number::New(env, probe.height));
+    out.Set("layers", layers);
+    out.Set("mismatches", toArray(probe.mismatches));
+    out.Set("errors", toArray(probe.errors));
+    return out;
+}
+
+// 图层参数: "sema" / "shaxian" / "luola" / "dumu" 或 0-3, 无效时返回 -1
+static int LayerArg(const Napi::Value& v) {
+    if (v.IsNumber()) {
+        int i = v.As<Napi::Number>().Int32Value();
+        return (i >= 0 && i < LAYER_COUNT) ? i : -1;
+    }
+    if (v.IsString()) {
+        std::string name = v.As<Napi::String>().Utf8Value();
+        for (int li = 0; li < LAYER_COUNT; ++li) if (name == LAYER_NAMES[li]) return li;
+    }
+    return -1;
+}
+
+// 解析 "#RRGGBB"
+static bool ParseHexColor(const std::string& s, LayerColor& out) {
+    auto digit = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    };
+    if (s.size() != 7 || s[0] != '#') return false;
+    uint8_t v[3];
+    for (int i = 0; i < 3; ++i) {
+        int hi = digit(s[1 + 2 * i]), lo = digit(s[2 + 2 * i]);
+        if (hi < 0 || lo < 0) return false;
+        v[i] = (uint8_t)(hi * 16 + lo);
+    }
+    out.r = v[0];
+    out.g = v[1];
+    out.b = v[2];
+    return true;
+}
+
+// DesignSession: 常驻内存的设计会话, 供交互式编辑器反复修改像素并重新生成指令
+//   new DesignSession(config_path, { sema, shaxian, luola, dumu } | input_dir)
+//   session.width / session.height
+//   session.getPalette(layer) -> ["#RRGGBB", ...]
+//   session.addColor(layer, "#RRGGBB") -> 调色板索引
+//   session.setPixels(layer, { x, y, width, height }, Uint8Array)   调色板索引, 行主序, 坐标 0 起始
+//   session.regenerate() -> Promise<{ recombined, rows, regeneratedRows, segments, reusedSegments, ms }>
+//   session.getProgram() -> { simple: Buffer, compressed: Buffer } | null
+//   session.getLayer(layer) -> { width, height, indices, palette, shared } | null
+//     indices 为调用时的副本 (shared 恒为 false), 修改它不影响会话; 修改像素请使用 setPixels
+// regenerate() 在工作线程上执行, 完成前不能再次调用 regenerate/setPixels/addColor
+class DesignSessionWrap : public Napi::ObjectWrap<DesignSessionWrap> {
+public:
+    static Napi::Function Define(Napi::Env env) {
+        return DefineClass(env, "DesignSession", {
+            InstanceAccessor("width", &DesignSessionWrap::Width, nullptr),
+            InstanceAccessor("height", &DesignSessionWrap::Height, nullptr),
+            InstanceMethod("getPalette", &DesignSessionWrap::GetPalette),
+            InstanceMethod("addColor", &DesignSessionWrap::AddColor),
+            InstanceMethod("setPixels", &DesignSessionWrap::SetPixels),
+            InstanceMethod("regenerate", &DesignSessionWrap::Regenerate),
+            InstanceMethod("getProgram", &DesignSessionWrap::GetProgram),
+            InstanceMethod("getLayer", &DesignSessionWrap::GetLayer),
+        });
+    }
+
+    DesignSessionWrap(const Napi::CallbackInfo& info) : Napi::ObjectWrap<DesignSessionWrap>(info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 2 || !info[0].IsString() || !(info[1].IsString() || info[1].IsObject())) {
+            Napi::TypeError::New(env, "Wrong arguments: expected (config_path, { sema, shaxian, luola, dumu } | input_dir)").ThrowAsJavaScriptException();
+            return;
+        }
+
+        LogChannelScope logScope(EnvLogChannel(env));
+        std::string config_path = info[0].As<Napi::String>().Utf8Value();
+        auto cfg = std::make_shared<YimaConfig>();
+        if (!LoadYimaConfig(CreatePathFromUtf8(config_path), *cfg)) {
+            Napi::Error::New(env, "Failed to load configuration from " + config_path).ThrowAsJavaScriptException();
+            return;
+        }
+
+        int rc = 0;
+        if (info[1].IsString()) {
+            rc = session_.OpenDir(cfg, info[1].As<Napi::String>().Utf8Value());
+        } else {
+            Napi::Object layers = info[1].As<Napi::Object>();
+            bool isArray = info[1].IsArray();
+            BmpBuffer buffers[LAYER_COUNT];
+            for (int li = 0; li < LAYER_COUNT; ++li) {
+                Napi::Value v = isArray ? layers.Get((uint32_t)li) : layers.Get(LAYER_NAMES[li]);
+                if (v.IsUndefined() || v.IsNull()) continue;
+                if (!GetBmpBytes(v, buffers[li])) {
+                    Napi::TypeError::New(env, std::string("Layer '") + LAYER_NAMES[li] + "' must be a Buffer, TypedArray or ArrayBuffer").ThrowAsJavaScriptException();
+                    return;
+                }
+            }
+            // 解码在构造函数内同步完成, 之后不再引用 JS 内存
+            rc = session_.Open(cfg, buffers);
+        }
+        if (rc != 0) {
+            Napi::Error err = Napi::Error::New(env, "Failed to open design session (code " + std::to_string(rc) + ")");
+            err.Set("code", Napi::Number::New(env, rc));
+            err.ThrowAsJavaScriptException();
+        }
+    }
+
+private:
+    friend class RegenerateWorker;
+
+    bool CheckIdle(Napi::Env env) {
+        if (!busy_) return true;
+        Napi::Error::New(env, "regenerate() is still running").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    Napi::Value Width(const Napi::CallbackInfo& info) { return Napi::Number::New(info.Env(), session_.width()); }
+    Napi::Value Height(const Napi::CallbackInfo& info) { return Napi::Number::New(info.Env(), session_.height()); }
+
+    Napi::Value GetPalette(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        int layer = info.Length() > 0 ? LayerArg(info[0]) : -1;
+        if (layer < 0) {
+            Napi::TypeError::New(env, "Wrong arguments: expected (layer)").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        if (!session_.HasLayer(layer)) return env.Null();
+        const std::vector<LayerColor>& palette = session_.Layer(layer).palette;
+        Napi::Array out = Napi::Array::New(env, palette.size());
+        for (size_t i = 0; i < palette.size(); ++i) out.Set((uint32_t)i, Napi::String::New(env, LayerColorHex(palette[i])));
+        return out;
+    }
+
+    Napi::Value AddColor(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        int layer = info.Length() > 1 ? LayerArg(info[0]) : -1;
+        LayerColor color;
+        if (layer < 0 || !info[1].IsString() || !ParseHexColor(info[1].As<Napi::String>().Utf8Value(), color)) {
+            Napi::TypeError::New(env, "Wrong arguments: expected (layer, \"#RRGGBB\")").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        if (!CheckIdle(env)) return env.Undefined();
+        if (!session_.HasLayer(layer)) {
+            Napi::Error::New(env, "Layer is not present in this design").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        int index = session_.AddColor(layer, color);
+        if (index < 0) {
+            Napi::RangeError::New(env, "Palette already has 256 colors").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        return Napi::Number::New(env, index);
+    }
+
+    Napi::Value SetPixels(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        int layer = info.Length() > 2 ? LayerArg(info[0]) : -1;
+        BmpBuffer data;
+        if (layer < 0 || !info[1].IsObject() || !GetBmpBytes(info[2], data)) {
+            Napi::TypeError::New(env, "Wrong arguments: expected (layer, { x, y, width, height }, Uint8Array)").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        if (!CheckIdle(env)) return env.Undefined();
+
+        Napi::Object rect = info[1].As<Napi::Object>();
+        auto field = [&](const char* name) {
+            Napi::Value v = rect.Get(name);
+            return v.IsNumber() ? v.As<Napi::Number>().Int32Value() : -1;
+        };
+        int rc = session_.SetPixels(layer, field("x"), field("y"), field("width"), field("height"), data.data, data.size);
+        if (rc != 0) {
+            static const char* const messages[] = { "", "Layer is not present in this design", "Rect is outside the design",
+                                                    "Data length does not match rect size", "Palette index out of range" };
+            Napi::RangeError::New(env, messages[-rc]).ThrowAsJavaScriptException();
+        }
+        return env.Undefined();
+    }
+
+    Napi::Value Regenerate(const Napi::CallbackInfo& info);
+
+    // 返回副本: 会话之后的增量生成会引用上一次的指令文本, 不能交给 JS 修改
+    Napi::Value GetProgram(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        std::shared_ptr<const std::string> simple, compressed;
+        session_.Program(simple, compressed);
+        if (!simple) return env.Null();
+        Napi::Object out = Napi::Object::New(env);
+        out.Set("simple", Napi::Buffer<char>::Copy(env, simple->data(), simple->size()));
+        out.Set("compressed", Napi::Buffer<char>::Copy(env, compressed->data(), compressed->size()));
+        return out;
+    }
+
+    // 返回副本: 直接写入会话的像素平面会绕过 setPixels 的脏行记录, 之后的 regenerate 结果与图层不一致
+    Napi::Value GetLayer(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        int layer = info.Length() > 0 ? LayerArg(info[0]) : -1;
+        if (layer < 0) {
+            Napi::TypeError::New(env, "Wrong arguments: expected (layer)").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        if (!session_.HasLayer(layer)) return env.Null();
+        const LayerGrid& grid = session_.Layer(layer);
+        Napi::Buffer<uint8_t> indices = Napi::Buffer<uint8_t>::Copy(env, grid.indices.data(), grid.indices.size());
+        return LayerPreviewObject(env, grid, indices, false);
+    }
+
+    DesignSession session_;
+    bool busy_ = false;
+};
+
+// session.regenerate() 的后台任务; 持有会话对象的引用, 避免任务期间被回收
+class RegenerateWorker : public Napi::AsyncWorker {
+public:
+    RegenerateWorker(Napi::Env env, DesignSessionWrap* owner, const Napi::Object& self)
+        : Napi::AsyncWorker(env), deferred_(Napi::Promise::Deferred::New(env)), owner_(owner),
+          self_(Napi::Persistent(self)), logChannel_(EnvLogChannel(env)) {}
+
+    Napi::Promise Promise() { return deferred_.Promise(); }
+
+    void Execute() override {
+        LogChannelScope logScope(logChannel_);
+        result_ = owner_->session_.Regenerate(stats_);
+        if (result_ != 0) SetError("regenerate failed with code " + std::to_string(result_));
+    }
+
+    void OnOK() override {
+        owner_->busy_ = false;
+        Napi::Env env = Env();
+        Napi::Object out = Napi::Object::New(env);
+        out.Set("recombined", Napi::Boolean::New(env, stats_.recombined));
+        out.Set("rows", Napi::Number::New(env, stats_.rows));
+        out.Set("regeneratedRows", Napi::Number::New(env, stats_.regeneratedRows));
+        out.Set("segments", Napi::Number::New(env, (double)stats_.segments));
+        out.Set("reusedSegments", Napi::Number::New(env, (double)stats_.reusedSegments));
+        out.Set("ms", Napi::Number::New(env, stats_.ms));
+        deferred_.Resolve(out);
+    }
+
+    void OnError(const Napi::Error& e) override {
+        owner_->busy_ = false;
+        e.Value().Set("code", Napi::Number::New(Env(), result_));
+        deferred_.Reject(e.Value());
+    }
+
+private:
+    Napi::Promise::Deferred deferred_;
+    DesignSessionWrap* owner_;
+    Napi::ObjectReference self_;
+    uint64_t logChannel_;
+    SessionStats stats_;
+    int result_ = 0;
+};
+
+Napi::Value DesignSessionWrap::Regenerate(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!CheckIdle(env)) return env.Undefined();
+    busy_ = true;
+    RegenerateWorker* worker = new RegenerateWorker(env, this, info.This().As<Napi::Object>());
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+// 日志回调的输出端: 后台日志线程经 ThreadSafeFunction 把每批记录交给 JS, 最后一个引用释放时关闭
+struct JsLogSink {
+    Napi::ThreadSafeFunction tsfn;
+    ~JsLogSink() { tsfn.Release(); }
+};
+
+static Napi::Object LogRecordObject(Napi::Env env, const LogRecord& r) {
+    Napi::Object o = Napi::Object::New(env);
+    o.Set("level", Napi::String::New(env, LogLevelName(r.level)));
+    o.Set("tag", Napi::String::New(env, r.tag));
+    o.Set("message", Napi::String::New(env, r.message));
+    o.Set("time", Napi::Number::New(env, r.timeMs));
+    return o;
+}
+
+// setLogOptions({ level, callback }) -> undefined
+// level: "debug" / "info" / "warn" (默认) / "error" / "off"
+// callback: (record: { level, tag, message, time }) => void 接收日志代替控制台输出, 在本环境的 JS 线程上异步调用,
+//           回调抛出的异常被忽略; null 移除回调, 恢复控制台输出。
+// 级别与回调只作用于本环境: 首次调用时为本环境创建日志通道, 之后本环境发起的调用 (包括其后台线程与批处理线程)
+// 产生的日志只按本环境的级别过滤并交给本环境的回调; 其他 worker_threads 的设置互不影响
+Napi::Value SetLogOptionsWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Wrong arguments: expected ({ level, callback })").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::Object opts = info[0].As<Napi::Object>();
+    Napi::Value level = opts.Get("level");
+    Napi::Value callback = opts.Get("callback");
+    YimaAddonData* data = env.GetInstanceData<YimaAddonData>();
+    LogLevel parsed = GetLogChannelLevel(data->logChannel);
+    if (!level.IsUndefined() && !(level.IsString() && ParseLogLevel(level.As<Napi::String>().Utf8Value(), parsed))) {
+        Napi::TypeError::New(env, "level must be \"debug\", \"info\", \"warn\", \"error\" or \"off\"").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!callback.IsUndefined() && !callback.IsNull() && !callback.IsFunction()) {
+        Napi::TypeError::New(env, "callback must be a function or null").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!data->logChannel) {
+        data->logChannel = CreateLogChannel(parsed);
+        data->logHook = env.AddCleanupHook(&YimaAddonData::DestroyLogChannelHook, data);
+    }
+    SetLogChannelLevel(data->logChannel, parsed);
+    if (callback.IsUndefined()) return env.Undefined();
+    if (callback.IsNull()) {
+        SetLogChannelSink(data->logChannel, nullptr);
+        return env.Undefined();
+    }
+
+    auto sink = std::make_shared<JsLogSink>();
+    sink->tsfn = Napi::ThreadSafeFunction::New(env, callback.As<Napi::Function>(), "yimaLog", 0, 1);
+    sink->tsfn.Unref(env);   // 日志回调不阻止进程退出
+    SetLogChannelSink(data->logChannel, [sink](std::vector<LogRecord>&& batch) {
+        auto* records = new std::vector<LogRecord>(std::move(batch));
+        napi_status status = sink->tsfn.BlockingCall(records, [](Napi::Env env, Napi::Function fn, std::vector<LogRecord>* r) {
+            for (const LogRecord& record : *r) {
+                try {
+                    fn.Call({ LogRecordObject(env, record) });
+                } catch (const Napi::Error&) {
+                }
+            }
+            delete r;
+        });
+        if (status != napi_ok) delete records;
+    });
+    // 清理钩子按注册的逆序执行: 重新注册, 使通道在新回调的 ThreadSafeFunction 被清理之前删除
+    data->logHook.Remove(env);
+    data->logHook = env.AddCleanupHook(&YimaAddonData::DestroyLogChannelHook, data);
+    return env.Undefined();
+}
+
+// 插件是 context-aware 的: Init 在每个加载它的环境中各执行一次, 可同时用于多个 worker_threads。
+// 插件状态按环境 (日志通道, 见 setLogOptions) 或按调用保存, 不修改进程级的日志设置;
+// 不同环境可以并发处理不同的输出目录,
+// 同一输出目录同时只允许一个流水线写入 (其余返回 -103, 见 yima_pipeline.h)
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
+    YimaAddonData* data = new YimaAddonData();
+    env.SetInstanceData(data);
     exports.Set(Napi::String::New(env, "processBmpTranslation"), Napi::Function::New(env, ProcessWrapped));
+    exports.Set(Napi::String::New(env, "translateBuffers"), Napi::Function::New(env, TranslateBuffersWrapped));
+    exports.Set(Napi::String::New(env, "probeDesign"), Napi::Function::New(env, ProbeDesignWrapped));
+    exports.Set(Napi::String::New(env, "decodeLayers"), Napi::Function::New(env, DecodeLayersWrapped));
+    exports.Set(Napi::String::New(env, "processBatch"), Napi::Function::New(env, ProcessBatchWrapped));
+    exports.Set(Napi::String::New(env, "DesignSession"), DesignSessionWrap::Define(env));
+    ProgramStreamWrap::Define(env, *data);
+    exports.Set(Napi::String::New(env, "streamProgram"), Napi::Function::New(env, StreamProgramWrapped));
+    exports.Set(Napi::String::New(env, "setLogOptions"), Napi::Function::New(env, SetLogOptionsWrapped));
     return exports;
 }
 
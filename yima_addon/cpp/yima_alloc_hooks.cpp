@@ -0,0 +1,54 @@
+// 替换全局 operator new / delete 以统计堆分配 (见 yima_alloc_stats.h)
+// 只在 yima_alloc_stats=1 时编译进 yima_cli / yima_bench, 不能链接进动态加载的模块
+#include "yima_alloc_stats.h"
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// 每块内存前放一个头部记录大小, 保持 max_align_t 对齐
+constexpr size_t ALLOC_HEADER = alignof(std::max_align_t) > sizeof(size_t) ? alignof(std::max_align_t) : sizeof(size_t);
+
+void* CountedAlloc(size_t size) noexcept {
+    void* p = std::malloc(size + ALLOC_HEADER);
+    if (!p) return nullptr;
+    *static_cast<size_t*>(p) = size;
+    AllocStatsRecordAlloc(size);
+    return static_cast<char*>(p) + ALLOC_HEADER;
+}
+
+void* CountedNew(size_t size) {
+    for (;;) {
+        if (void* p = CountedAlloc(size)) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void CountedFree(void* ptr) noexcept {
+    if (!ptr) return;
+    void* p = static_cast<char*>(ptr) - ALLOC_HEADER;
+    AllocStatsRecordFree(*static_cast<size_t*>(p));
+    std::free(p);
+}
+
+// 静态初始化时登记, AllocStatsEnabled() 随之为 true
+struct HookInstaller {
+    HookInstaller() { AllocStatsInstall(); }
+} g_installer;
+
+} // namespace
+
+// 对齐版本 (align_val_t) 不替换, 使用标准库实现且不计入统计
+void* operator new(size_t size) { return CountedNew(size); }
+void* operator new[](size_t size) { return CountedNew(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t) noexcept { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
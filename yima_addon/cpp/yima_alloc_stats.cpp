@@ -0,0 +1,64 @@
+#include "yima_alloc_stats.h"
+#include <algorithm>
+
+namespace {
+
+// 常量初始化的 thread_local, 在 operator new 中访问不会触发动态初始化
+struct ThreadCounters {
+    int64_t allocations;
+    int64_t frees;
+    uint64_t bytes;
+    int64_t live;     // 本线程申请减去本线程释放; 跨线程释放时可能为负
+    int64_t peak;
+};
+
+thread_local ThreadCounters t_counters = { 0, 0, 0, 0, 0 };
+
+// 由 yima_alloc_hooks.cpp 的静态初始化设置, 之后只读
+bool g_installed = false;
+
+} // namespace
+
+bool AllocStatsEnabled() { return g_installed; }
+
+void AllocStatsInstall() { g_installed = true; }
+
+void AllocStatsRecordAlloc(size_t size) {
+    ThreadCounters& c = t_counters;
+    ++c.allocations;
+    c.bytes += size;
+    c.live += (int64_t)size;
+    if (c.live > c.peak) c.peak = c.live;
+}
+
+void AllocStatsRecordFree(size_t size) {
+    ThreadCounters& c = t_counters;
+    ++c.frees;
+    c.live -= (int64_t)size;
+}
+
+AllocScope::AllocScope() {
+    ThreadCounters& c = t_counters;
+    allocations0_ = c.allocations;
+    frees0_ = c.frees;
+    bytes0_ = c.bytes;
+    live0_ = c.live;
+    outerPeak_ = c.peak;
+    c.peak = c.live;
+}
+
+AllocScope::~AllocScope() {
+    Finish();
+}
+
+AllocStats AllocScope::Finish() {
+    if (done_) return result_;
+    done_ = true;
+    ThreadCounters& c = t_counters;
+    result_.allocations = c.allocations - allocations0_;
+    result_.frees = c.frees - frees0_;
+    result_.bytes = c.bytes - bytes0_;
+    result_.peakLiveBytes = (uint64_t)std::max<int64_t>(c.peak - live0_, 0);
+    c.peak = std::max(outerPeak_, c.peak);
+    return result_;
+}
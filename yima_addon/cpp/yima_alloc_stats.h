@@ -0,0 +1,54 @@
+#ifndef YIMA_ALLOC_STATS_H
+#define YIMA_ALLOC_STATS_H
+
+/*
+ * 堆分配统计 (只在以 yima_alloc_stats=1 构建的 yima_cli / yima_bench 中启用: node-gyp rebuild -- -Dyima_alloc_stats=1)
+ *
+ * yima_alloc_hooks.cpp 替换全局 operator new / delete, 按线程累计分配次数, 字节数与当前存活字节数;
+ * AllocScope 取一段代码前后的差值作为该段的统计, 由 StageScope 写入运行报告的各阶段。
+ * 流水线的每个阶段都在调用线程上完成, 因此按线程计数即为按阶段计数。
+ * 替换只对直接链接它的可执行文件有效: 动态加载的模块 (yima_addon.node) 中的 operator new 要么被
+ * 全局作用域中的 libstdc++ 覆盖 (统计恒为 0), 要么与 libstdc++ 内部的分配混用 (释放时崩溃),
+ * 因此 yima_core 与插件中不包含替换, 统计值恒为 0 且 AllocStatsEnabled() 为 false。
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+struct AllocStats {
+    int64_t allocations = 0;      // operator new 调用次数
+    int64_t frees = 0;            // operator delete 调用次数
+    uint64_t bytes = 0;           // 申请的总字节数
+    uint64_t peakLiveBytes = 0;   // 作用域内存活堆内存相对开始时的峰值增量
+};
+
+// 当前可执行文件是否链接了 yima_alloc_hooks.cpp
+bool AllocStatsEnabled();
+
+// 以下由 yima_alloc_hooks.cpp 调用
+void AllocStatsInstall();
+void AllocStatsRecordAlloc(size_t size);
+void AllocStatsRecordFree(size_t size);
+
+// 统计当前线程在作用域内的分配; 可以嵌套, 内层不影响外层的峰值
+class AllocScope {
+public:
+    AllocScope();
+    ~AllocScope();
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+    // 结束统计并返回结果, 重复调用返回第一次的结果
+    AllocStats Finish();
+
+private:
+    int64_t allocations0_;
+    int64_t frees0_;
+    uint64_t bytes0_;
+    int64_t live0_;
+    int64_t outerPeak_;
+    bool done_ = false;
+    AllocStats result_;
+};
+
+#endif // YIMA_ALLOC_STATS_H
@@ -0,0 +1,536 @@
+/*
+ * yima_bench: 流水线各阶段与端到端的基准测试, 结果以 JSON 输出, 便于比较不同构建
+ *
+ *   yima_bench --config <dir> --input <design_dir> [options]
+ *   yima_bench --config <dir> --pattern <name> [options]
+ *
+ * 每个尺寸的输入由 input 中的四个图层平铺到目标宽高得到, 或按 pattern 由合成设计生成器生成
+ * (见 design_generator.h), 写入 work 目录后依次运行:
+ *   decode      内存中解码四个 BMP                       (字节: BMP 输入)
+ *   combine     .ylayer -> combined.ycomb                 (字节: combined.ycomb)
+ *   data_csv    combined.ycomb -> pixel_data.csv          (字节: pixel_data.csv)
+ *   cmd_csv     combined.ycomb -> pixel_cmd.csv           (字节: pixel_cmd.csv)
+ *   txt         pixel_cmd.csv -> cmd_raw.txt / cmd_simple.txt
+ *   compress    cmd_simple.txt -> cmd_compressed.txt 内容 (内存中)
+ *   pipeline    ProcessBmpTranslation 全量运行             (字节: 输出目录全部文件)
+ *   memory      TranslateBmpBuffers 纯内存流水线           (字节: simple + compressed)
+ * 每个用例重复 repeat 次, 记录最小值与中位数 (ns), 以及按最小值计算的 ns/像素 与 字节/像素。
+ * 另外记录每次运行前固定校准负载耗时的最小值 (与基线比较时用于换算机器速度), 运行期间的峰值 RSS
+ * (Linux 上每次运行前重置 VmHWM, 其他平台为进程累计峰值), 以及峰值堆内存 (仅 yima_alloc_stats=1 构建)。
+ *
+ * 回归门限 (见 bench_gate.h):
+ *   --baseline <file>          运行后与基线比较, 打印对比表, 有回归时返回 1
+ *   --baseline <file> --update-baseline   以本次结果重写基线 (保留阈值设置)
+ * 基线记录生成它的构建 (BuildId), 与当前构建不同时 (Debug 构建, 其他 yima_profile, yima_alloc_stats=1)
+ * 只打印提示, 不比较。
+ */
+
+#include "yima_pipeline.h"
+#include "bench_gate.h"
+#include "content_hash.h"
+#include "design_generator.h"
+#include "encoding_utils.h"
+#include "mapped_file.h"
+#include "run_report.h"
+#include "yima_alloc_stats.h"
+#include "yima_log.h"
+#include "1.bmp_extract/bmp_extract.h"
+#include "2.toml_handle/toml_handle.h"
+#include "3.data_csv_handle/data_csv_handle.h"
+#include "4.cmd_csv_handle/cmd_csv_handle.h"
+#include "5.txt_generator/txt_generator.h"
+#include "6.txt_handle/txt_handle.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+#ifndef YIMA_BUILD_PROFILE
+#define YIMA_BUILD_PROFILE "default"
+#endif
+
+// 当前构建的标识, 格式见 bench_gate.h
+std::string BuildId() {
+#if defined(DEBUG) || defined(_DEBUG)
+    std::string id = "debug ";
+#else
+    std::string id = "release ";
+#endif
+    id += YIMA_BUILD_PROFILE;
+    if (AllocStatsEnabled()) id += " alloc_stats";
+    return id;
+}
+
+struct BenchSize {
+    int width = 0;
+    int height = 0;
+};
+
+struct BenchOptions {
+    std::string config;
+    std::string input;
+    std::string pattern;              // 非空时使用合成设计, 不读取 input
+    DesignSpec spec;
+    std::string work;
+    std::string out;
+    std::vector<BenchSize> sizes;
+    std::vector<std::string> cases;   // 为空时运行全部
+    int repeat = 3;
+    std::string baseline;             // 非空时与基线比较
+    bool updateBaseline = false;
+};
+
+struct BenchResult {
+    std::string name;
+    BenchSize size;
+    int code = 0;
+    std::vector<double> ns;
+    uint64_t bytes = 0;
+    double calibrationNs = 0;
+    uint64_t peakRssBytes = 0;
+    uint64_t peakHeapBytes = 0;
+};
+
+void PrintUsage() {
+    std::fprintf(stderr,
+        "usage: yima_bench --config <dir> --input <design_dir> [options]\n"
+        "       yima_bench --config <dir> --pattern <name> [options]\n"
+        "\n"
+        "options:\n"
+        "  --pattern <name>    synthetic design: random | striped | tiled | sparse | yarn\n"
+        "  --seed <n>          seed for --pattern (default: 1)\n"
+        "  --shaxian-types <n> distinct shaxian colours for --pattern (default: 2)\n"
+        "  --sizes <WxH,...>   design sizes (default: 100x500,1000x5000)\n"
+        "  --case <name,...>   decode, combine, data_csv, cmd_csv, txt, compress, pipeline, memory\n"
+        "  --repeat <n>        runs per case (default: 3)\n"
+        "  --work <dir>        scratch directory (default: <temp>/yima_bench)\n"
+        "  --out <file>        write JSON to file instead of stdout\n"
+        "  --baseline <file>   compare with a stored baseline, exit 1 on regression\n"
+        "  --update-baseline   rewrite --baseline from this run (keeps tolerances)\n");
+}
+
+std::vector<std::string> SplitList(const std::string& s) {
+    std::vector<std::string> out;
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos) end = s.size();
+        if (end > pos) out.push_back(s.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return out;
+}
+
+bool ParseArgs(const std::vector<std::string>& args, BenchOptions& opts) {
+    std::string sizes = "100x500,1000x5000";
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& a = args[i];
+        if (a == "--update-baseline") {
+            opts.updateBaseline = true;
+            continue;
+        }
+        if (i + 1 >= args.size()) {
+            std::fprintf(stderr, "yima_bench: %s needs a value\n", a.c_str());
+            return false;
+        }
+        const std::string& v = args[++i];
+        if (a == "--config") opts.config = v;
+        else if (a == "--input") opts.input = v;
+        else if (a == "--pattern") opts.pattern = v;
+        else if (a == "--seed") opts.spec.seed = std::strtoull(v.c_str(), nullptr, 10);
+        else if (a == "--shaxian-types") opts.spec.shaxianTypes = std::atoi(v.c_str());
+        else if (a == "--work") opts.work = v;
+        else if (a == "--out") opts.out = v;
+        else if (a == "--baseline") opts.baseline = v;
+        else if (a == "--sizes") sizes = v;
+        else if (a == "--case") opts.cases = SplitList(v);
+        else if (a == "--repeat") opts.repeat = std::max(1, std::atoi(v.c_str()));
+        else {
+            std::fprintf(stderr, "yima_bench: unknown option: %s\n", a.c_str());
+            return false;
+        }
+    }
+    for (const std::string& s : SplitList(sizes)) {
+        BenchSize size;
+        if (std::sscanf(s.c_str(), "%dx%d", &size.width, &size.height) != 2 || size.width <= 0 || size.height <= 0) {
+            std::fprintf(stderr, "yima_bench: invalid size: %s\n", s.c_str());
+            return false;
+        }
+        opts.sizes.push_back(size);
+    }
+    if (!opts.pattern.empty() && !ParseDesignPattern(opts.pattern, opts.spec.pattern)) {
+        std::fprintf(stderr, "yima_bench: unknown pattern: %s\n", opts.pattern.c_str());
+        return false;
+    }
+    if (opts.updateBaseline && opts.baseline.empty()) {
+        std::fprintf(stderr, "yima_bench: --update-baseline needs --baseline\n");
+        return false;
+    }
+    if (opts.work.empty()) opts.work = PathToUtf8String(fs::temp_directory_path() / "yima_bench");
+    return !opts.config.empty() && (!opts.input.empty() || !opts.pattern.empty()) && !opts.sizes.empty();
+}
+
+// 把图层平铺到 width x height
+LayerGrid TileLayer(const LayerGrid& src, int width, int height) {
+    LayerGrid out;
+    out.width = width;
+    out.height = height;
+    out.palette = src.palette;
+    out.indices.resize((size_t)width * height);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = src.indices.data() + (size_t)src.width * (y % src.height);
+        uint8_t* dst = out.indices.data() + (size_t)width * y;
+        for (int x = 0; x < width; ++x) dst[x] = row[x % src.width];
+    }
+    return out;
+}
+
+bool WriteBytes(const fs::path& p, const std::vector<uint8_t>& data) {
+    std::ofstream out(p, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+    return out.good();
+}
+
+uint64_t FileSize(const fs::path& p) {
+    std::error_code ec;
+    uintmax_t n = fs::file_size(p, ec);
+    return ec ? 0 : (uint64_t)n;
+}
+
+uint64_t DirectorySize(const fs::path& dir) {
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto& e : fs::recursive_directory_iterator(dir, ec)) {
+        if (e.is_regular_file()) total += FileSize(e.path());
+    }
+    return total;
+}
+
+std::string ReadText(const fs::path& p) {
+    MappedFile f(p);
+    return f.IsOpen() ? std::string(reinterpret_cast<const char*>(f.data()), f.size()) : std::string();
+}
+
+#ifdef __linux__
+// 重置进程的峰值 RSS (VmHWM), 使每个用例单独计量
+void ResetPeakRss() {
+    std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+uint64_t CasePeakRssBytes() {
+    std::ifstream in("/proc/self/status");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+    }
+    return PeakRssBytes();
+}
+#else
+void ResetPeakRss() {}
+
+uint64_t CasePeakRssBytes() {
+    return PeakRssBytes();   // 无法重置, 为进程累计峰值
+}
+#endif
+
+// 固定的校准负载 (生成 + 排序 + 格式化 + 哈希) 运行一次的耗时; 与基线中记录的值相比,
+// 即得到当前机器 (及当前负载下) 相对生成基线时的速度
+double CalibrationNs() {
+    Clock::time_point t0 = Clock::now();
+    std::vector<uint64_t> v(1 << 16);
+    uint64_t x = 1;
+    for (uint64_t& e : v) e = (x = x * 6364136223846793005ull + 1442695040888963407ull) >> 20;
+    std::sort(v.begin(), v.end());
+    std::string text;
+    for (uint64_t e : v) {
+        text += std::to_string(e);
+        text += ',';
+    }
+    volatile uint64_t sink = HashString(text);
+    (void)sink;
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+}
+
+// 运行一个用例 repeat 次 (每次之前运行一次校准负载); body 返回非 0 时停止并记录返回值
+BenchResult Measure(const char* name, BenchSize size, int repeat, const std::function<int()>& body) {
+    BenchResult r;
+    r.name = name;
+    r.size = size;
+    for (int i = 0; i < repeat; ++i) {
+        double calibration = CalibrationNs();
+        r.calibrationNs = i ? std::min(r.calibrationNs, calibration) : calibration;
+        ResetPeakRss();
+        AllocScope alloc;
+        Clock::time_point t0 = Clock::now();
+        r.code = body();
+        r.ns.push_back((double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count());
+        r.peakRssBytes = std::max(r.peakRssBytes, CasePeakRssBytes());
+        r.peakHeapBytes = std::max(r.peakHeapBytes, alloc.Finish().peakLiveBytes);
+        if (r.code != 0) break;
+    }
+    std::fprintf(stderr, "  %-9s %dx%d: %.3f ms%s\n", name, size.width, size.height,
+                 *std::min_element(r.ns.begin(), r.ns.end()) / 1e6, r.code ? " (failed)" : "");
+    return r;
+}
+
+bool Wanted(const BenchOptions& opts, const char* name) {
+    return opts.cases.empty() || std::find(opts.cases.begin(), opts.cases.end(), name) != opts.cases.end();
+}
+
+// 对一个尺寸运行全部用例; 返回 false 表示输入无法准备
+bool RunSize(const BenchOptions& opts, const YimaConfig& cfg, const LayerGrid src[LAYER_COUNT], BenchSize size,
+             std::vector<BenchResult>& results) {
+    char label[32];
+    std::snprintf(label, sizeof(label), "%dx%d", size.width, size.height);
+    fs::path root = CreatePathFromUtf8(opts.work) / label;
+    fs::path input = root / "input";
+    fs::path output = root / "output";
+    fs::create_directories(input);
+    fs::create_directories(output);
+
+    GeneratedDesign generated;
+    if (!opts.pattern.empty()) {
+        DesignSpec spec = opts.spec;
+        spec.width = size.width;
+        spec.height = size.height;
+        if (GenerateDesign(cfg, spec, generated) != 0) return false;
+    }
+    std::vector<uint8_t> bmp[LAYER_COUNT];
+    BmpBuffer buffers[LAYER_COUNT];
+    uint64_t bmpBytes = 0;
+    for (int i = 0; i < LAYER_COUNT; ++i) {
+        if (opts.pattern.empty()) {
+            if (src[i].width == 0) continue;
+            bmp[i] = EncodeBmpLayer(TileLayer(src[i], size.width, size.height));
+        } else {
+            if (generated.layers[i].width == 0) continue;
+            bmp[i] = EncodeBmpLayer(generated.layers[i]);
+        }
+        if (!WriteBytes(input / (std::string(LAYER_NAMES[i]) + ".bmp"), bmp[i])) return false;
+        buffers[i].data = bmp[i].data();
+        buffers[i].size = bmp[i].size();
+        bmpBytes += bmp[i].size();
+    }
+    std::fprintf(stderr, "%s\n", label);
+
+    // 先完整运行一次, 得到各阶段的输入文件
+    PipelineOptions full;
+    full.incremental = false;
+    const std::string inputStr = PathToUtf8String(input);
+    const std::string outputStr = PathToUtf8String(output);
+    if (ProcessBmpTranslation(cfg, inputStr, outputStr, full) != 0) return false;
+    const fs::path tomlDir = output / "toml";
+    const std::string tomlStr = PathToUtf8String(tomlDir);
+    const int repeat = opts.repeat;
+
+    if (Wanted(opts, "decode")) {
+        results.push_back(Measure("decode", size, repeat, [&] {
+            for (int i = 0; i < LAYER_COUNT; ++i) {
+                LayerGrid grid;
+                if (buffers[i].data && !DecodeBmpLayer(buffers[i].data, buffers[i].size, grid)) return -1;
+            }
+            return 0;
+        }));
+        results.back().bytes = bmpBytes;
+    }
+    if (Wanted(opts, "combine")) {
+        results.push_back(Measure("combine", size, repeat, [&] { return CombineLayerDir(tomlDir, cfg, false); }));
+        results.back().bytes = FileSize(tomlDir / "combined.ycomb");
+    }
+    if (Wanted(opts, "data_csv")) {
+        results.push_back(Measure("data_csv", size, repeat, [&] { return GenerateDataCsv(tomlStr.c_str(), outputStr.c_str()); }));
+        results.back().bytes = FileSize(output / "pixel_data.csv");
+    }
+    if (Wanted(opts, "cmd_csv")) {
+        results.push_back(Measure("cmd_csv", size, repeat, [&] { return WriteCmdCsv(tomlDir, output, cfg); }));
+        results.back().bytes = FileSize(output / "pixel_cmd.csv");
+    }
+    if (Wanted(opts, "txt")) {
+        results.push_back(Measure("txt", size, repeat, [&] { return WriteRawTxt(output, output, cfg); }));
+        results.back().bytes = FileSize(output / "cmd_raw.txt") + FileSize(output / "cmd_simple.txt");
+    }
+    if (Wanted(opts, "compress")) {
+        std::string simple = ReadText(output / "cmd_simple.txt");
+        std::string compressed;
+        results.push_back(Measure("compress", size, repeat, [&] {
+            compressed = CompressProgram(simple);
+            return 0;
+        }));
+        results.back().bytes = compressed.size();
+    }
+    if (Wanted(opts, "pipeline")) {
+        results.push_back(Measure("pipeline", size, repeat, [&] { return ProcessBmpTranslation(cfg, inputStr, outputStr, full); }));
+        results.back().bytes = DirectorySize(output);
+    }
+    if (Wanted(opts, "memory")) {
+        ProgramOutput program;
+        results.push_back(Measure("memory", size, repeat, [&] {
+            program = ProgramOutput();
+            return TranslateBmpBuffers(cfg, buffers, program);
+        }));
+        results.back().bytes = program.simple.size() + program.compressed.size();
+    }
+    return true;
+}
+
+std::vector<BenchCase> GateCases(const std::vector<BenchResult>& results) {
+    std::vector<BenchCase> cases;
+    for (const BenchResult& r : results) {
+        BenchCase c;
+        c.key = r.name + " " + std::to_string(r.size.width) + "x" + std::to_string(r.size.height);
+        c.nsPerPixel = *std::min_element(r.ns.begin(), r.ns.end()) / ((double)r.size.width * r.size.height);
+        c.calibrationNs = r.calibrationNs;
+        c.peakRssBytes = r.peakRssBytes;
+        c.peakHeapBytes = r.peakHeapBytes;
+        cases.push_back(std::move(c));
+    }
+    return cases;
+}
+
+// 与基线比较或重写基线, 返回回归项数 (重写基线失败返回 1)
+int RunGate(const BenchOptions& opts, const std::vector<BenchResult>& results) {
+    const fs::path path = CreatePathFromUtf8(opts.baseline);
+    BenchBaseline baseline;
+    std::string error;
+    const bool loaded = LoadBenchBaseline(path, baseline, error);
+    if (opts.updateBaseline) {
+        BenchBaseline updated = MakeBenchBaseline(loaded ? baseline : BenchBaseline(), GateCases(results), BuildId());
+        if (!SaveBenchBaseline(path, updated)) {
+            std::fprintf(stderr, "yima_bench: cannot write %s\n", opts.baseline.c_str());
+            return 1;
+        }
+        std::fprintf(stderr, "yima_bench: updated %s (%zu cases)\n", opts.baseline.c_str(), results.size());
+        return 0;
+    }
+    if (!loaded) {
+        std::fprintf(stderr, "yima_bench: %s: %s\n", opts.baseline.c_str(), error.c_str());
+        return 1;
+    }
+    if (!baseline.build.empty() && baseline.build != BuildId()) {
+        std::fprintf(stderr, "yima_bench: %s was recorded with build \"%s\", this is \"%s\"; not comparing\n",
+                     opts.baseline.c_str(), baseline.build.c_str(), BuildId().c_str());
+        return 0;
+    }
+    std::string report;
+    int regressions = CompareBenchBaseline(baseline, GateCases(results), report);
+    std::fprintf(stderr, "\n%s", report.c_str());
+    return regressions;
+}
+
+std::string JsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+std::string ResultsJson(const BenchOptions& opts, const std::vector<BenchResult>& results) {
+    std::string out = "{\n  \"config\": " + JsonString(opts.config) + ",\n";
+    if (opts.pattern.empty()) {
+        out += "  \"input\": " + JsonString(opts.input) + ",\n";
+    } else {
+        out += "  \"pattern\": " + JsonString(opts.pattern) + ",\n  \"seed\": " + std::to_string(opts.spec.seed) +
+               ",\n  \"shaxianTypes\": " + std::to_string(opts.spec.shaxianTypes) + ",\n";
+    }
+    out += "  \"repeat\": " + std::to_string(opts.repeat) + ",\n";
+    out += std::string("  \"allocStats\": ") + (AllocStatsEnabled() ? "true" : "false") + ",\n";
+    out += "  \"build\": " + JsonString(BuildId()) + ",\n";
+    out += "  \"results\": [";
+    char buf[512];
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        std::vector<double> sorted = r.ns;
+        std::sort(sorted.begin(), sorted.end());
+        double pixels = (double)r.size.width * r.size.height;
+        std::snprintf(buf, sizeof(buf),
+                      "%s\n    {\"case\": \"%s\", \"width\": %d, \"height\": %d, \"pixels\": %.0f, \"code\": %d, "
+                      "\"runs\": %zu, \"ns_min\": %.0f, \"ns_median\": %.0f, \"ns_per_pixel\": %.3f, "
+                      "\"bytes\": %llu, \"bytes_per_pixel\": %.3f, \"calibration_ns\": %.0f, \"peak_rss_bytes\": %llu, "
+                      "\"peak_heap_bytes\": %llu}",
+                      i ? "," : "", r.name.c_str(), r.size.width, r.size.height, pixels, r.code, sorted.size(),
+                      sorted.front(), sorted[sorted.size() / 2], sorted.front() / pixels,
+                      (unsigned long long)r.bytes, (double)r.bytes / pixels, r.calibrationNs, (unsigned long long)r.peakRssBytes,
+                      (unsigned long long)r.peakHeapBytes);
+        out += buf;
+    }
+    out += "\n  ]\n}\n";
+    return out;
+}
+
+int Run(const std::vector<std::string>& args) {
+    BenchOptions opts;
+    if (!ParseArgs(args, opts)) {
+        PrintUsage();
+        return 2;
+    }
+    SetLogLevel(LogLevel::Error);
+
+    YimaConfig cfg;
+    if (!LoadYimaConfig(CreatePathFromUtf8(opts.config), cfg)) {
+        std::fprintf(stderr, "yima_bench: cannot load config %s\n", opts.config.c_str());
+        return 1;
+    }
+    LayerGrid src[LAYER_COUNT];
+    int found = opts.pattern.empty() ? 0 : LAYER_COUNT;
+    for (int i = 0; i < LAYER_COUNT && opts.pattern.empty(); ++i) {
+        fs::path p = CreatePathFromUtf8(opts.input) / (std::string(LAYER_NAMES[i]) + ".bmp");
+        if (!fs::exists(p)) continue;
+        if (!DecodeBmpLayerFile(p, src[i])) {
+            std::fprintf(stderr, "yima_bench: cannot decode %s\n", PathToUtf8String(p).c_str());
+            return 1;
+        }
+        ++found;
+    }
+    if (!found) {
+        std::fprintf(stderr, "yima_bench: no layer BMP in %s\n", opts.input.c_str());
+        return 1;
+    }
+
+    std::vector<BenchResult> results;
+    int failed = 0;
+    for (const BenchSize& size : opts.sizes) {
+        if (!RunSize(opts, cfg, src, size, results)) {
+            std::fprintf(stderr, "yima_bench: cannot prepare %dx%d\n", size.width, size.height);
+            ++failed;
+        }
+    }
+    for (const BenchResult& r : results) if (r.code != 0) ++failed;
+    FlushLog();
+
+    std::string json = ResultsJson(opts, results);
+    if (opts.out.empty()) {
+        std::fwrite(json.data(), 1, json.size(), stdout);
+    } else {
+        std::ofstream out(CreatePathFromUtf8(opts.out), std::ios::binary);
+        out.write(json.data(), (std::streamsize)json.size());
+    }
+    if (!failed && !opts.baseline.empty() && RunGate(opts, results) != 0) return 1;
+    return failed ? 1 : 0;
+}
+
+} // namespace
+
+#ifdef _WIN32
+int wmain(int argc, wchar_t** argv) {
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) args.push_back(WideToUtf8(argv[i]));
+    return Run(args);
+}
+#else
+int main(int argc, char** argv) {
+    return Run(std::vector<std::string>(argv + 1, argv + argc));
+}
+#endif
@@ -0,0 +1,453 @@
+/*
+ * yima_cli: 不经过 Electron / N-API 直接运行流水线, 供构建服务器批量处理与原生性能分析工具使用
+ *
+ *   yima_cli --config <dir> [options] <input_dir> <output_dir>
+ *   yima_cli --config <dir> [options] --batch <designs_dir> <output_root>
+ *   yima_cli generate --config <dir> [options] <output_dir>
+ *   yima_cli emulate [options] <program.txt>
+ *
+ * 批处理模式下 designs_dir 中每个含 .bmp 文件的子目录为一个设计, 输出到 output_root/<子目录名>。
+ * generate 按配置生成合成设计 (见 design_generator.h), 写出四个图层的 BMP。
+ * emulate 模拟执行 cmd_simple.txt 或 cmd_compressed.txt (见 program_emulator.h), 输出执行的指令数,
+ * 可选与展开前的程序逐行比较, 记录寄存器的写入, 或比较优化遍 (见 program_optimize.h) 前后执行的指令数。
+ * 返回值: 全部成功为 0, 有设计失败 (或模拟失败、比较不一致) 为 1, 参数错误为 2。
+ */
+
+#include "batch_runner.h"
+#include "design_generator.h"
+#include "encoding_utils.h"
+#include "mapped_file.h"
+#include "program_emulator.h"
+#include "program_optimize.h"
+#include "run_report.h"
+#include "yima_log.h"
+#include "yima_trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct CliOptions {
+    std::string config;
+    std::vector<std::string> positional;
+    bool batch = false;
+    int threads = 0;
+    bool exportToml = false;
+    bool incremental = true;
+    bool report = false;
+    bool optimize = false;
+    std::string tracePath;
+    std::string logLevel;
+};
+
+void PrintUsage() {
+    std::fprintf(stderr,
+        "usage: yima_cli --config <dir> [options] <input_dir> <output_dir>\n"
+        "       yima_cli --config <dir> [options] --batch <designs_dir> <output_root>\n"
+        "\n"
+        "options:\n"
+        "  -c, --config <dir>     configuration directory (required)\n"
+        "  -b, --batch            treat every subdirectory with .bmp files as a design\n"
+        "  -j, --threads <n>      worker threads for batch mode (default: hardware threads)\n"
+        "      --export-toml      also export per-layer and combined .toml files\n"
+        "      --full             ignore build_manifest.toml and rerun every stage\n"
+        "      --report           print per-stage timings for each design\n"
+        "      --optimize         fold register arithmetic and drop assignments that do not\n"
+        "                         change a register in cmd_simple.txt / cmd_compressed.txt\n"
+        "      --trace <file>     write a Chrome trace of the whole run\n"
+        "      --log-level <lvl>  debug | info | warn | error | off (default: warn)\n"
+        "\n"
+        "       yima_cli generate --config <dir> [options] <output_dir>\n"
+        "\n"
+        "options:\n"
+        "      --size <WxH>             design size (default: 100x500)\n"
+        "      --pattern <name>         random | striped | tiled | sparse | yarn (default: random)\n"
+        "      --seed <n>               random seed (default: 1)\n"
+        "      --shaxian-types <n|all>  distinct shaxian colours; \"all\" writes one design per\n"
+        "                               line_sign cycle into <output_dir>/<pattern>_s<n> (default: 2)\n"
+        "      --stripe <rows>          stripe height for striped / yarn (default: 8)\n"
+        "      --motif <px>             motif size for tiled (default: 16)\n"
+        "      --density <0-1>          coloured fraction for sparse (default: 0.05)\n"
+        "\n"
+        "       yima_cli emulate [options] <program.txt>\n"
+        "\n"
+        "options:\n"
+        "      --against <simple.txt>   expand the program and compare it with simple.txt line by line\n"
+        "      --trace <DATn,...>       print every write to these registers\n"
+        "      --trace-limit <n>        stop tracing after n writes (default: 1000, 0: no limit)\n"
+        "      --registers              print the final register values\n"
+        "      --optimize               also run the optimized program and compare the results\n");
+}
+
+// 解析命令行, 失败时返回 false
+bool ParseArgs(const std::vector<std::string>& args, CliOptions& opts) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& a = args[i];
+        auto value = [&](std::string& out) {
+            if (i + 1 >= args.size()) {
+                std::fprintf(stderr, "yima_cli: %s needs a value\n", a.c_str());
+                return false;
+            }
+            out = args[++i];
+            return true;
+        };
+        if (a == "-c" || a == "--config") {
+            if (!value(opts.config)) return false;
+        } else if (a == "-b" || a == "--batch") {
+            opts.batch = true;
+        } else if (a == "-j" || a == "--threads") {
+            std::string n;
+            if (!value(n)) return false;
+            opts.threads = std::atoi(n.c_str());
+            if (opts.threads <= 0) {
+                std::fprintf(stderr, "yima_cli: invalid thread count: %s\n", n.c_str());
+                return false;
+            }
+        } else if (a == "--export-toml") {
+            opts.exportToml = true;
+        } else if (a == "--full") {
+            opts.incremental = false;
+        } else if (a == "--report") {
+            opts.report = true;
+        } else if (a == "--optimize") {
+            opts.optimize = true;
+        } else if (a == "--trace") {
+            if (!value(opts.tracePath)) return false;
+        } else if (a == "--log-level") {
+            if (!value(opts.logLevel)) return false;
+        } else if (a == "-h" || a == "--help") {
+            return false;
+        } else if (a.size() > 1 && a[0] == '-') {
+            std::fprintf(stderr, "yima_cli: unknown option: %s\n", a.c_str());
+            return false;
+        } else {
+            opts.positional.push_back(a);
+        }
+    }
+    if (opts.config.empty() || opts.positional.size() != 2) return false;
+    return true;
+}
+
+// designs_dir 下含 .bmp 文件的子目录, 按名称排序
+std::vector<fs::path> FindDesigns(const fs::path& root) {
+    std::vector<fs::path> designs;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(root, ec)) {
+        if (!entry.is_directory()) continue;
+        std::error_code inner;
+        for (const auto& f : fs::directory_iterator(entry.path(), inner)) {
+            if (f.is_regular_file() && f.path().extension() == ".bmp") {
+                designs.push_back(entry.path());
+                break;
+            }
+        }
+    }
+    std::sort(designs.begin(), designs.end());
+    return designs;
+}
+
+void PrintReport(const std::string& name, const RunReport& report) {
+    std::printf("%s: code %d, %dx%d, %.1f ms wall, %.1f ms cpu\n",
+                name.c_str(), report.code, report.width, report.height, report.wallMs, report.cpuMs);
+    for (const StageMetrics& m : report.stages) {
+        std::printf("  %d %-9s %s %9.2f ms %9.2f ms cpu %12llu B in %12llu B out",
+                    m.step, m.name.c_str(), m.skipped ? "skip" : "run ", m.wallMs, m.cpuMs,
+                    (unsigned long long)m.inputBytes, (unsigned long long)m.outputBytes);
+        if (report.allocStats) {
+            std::printf(" %10lld allocs %12llu B peak heap",
+                        (long long)m.alloc.allocations, (unsigned long long)m.alloc.peakLiveBytes);
+        }
+        std::printf("\n");
+    }
+    const CompressionMetrics& c = report.compression;
+    if (c.rawLines > 0) {
+        std::printf("  compression: %lld -> %lld lines, %lld loops, depth %d\n",
+                    (long long)c.rawLines, (long long)c.compressedLines, (long long)c.loops, c.maxDepth);
+    }
+    const RowReuseMetrics& r = report.rowReuse;
+    if (r.rows > 0) {
+        std::printf("  rows: %lld/%lld regenerated, %lld/%lld compressed segments reused%s\n",
+                    (long long)r.regeneratedRows, (long long)r.rows, (long long)r.reusedSegments, (long long)r.segments,
+                    r.reusedIndex ? "" : " (no previous row index)");
+    }
+}
+
+// generate 子命令
+int RunGenerate(const std::vector<std::string>& args) {
+    std::string config, output, types = "2";
+    DesignSpec spec;
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& a = args[i];
+        bool option = a.size() > 1 && a[0] == '-';
+        if (option && i + 1 >= args.size()) {
+            std::fprintf(stderr, "yima_cli: %s needs a value\n", a.c_str());
+            return 2;
+        }
+        if (a == "-c" || a == "--config") {
+            config = args[++i];
+        } else if (a == "--size") {
+            if (std::sscanf(args[++i].c_str(), "%dx%d", &spec.width, &spec.height) != 2) spec.width = 0;
+        } else if (a == "--pattern") {
+            if (!ParseDesignPattern(args[++i], spec.pattern)) {
+                std::fprintf(stderr, "yima_cli: unknown pattern: %s\n", args[i].c_str());
+                return 2;
+            }
+        } else if (a == "--seed") {
+            spec.seed = std::strtoull(args[++i].c_str(), nullptr, 10);
+        } else if (a == "--shaxian-types") {
+            types = args[++i];
+        } else if (a == "--stripe") {
+            spec.stripe = std::atoi(args[++i].c_str());
+        } else if (a == "--motif") {
+            spec.motif = std::atoi(args[++i].c_str());
+        } else if (a == "--density") {
+            spec.density = std::atof(args[++i].c_str());
+        } else if (option) {
+            std::fprintf(stderr, "yima_cli: unknown option: %s\n", a.c_str());
+            return 2;
+        } else if (output.empty()) {
+            output = a;
+        } else {
+            output.clear();
+            break;
+        }
+    }
+    if (config.empty() || output.empty()) {
+        PrintUsage();
+        return 2;
+    }
+
+    YimaConfig cfg;
+    if (!LoadYimaConfig(CreatePathFromUtf8(config), cfg)) {
+        std::fprintf(stderr, "yima_cli: cannot load config %s\n", config.c_str());
+        return 1;
+    }
+    std::vector<std::pair<int, fs::path>> targets;   // (shaxian 种类数, 输出目录)
+    if (types == "all") {
+        for (int n : SignCycleTypes(cfg)) {
+            std::string name = std::string(DesignPatternName(spec.pattern)) + "_s" + std::to_string(n);
+            targets.emplace_back(n, CreatePathFromUtf8(output) / name);
+        }
+    } else {
+        targets.emplace_back(std::atoi(types.c_str()), CreatePathFromUtf8(output));
+    }
+
+    for (const auto& [n, dir] : targets) {
+        spec.shaxianTypes = n;
+        GeneratedDesign design;
+        int rc = GenerateDesign(cfg, spec, design);
+        if (rc == 0) rc = WriteDesignDir(design, dir);
+        if (rc != 0) {
+            std::fprintf(stderr, "yima_cli: cannot generate %s (code %d)\n", PathToUtf8String(dir).c_str(), rc);
+            return 1;
+        }
+        std::printf("%s: %dx%d %s, %d shaxian types, seed %llu\n", PathToUtf8String(dir).c_str(), spec.width,
+                    spec.height, DesignPatternName(spec.pattern), n, (unsigned long long)spec.seed);
+    }
+    return 0;
+}
+
+std::vector<std::string> SplitNames(const std::string& s) {
+    std::vector<std::string> out;
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos) end = s.size();
+        if (end > pos) out.push_back(s.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return out;
+}
+
+// emulate 子命令
+int RunEmulate(const std::vector<std::string>& args) {
+    std::string program, against;
+    bool registers = false, optimize = false;
+    EmulatorOptions options;
+    options.traceLimit = 1000;
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& a = args[i];
+        if (a == "--registers" || a == "--optimize") {
+            (a == "--registers" ? registers : optimize) = true;
+            continue;
+        }
+        bool option = a.size() > 1 && a[0] == '-';
+        if (option && i + 1 >= args.size()) {
+            std::fprintf(stderr, "yima_cli: %s needs a value\n", a.c_str());
+            return 2;
+        }
+        if (a == "--against") {
+            against = args[++i];
+        } else if (a == "--trace") {
+            options.traceRegisters = SplitNames(args[++i]);
+        } else if (a == "--trace-limit") {
+            options.traceLimit = (size_t)std::strtoull(args[++i].c_str(), nullptr, 10);
+        } else if (option) {
+            std::fprintf(stderr, "yima_cli: unknown option: %s\n", a.c_str());
+            return 2;
+        } else if (program.empty()) {
+            program = a;
+        } else {
+            program.clear();
+            break;
+        }
+    }
+    if (program.empty()) {
+        PrintUsage();
+        return 2;
+    }
+
+    MappedFile file(CreatePathFromUtf8(program));
+    if (!file.IsOpen()) {
+        std::fprintf(stderr, "yima_cli: cannot read %s\n", program.c_str());
+        return 1;
+    }
+    const std::string_view text(reinterpret_cast<const char*>(file.data()), file.size());
+    EmulatorResult result;
+    if (EmulateProgram(text, options, result) != 0) {
+        std::fprintf(stderr, "%s: %s\n", program.c_str(), result.error.c_str());
+        return 1;
+    }
+    std::printf("%s: %llu lines expanded, %llu executed, %llu skipped by IF, %llu RS/RE\n", program.c_str(),
+                (unsigned long long)result.lines, (unsigned long long)result.steps,
+                (unsigned long long)result.skipped, (unsigned long long)result.loopInstructions);
+    for (int op = 0; op < OP_COUNT; ++op) {
+        if (result.opCounts[op]) std::printf("  %-6s %12llu\n", OpName((Op)op), (unsigned long long)result.opCounts[op]);
+    }
+    if (registers) {
+        for (const auto& [name, value] : result.registers) std::printf("  %s = %s\n", name.c_str(), FormatFixed(value).c_str());
+    }
+    for (const RegisterWrite& w : result.trace) {
+        std::printf("  line %llu: %s = %s\n", (unsigned long long)w.line, result.regs.Name(w.reg).c_str(),
+                    FormatFixed(w.value).c_str());
+    }
+    if (optimize) {
+        OptimizeStats stats;
+        const std::string optimized = OptimizeProgram(text, PROGRAM_PASS_ALL, &stats);
+        EmulatorResult after;
+        if (EmulateProgram(optimized, EmulatorOptions(), after) != 0) {
+            std::fprintf(stderr, "optimized %s: %s\n", program.c_str(), after.error.c_str());
+            return 1;
+        }
+        std::printf("optimized: %llu -> %llu lines (%llu folded, %llu removed, %llu unchanged assignments), "
+                    "%llu -> %llu executed\n",
+                    (unsigned long long)stats.inputLines, (unsigned long long)stats.outputLines,
+                    (unsigned long long)stats.folded, (unsigned long long)stats.removed, (unsigned long long)stats.unchanged,
+                    (unsigned long long)result.steps, (unsigned long long)after.steps);
+        if (!SameEffects(after, result)) {
+            std::fprintf(stderr, "optimized %s behaves differently from the original\n", program.c_str());
+            return 1;
+        }
+    }
+    if (against.empty()) return 0;
+
+    MappedFile simpleFile(CreatePathFromUtf8(against));
+    if (!simpleFile.IsOpen()) {
+        std::fprintf(stderr, "yima_cli: cannot read %s\n", against.c_str());
+        return 1;
+    }
+    ProgramDiff diff;
+    CompareExpanded(text, std::string_view(reinterpret_cast<const char*>(simpleFile.data()), simpleFile.size()), diff);
+    if (diff.equal) {
+        std::printf("expands to %s (%llu lines)\n", against.c_str(), (unsigned long long)diff.expectedLines);
+        return 0;
+    }
+    if (!diff.error.empty()) std::fprintf(stderr, "%s: %s\n", program.c_str(), diff.error.c_str());
+    else std::fprintf(stderr, "differs from %s at expanded line %llu: expected \"%s\", got \"%s\"\n", against.c_str(),
+                      (unsigned long long)diff.line, diff.expected.c_str(), diff.actual.c_str());
+    return 1;
+}
+
+int Run(const std::vector<std::string>& args) {
+    if (!args.empty() && args[0] == "generate") return RunGenerate(std::vector<std::string>(args.begin() + 1, args.end()));
+    if (!args.empty() && args[0] == "emulate") return RunEmulate(std::vector<std::string>(args.begin() + 1, args.end()));
+    CliOptions opts;
+    if (!ParseArgs(args, opts)) {
+        PrintUsage();
+        return 2;
+    }
+    if (!opts.logLevel.empty()) {
+        LogLevel level;
+        if (!ParseLogLevel(opts.logLevel, level)) {
+            std::fprintf(stderr, "yima_cli: unknown log level: %s\n", opts.logLevel.c_str());
+            return 2;
+        }
+        SetLogLevel(level);
+    }
+
+    PipelineOptions pipeline;
+    pipeline.export_toml = opts.exportToml;
+    pipeline.incremental = opts.incremental;
+    pipeline.optimize = opts.optimize ? (unsigned)PROGRAM_PASS_ALL : 0u;
+
+    std::vector<BatchJob> jobs;
+    std::vector<std::string> names;
+    auto addJob = [&](const std::string& name, const std::string& input, const std::string& output) {
+        BatchJob job;
+        job.config_path = opts.config;
+        job.input_path = input;
+        job.output_path = output;
+        job.options = pipeline;
+        job.report = opts.report;
+        jobs.push_back(std::move(job));
+        names.push_back(name);
+    };
+    if (opts.batch) {
+        fs::path root = CreatePathFromUtf8(opts.positional[0]);
+        fs::path outRoot = CreatePathFromUtf8(opts.positional[1]);
+        for (const fs::path& d : FindDesigns(root)) {
+            std::string name = PathToUtf8String(d.filename());
+            addJob(name, PathToUtf8String(d), PathToUtf8String(outRoot / d.filename()));
+        }
+        if (jobs.empty()) {
+            std::fprintf(stderr, "yima_cli: no designs found in %s\n", opts.positional[0].c_str());
+            return 1;
+        }
+    } else {
+        addJob(opts.positional[0], opts.positional[0], opts.positional[1]);
+    }
+
+    std::vector<BatchJobResult> results;
+    BatchSummary summary;
+    int succeeded;
+    {
+        std::unique_ptr<TraceSession> trace;
+        if (!opts.tracePath.empty()) trace = std::make_unique<TraceSession>(CreatePathFromUtf8(opts.tracePath));
+        succeeded = RunBatch(jobs, opts.batch ? opts.threads : 1, results, summary);
+    }
+    FlushLog();
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const BatchJobResult& r = results[i];
+        if (opts.report && r.worker >= 0) PrintReport(names[i], r.report);
+        if (r.code != 0) std::fprintf(stderr, "%s: %s\n", names[i].c_str(), r.error.c_str());
+    }
+    if (opts.batch) {
+        std::printf("%d/%zu designs succeeded in %.1f ms on %d threads\n",
+                    succeeded, jobs.size(), summary.wallMs, summary.concurrency);
+    }
+    return succeeded == (int)jobs.size() ? 0 : 1;
+}
+
+} // namespace
+
+#ifdef _WIN32
+// 以宽字符接收参数, 保证中文路径按 UTF-8 传给流水线
+int wmain(int argc, wchar_t** argv) {
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) args.push_back(WideToUtf8(argv[i]));
+    return Run(args);
+}
+#else
+int main(int argc, char** argv) {
+    return Run(std::vector<std::string>(argv + 1, argv + argc));
+}
+#endif
@@ -0,0 +1,152 @@
+#include "yima_config.h"
+#include "toml.hpp"
+#include "content_hash.h"
+#include "encoding_utils.h"
+#include "ycombined_format.h"
+#include "yima_log.h"
+#include "yima_trace.h"
+#include "yima_probes.h"
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string ConfigValueToString(const toml::node* node) {
+    if (!node) return "";
+    if (auto s = node->as_string()) return s->get();
+    if (auto i = node->as_integer()) return std::to_string(i->get());
+    return "";
+}
+
+// 以二进制方式读取整个文件后再交给 toml++ 解析 (避免非 ASCII 路径问题), 同时记录内容哈希
+toml::table ParseTomlFile(const fs::path& p, YimaConfig& cfg) {
+    std::ifstream file(p, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("Cannot open file with ifstream");
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    file.close();
+    std::string text = buffer.str();
+    cfg.sourceHashes[PathToUtf8String(p.filename())] = HashString(text);
+    return toml::parse(text, p.string());
+}
+
+} // namespace
+
+void LoadColorConfig(const fs::path& config_dir, YimaConfig& cfg) {
+    fs::path colorPath = config_dir / "color_to_number.toml";
+    YIMA_LOG_INFO("Config") << "Looking for: " << colorPath.string() << " - Exists: " << (fs::exists(colorPath) ? "YES" : "NO");
+    if (fs::exists(colorPath)) {
+        try {
+            auto configTbl = ParseTomlFile(colorPath, cfg);
+            for (const char* key : LAYER_NAMES) {
+                if (auto section = configTbl[key].as_table()) {
+                    for (auto&& [k, value] : *section) {
+                        cfg.colorMap[key][std::string(k.str())] = ConfigValueToString(&value);
+                    }
+                }
+            }
+            YIMA_LOG_INFO("Config") << "Successfully loaded color_to_number.toml";
+        } catch (const std::exception& e) {
+            YIMA_LOG_ERROR("Config") << "Error loading color_to_number.toml: " << e.what();
+            throw;
+        }
+    } else {
+        YIMA_LOG_WARN("Config") << "color_to_number.toml not found";
+    }
+
+    fs::path zbPath = config_dir / "zhenban_qianhou.toml";
+    YIMA_LOG_INFO("Config") << "Looking for: " << zbPath.string() << " - Exists: " << (fs::exists(zbPath) ? "YES" : "NO");
+    if (fs::exists(zbPath)) {
+        try {
+            auto zbTbl = ParseTomlFile(zbPath, cfg);
+            if (auto section = zbTbl["zhenban_qianhou"].as_table()) {
+                for (auto&& [k, value] : *section) {
+                    cfg.zhenbanMap[std::string(k.str())] = ConfigValueToString(&value);
+                }
+            }
+            if (auto signSection = zbTbl["line_sign"].as_table()) {
+                for (auto&& [k, value] : *signSection) {
+                    if (value.is_array()) {
+                        for (auto&& node : *value.as_array()) cfg.signCycles[std::string(k.str())].push_back(ConfigValueToString(&node));
+                    }
+                }
+            }
+            YIMA_LOG_INFO("Config") << "Successfully loaded zhenban_qianhou.toml";
+        } catch (const std::exception& e) {
+            YIMA_LOG_ERROR("Config") << "Error loading zhenban_qianhou.toml: " << e.what();
+            throw;
+        }
+    } else {
+        YIMA_LOG_WARN("Config") << "zhenban_qianhou.toml not found";
+    }
+}
+
+void LoadCmdConfig(const fs::path& config_dir, YimaConfig& cfg) {
+    struct CmdFile { const char* file; const char* section; const char* key; CmdTable table; };
+    const CmdFile files[] = {
+        { "dumu_to_cmd.toml", "dumu", "dumu", CMD_DUMU },
+        { "pre_action_to_cmd.toml", "pre_action", "pre", CMD_PRE },
+        { "post_action_to_cmd.toml", "post_action", "post", CMD_POST },
+        { "sema_to_cmd.toml", "sema", "sema", CMD_SEMA },
+        { "luola_to_cmd.toml", "luola", "luola", CMD_LUOLA },
+        { "line_switch_to_cmd.toml", "line_switch", "ls", CMD_LINE_SWITCH },
+        { "shaxian_switch_to_cmd.toml", "shaxian_switch", "ss", CMD_SHAXIAN_SWITCH },
+    };
+
+    YIMA_LOG_INFO("Config") << "Config directory: " << config_dir.string();
+    for (const auto& f : files) {
+        fs::path p = config_dir / f.file;
+        YIMA_LOG_INFO("Config") << "Loading config: " << p.string() << " section: " << f.section << " key: " << f.key;
+        if (!fs::exists(p)) {
+            YIMA_LOG_WARN("Config") << "File not found: " << p.string();
+            continue;
+        }
+        try {
+            auto tbl = ParseTomlFile(p, cfg);
+            auto sect = tbl[f.section].as_table();
+            if (sect) {
+                for (auto&& [k, v] : *sect) {
+                    cfg.cmdMaps[f.table][std::string(k.str())] = ConfigValueToString(&v);
+                    YIMA_LOG_DEBUG("Config") << "Loaded mapping: " << f.key << "[" << std::string(k.str()) << "]";
+                }
+            }
+            YIMA_PROBE2(config__file, p.c_str(), sect ? sect->size() : 0);
+            YIMA_LOG_INFO("Config") << "Successfully loaded: " << p.string();
+        } catch (const std::exception& e) {
+            YIMA_LOG_ERROR("Config") << "Parse error in " << p.string() << ": " << e.what();
+        }
+    }
+}
+
+void LoadHeadTailConfig(const fs::path& config_dir, YimaConfig& cfg) {
+    fs::path configPath = config_dir / "head_tail_cmd.toml";
+    if (!fs::exists(configPath)) return;
+    try {
+        auto tbl = ParseTomlFile(configPath, cfg);
+        if (auto section = tbl["head_tail_cmd"].as_table()) {
+            if (auto h = section->get_as<std::string>("head")) cfg.headCmd = std::string(TrimCmdView(h->get()));
+            if (auto t = section->get_as<std::string>("tail")) cfg.tailCmd = std::string(TrimCmdView(t->get()));
+        }
+    } catch (const std::exception& e) {
+        YIMA_LOG_ERROR("Config") << "Exception loading head_tail_cmd.toml: " << e.what();
+    }
+}
+
+bool LoadYimaConfig(const fs::path& config_dir, YimaConfig& cfg) {
+    TraceSpan span("load_config", "config");
+    if (TraceEnabled()) span.Detail(PathToUtf8String(config_dir));
+    YIMA_PROBE1(config__load, config_dir.c_str());
+    try {
+        LoadColorConfig(config_dir, cfg);
+        LoadCmdConfig(config_dir, cfg);
+        LoadHeadTailConfig(config_dir, cfg);
+        YIMA_PROBE1(config__done, 1);
+        return true;
+    } catch (const std::exception& e) {
+        YIMA_LOG_ERROR("Config") << "Failed to load configuration: " << e.what();
+        YIMA_PROBE1(config__done, 0);
+        return false;
+    }
+}
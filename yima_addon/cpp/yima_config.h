@@ -0,0 +1,73 @@
+#ifndef YIMA_CONFIG_H
+#define YIMA_CONFIG_H
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// *_to_cmd.toml 映射表
+enum CmdTable {
+    CMD_DUMU = 0,
+    CMD_PRE,
+    CMD_POST,
+    CMD_SEMA,
+    CMD_LUOLA,
+    CMD_LINE_SWITCH,
+    CMD_SHAXIAN_SWITCH,
+    CMD_TABLE_COUNT
+};
+
+// 配置文件夹中全部配置的解析结果, 加载一次后可被多个阶段/多次运行共享 (只读)
+struct YimaConfig {
+    // color_to_number.toml: 图层 -> 颜色 -> 码值
+    std::map<std::string, std::map<std::string, std::string>> colorMap;
+    // zhenban_qianhou.toml: sema 码 -> 针板前后属性, 以及 shaxian 种类数 -> 行符号循环
+    std::map<std::string, std::string> zhenbanMap;
+    std::map<std::string, std::vector<std::string>> signCycles;
+    // *_to_cmd.toml: 组合键 -> 指令块 (原文, 含换行)
+    std::unordered_map<std::string, std::string> cmdMaps[CMD_TABLE_COUNT];
+    // head_tail_cmd.toml: 已去除首尾空白
+    std::string headCmd;
+    std::string tailCmd;
+    // 已读取的配置文件内容哈希 (文件名 -> FNV-1a), 供增量构建判断配置是否变化
+    std::map<std::string, uint64_t> sourceHashes;
+
+    // 未读取 (缺失) 的文件返回 0
+    uint64_t SourceHash(const std::string& file) const {
+        auto it = sourceHashes.find(file);
+        return it == sourceHashes.end() ? 0 : it->second;
+    }
+
+    // 查找指令块, 不存在时返回空串
+    const std::string& Cmd(CmdTable table, const std::string& key) const {
+        static const std::string empty;
+        auto it = cmdMaps[table].find(key);
+        return it == cmdMaps[table].end() ? empty : it->second;
+    }
+};
+
+// 修剪字符串首尾的空白字符和换行符
+inline std::string_view TrimCmdView(std::string_view s) {
+    auto first = s.find_first_not_of(" \t\n\r");
+    if (first == std::string_view::npos) return std::string_view();
+    auto last = s.find_last_not_of(" \t\n\r");
+    return s.substr(first, last - first + 1);
+}
+
+// 阶段 2 使用: color_to_number.toml + zhenban_qianhou.toml, 解析失败时抛出异常
+void LoadColorConfig(const std::filesystem::path& config_dir, YimaConfig& cfg);
+
+// 阶段 4 使用: 7 个 *_to_cmd.toml, 缺失或解析失败的文件仅记录日志
+void LoadCmdConfig(const std::filesystem::path& config_dir, YimaConfig& cfg);
+
+// 阶段 5 使用: head_tail_cmd.toml, 缺失或解析失败时头尾为空
+void LoadHeadTailConfig(const std::filesystem::path& config_dir, YimaConfig& cfg);
+
+// 加载全部配置, 成功返回 true
+bool LoadYimaConfig(const std::filesystem::path& config_dir, YimaConfig& cfg);
+
+#endif // YIMA_CONFIG_H
@@ -0,0 +1,291 @@
+#include "yima_log.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <thread>
+
+// 日志通道: 级别可在运行中修改, 输出端受 Logger 的 mutex_ 保护
+struct LogChannelState {
+    uint64_t id = 0;
+    std::atomic<int> level{ (int)LogLevel::Warn };
+    std::shared_ptr<LogSink> sink;   // 为空时使用 ConsoleSink
+};
+
+namespace {
+
+// 环形缓冲区容量 (条)
+constexpr size_t LOG_RING_CAPACITY = 4096;
+
+std::atomic<int> g_level{ (int)LogLevel::Warn };
+
+// 当前线程所在的通道 (由 LogChannelScope 设置), 为空时使用进程级设置
+thread_local const LogChannelState* t_channel = nullptr;
+
+// 缓冲区中的一条记录及其所属通道 (0 为进程级)
+struct QueuedLog {
+    uint64_t channel = 0;
+    LogRecord record;
+};
+
+double NowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 默认输出端: 警告与错误写 stderr, 其余写 stdout, 每批各 flush 一次
+void ConsoleSink(std::vector<LogRecord>&& batch) {
+    std::string out, err;
+    for (const LogRecord& r : batch) {
+        std::string& s = r.level >= LogLevel::Warn ? err : out;
+        if (!r.tag.empty()) {
+            s += '[';
+            s += r.tag;
+            s += "] ";
+        }
+        s += r.message;
+        s += '\n';
+    }
+    if (!out.empty()) {
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        std::fflush(stdout);
+    }
+    if (!err.empty()) {
+        std::fwrite(err.data(), 1, err.size(), stderr);
+        std::fflush(stderr);
+    }
+}
+
+class Logger {
+public:
+    static Logger& Instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    void Push(QueuedLog&& entry) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_) return;
+            if (!thread_.joinable()) thread_ = std::thread([this] { Run(); });
+            if (ring_.size() < LOG_RING_CAPACITY) {
+                ring_.push_back(std::move(entry));
+            } else {
+                // 已满: 覆盖最早的记录, 丢弃数量报告给被丢弃记录所属的通道
+                ++dropped_[ring_[head_].channel];
+                ring_[head_] = std::move(entry);
+                head_ = (head_ + 1) % LOG_RING_CAPACITY;
+                ++handled_;
+            }
+            ++pushed_;
+        }
+        cv_.notify_one();
+    }
+
+    uint64_t CreateChannel(LogLevel level) {
+        auto channel = std::make_shared<LogChannelState>();
+        channel->level.store((int)level, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex_);
+        channel->id = ++channelId_;
+        channels_[channel->id] = channel;
+        return channel->id;
+    }
+
+    std::shared_ptr<LogChannelState> FindChannel(uint64_t id) {
+        if (id == 0) return nullptr;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = channels_.find(id);
+        return it == channels_.end() ? nullptr : it->second;
+    }
+
+    void SetChannelSink(uint64_t id, LogSink sink) {
+        std::shared_ptr<LogSink> old;
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = channels_.find(id);
+        if (it == channels_.end()) return;
+        old = std::move(it->second->sink);
+        if (sink) it->second->sink = std::make_shared<LogSink>(std::move(sink));
+        idle_.wait(lock, [&] { return !writing_; });
+        lock.unlock();
+        // old 在锁外释放, 输出端的析构可能较慢 (如释放 ThreadSafeFunction)
+    }
+
+    void DestroyChannel(uint64_t id) {
+        std::shared_ptr<LogChannelState> old;
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = channels_.find(id);
+        if (it == channels_.end()) return;
+        old = std::move(it->second);
+        channels_.erase(it);
+        idle_.wait(lock, [&] { return !writing_; });
+        lock.unlock();
+    }
+
+    void Flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        uint64_t target = pushed_;
+        cv_.notify_one();
+        idle_.wait(lock, [&] { return handled_ >= target || stop_; });
+    }
+
+private:
+    void Run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            cv_.wait(lock, [&] { return stop_ || !ring_.empty(); });
+            if (ring_.empty()) break;   // stop_ 且已全部输出
+
+            // 按通道分批, 各通道内保持写入顺序; 通道通常只有几个, 线性查找即可
+            std::vector<std::pair<uint64_t, std::vector<LogRecord>>> batches;
+            auto batchFor = [&](uint64_t channel) -> std::vector<LogRecord>& {
+                for (auto& b : batches) if (b.first == channel) return b.second;
+                batches.emplace_back(channel, std::vector<LogRecord>());
+                return batches.back().second;
+            };
+            for (const auto& d : dropped_) {
+                LogRecord notice;
+                notice.level = LogLevel::Warn;
+                notice.tag = "Log";
+                notice.message = std::to_string(d.second) + " records dropped (buffer full)";
+                notice.timeMs = NowMs();
+                batchFor(d.first).push_back(std::move(notice));
+            }
+            dropped_.clear();
+            for (size_t i = 0; i < ring_.size(); ++i) {
+                QueuedLog& q = ring_[(head_ + i) % ring_.size()];
+                batchFor(q.channel).push_back(std::move(q.record));
+            }
+            size_t n = ring_.size();
+            ring_.clear();
+            head_ = 0;
+            // 已删除或未设置输出端的通道写到控制台
+            std::vector<std::shared_ptr<LogSink>> sinks;
+            for (const auto& b : batches) {
+                auto it = channels_.find(b.first);
+                sinks.push_back(it == channels_.end() ? nullptr : it->second->sink);
+            }
+            writing_ = true;
+            lock.unlock();
+
+            for (size_t i = 0; i < batches.size(); ++i) {
+                if (sinks[i]) (*sinks[i])(std::move(batches[i].second));
+                else ConsoleSink(std::move(batches[i].second));
+            }
+            sinks.clear();
+
+            lock.lock();
+            writing_ = false;
+            handled_ += n;
+            idle_.notify_all();
+        }
+        idle_.notify_all();
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;      // 有新记录或需要退出
+    std::condition_variable idle_;    // 一批输出完成
+    std::vector<QueuedLog> ring_;     // 环形缓冲区, head_ 为最早的记录
+    size_t head_ = 0;
+    std::map<uint64_t, uint64_t> dropped_;   // 通道 -> 尚未报告的丢弃数量
+    uint64_t pushed_ = 0;             // 累计写入的记录数
+    uint64_t handled_ = 0;            // 累计已输出或已丢弃的记录数
+    std::map<uint64_t, std::shared_ptr<LogChannelState>> channels_;
+    uint64_t channelId_ = 0;
+    bool writing_ = false;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+} // namespace
+
+void SetLogLevel(LogLevel level) {
+    g_level.store((int)level, std::memory_order_relaxed);
+}
+
+LogLevel GetLogLevel() {
+    return (LogLevel)g_level.load(std::memory_order_relaxed);
+}
+
+bool LogEnabled(LogLevel level) {
+    const LogChannelState* channel = t_channel;
+    int min = channel ? channel->level.load(std::memory_order_relaxed) : g_level.load(std::memory_order_relaxed);
+    return (int)level >= min && level != LogLevel::Off;
+}
+
+bool ParseLogLevel(const std::string& name, LogLevel& level) {
+    static const LogLevel levels[] = { LogLevel::Debug, LogLevel::Info, LogLevel::Warn, LogLevel::Error, LogLevel::Off };
+    for (LogLevel l : levels) {
+        if (name == LogLevelName(l)) {
+            level = l;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* LogLevelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "debug";
+        case LogLevel::Info: return "info";
+        case LogLevel::Warn: return "warn";
+        case LogLevel::Error: return "error";
+        default: return "off";
+    }
+}
+
+uint64_t CreateLogChannel(LogLevel level) {
+    return Logger::Instance().CreateChannel(level);
+}
+
+void SetLogChannelLevel(uint64_t channel, LogLevel level) {
+    if (auto c = Logger::Instance().FindChannel(channel)) c->level.store((int)level, std::memory_order_relaxed);
+}
+
+LogLevel GetLogChannelLevel(uint64_t channel) {
+    auto c = Logger::Instance().FindChannel(channel);
+    return c ? (LogLevel)c->level.load(std::memory_order_relaxed) : GetLogLevel();
+}
+
+void SetLogChannelSink(uint64_t channel, LogSink sink) {
+    Logger::Instance().SetChannelSink(channel, std::move(sink));
+}
+
+void DestroyLogChannel(uint64_t channel) {
+    Logger::Instance().DestroyChannel(channel);
+}
+
+uint64_t CurrentLogChannel() {
+    return t_channel ? t_channel->id : 0;
+}
+
+LogChannelScope::LogChannelScope(uint64_t channel)
+    : channel_(Logger::Instance().FindChannel(channel)), previous_(t_channel) {
+    t_channel = channel_.get();
+}
+
+LogChannelScope::~LogChannelScope() {
+    t_channel = previous_;
+}
+
+void FlushLog() {
+    Logger::Instance().Flush();
+}
+
+void WriteLog(LogLevel level, std::string&& tag, std::string&& message) {
+    LogRecord record;
+    record.level = level;
+    record.tag = std::move(tag);
+    record.message = std::move(message);
+    record.timeMs = NowMs();
+    Logger::Instance().Push(QueuedLog{ CurrentLogChannel(), std::move(record) });
+}
@@ -0,0 +1,121 @@
+#ifndef YIMA_LOG_H
+#define YIMA_LOG_H
+
+/*
+ * 分级异步日志
+ *
+ * 低于当前级别的日志在调用处直接跳过, 不格式化消息。其余记录放入定长环形缓冲区后立即返回,
+ * 由后台线程批量交给输出端 (默认写到 stdout/stderr, 每批只 flush 一次; 也可替换为 JS 回调)。
+ * 缓冲区满时丢弃最早的记录, 丢弃数量随下一批输出报告。
+ * 级别与输出端默认为进程级设置; 需要分别接收日志的调用方 (如各 worker_threads) 可以创建自己的日志通道,
+ * 线程在 LogChannelScope 内写入的日志只按该通道的级别过滤并交给该通道的输出端。
+ *
+ * 用法: YIMA_LOG_INFO("Step 3") << "Writing CSV to: " << path;
+ */
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+enum class LogLevel : int {
+    Debug = 0,
+    Info = 1,
+    Warn = 2,
+    Error = 3,
+    Off = 4,
+};
+
+struct LogRecord {
+    LogLevel level = LogLevel::Info;
+    std::string tag;          // 来源, 例如 "Step 3", "Config"
+    std::string message;
+    double timeMs = 0;        // Unix 时间戳 (毫秒)
+};
+
+// 输出端, 在后台线程上按批调用
+using LogSink = std::function<void(std::vector<LogRecord>&& batch)>;
+
+// 进程级级别, 默认只输出警告与错误
+void SetLogLevel(LogLevel level);
+LogLevel GetLogLevel();
+// 按当前线程所在的通道 (不在通道内时按进程级级别) 判断
+bool LogEnabled(LogLevel level);
+
+// 名称 (debug / info / warn / error / off) 与级别互相转换, 无法识别时返回 false
+bool ParseLogLevel(const std::string& name, LogLevel& level);
+const char* LogLevelName(LogLevel level);
+
+/**
+ * @brief 创建日志通道, 初始输出端为控制台
+ * @return 通道编号 (非 0)
+ */
+uint64_t CreateLogChannel(LogLevel level);
+
+// 修改通道的级别, 对正在该通道内运行的线程立即生效
+void SetLogChannelLevel(uint64_t channel, LogLevel level);
+// 不存在的通道返回进程级级别
+LogLevel GetLogChannelLevel(uint64_t channel);
+
+// 替换通道的输出端, sink 为空时恢复控制台输出; 等待正在进行的输出结束后返回
+void SetLogChannelSink(uint64_t channel, LogSink sink);
+
+// 删除通道并等待正在进行的输出结束; 尚未输出的记录改写到控制台
+void DestroyLogChannel(uint64_t channel);
+
+// 当前线程所在的通道, 0 表示不在任何通道内; 启动新线程时传给 LogChannelScope 以沿用调用方的通道
+uint64_t CurrentLogChannel();
+
+struct LogChannelState;
+
+// 在作用域内把当前线程的日志写入指定通道; 0 或已删除的通道表示进程级设置。可以嵌套
+class LogChannelScope {
+public:
+    explicit LogChannelScope(uint64_t channel);
+    ~LogChannelScope();
+    LogChannelScope(const LogChannelScope&) = delete;
+    LogChannelScope& operator=(const LogChannelScope&) = delete;
+
+private:
+    std::shared_ptr<LogChannelState> channel_;
+    const LogChannelState* previous_;
+};
+
+// 等待缓冲区中已有的记录全部输出
+void FlushLog();
+
+// 写入一条记录 (调用方已检查 LogEnabled)
+void WriteLog(LogLevel level, std::string&& tag, std::string&& message);
+
+// 一条日志的格式化缓冲, 析构时写入
+class LogMessage {
+public:
+    LogMessage(LogLevel level, std::string tag) : level_(level), tag_(std::move(tag)) {}
+    ~LogMessage() { WriteLog(level_, std::move(tag_), stream_.str()); }
+    LogMessage(const LogMessage&) = delete;
+    LogMessage& operator=(const LogMessage&) = delete;
+
+    std::ostream& stream() { return stream_; }
+
+private:
+    LogLevel level_;
+    std::string tag_;
+    std::ostringstream stream_;
+};
+
+// 使 "cond ? (void)0 : LogVoidify() & stream << ..." 两个分支类型一致
+struct LogVoidify {
+    void operator&(std::ostream&) {}
+};
+
+#define YIMA_LOG(level, tag) \
+    !LogEnabled(level) ? (void)0 : LogVoidify() & LogMessage(level, tag).stream()
+
+#define YIMA_LOG_DEBUG(tag) YIMA_LOG(LogLevel::Debug, tag)
+#define YIMA_LOG_INFO(tag) YIMA_LOG(LogLevel::Info, tag)
+#define YIMA_LOG_WARN(tag) YIMA_LOG(LogLevel::Warn, tag)
+#define YIMA_LOG_ERROR(tag) YIMA_LOG(LogLevel::Error, tag)
+
+#endif // YIMA_LOG_H
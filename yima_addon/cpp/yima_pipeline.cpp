@@ -0,0 +1,529 @@
+#include "yima_pipeline.h"
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include "encoding_utils.h"
+#include "content_hash.h"
+#include "build_manifest.h"
+#include "incremental_rows.h"
+#include "run_report.h"
+#include "yima_trace.h"
+#include "mapped_file.h"
+#include "program_optimize.h"
+
+// 引入各模块的头文件
+#include "1.bmp_extract/bmp_extract.h"
+#include "2.toml_handle/toml_handle.h"
+#include "3.data_csv_handle/data_csv_handle.h"
+#include "4.cmd_csv_handle/cmd_csv_handle.h"
+#include "5.txt_generator/txt_generator.h"
+#include "6.txt_handle/txt_handle.h"
+#include "yima_log.h"
+
+namespace fs = std::filesystem;
+
+// 增量构建清单的版本盐: 阶段实现或中间格式变化时修改此值, 使旧清单全部失效
+static const uint64_t PIPELINE_BUILD_SALT = HashString("yima-pipeline-1");
+
+// 辅助函数：确保目录存在
+static void ensure_directory_exists(const fs::path& p) {
+    if (!fs::exists(p)) {
+        fs::create_directories(p);
+    }
+}
+
+std::string OutputDirKey(const std::string& output_path) {
+    fs::path p = CreatePathFromUtf8(output_path).lexically_normal();
+    if (!p.has_filename() && p.has_parent_path()) p = p.parent_path();   // 去掉末尾的分隔符
+    std::error_code ec;
+    fs::path c = fs::weakly_canonical(p, ec);
+    return PathToUtf8String(ec ? p : c);
+}
+
+// 进程内正在写入的输出目录; 同一进程中的所有 worker_threads 共用一份, 防止两个流水线交错写同一组中间文件
+class OutputDirLock {
+public:
+    explicit OutputDirLock(const std::string& output_path) : key_(OutputDirKey(output_path)) {
+        std::lock_guard<std::mutex> lock(Mutex());
+        owned_ = Active().insert(key_).second;
+    }
+    ~OutputDirLock() {
+        if (!owned_) return;
+        std::lock_guard<std::mutex> lock(Mutex());
+        Active().erase(key_);
+    }
+    OutputDirLock(const OutputDirLock&) = delete;
+    OutputDirLock& operator=(const OutputDirLock&) = delete;
+
+    bool owned() const { return owned_; }
+
+private:
+    static std::mutex& Mutex() { static std::mutex m; return m; }
+    static std::set<std::string>& Active() { static std::set<std::string> s; return s; }
+
+    std::string key_;
+    bool owned_ = false;
+};
+
+// 包装 Step 1: 遍历目录处理 BMP, 输出 .ylayer (可选同时导出旧版 .toml)
+// 内容哈希与清单记录一致且输出完好的 BMP 不再重新解码
+static int extract_bmp_layers_dir(const std::string& input_dir, const std::string& output_dir, bool export_toml,
+                                  BuildManifest& manifest, const fs::path& base_dir, bool incremental) {
+    TraceSpan span("extract", "stage");
+    try {
+        fs::path input_path = CreatePathFromUtf8(input_dir);
+        fs::path output_path = CreatePathFromUtf8(output_dir);
+        
+        ensure_directory_exists(output_path);
+        bool found = false;
+        std::set<std::string> seen;
+        if (fs::exists(input_path) && fs::is_directory(input_path)) {
+             for (const auto& entry : fs::directory_iterator(input_path)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".bmp") {
+                    found = true;
+                    // std::cout << "Processing BMP: " << entry.path().string() << std::endl;
+                    std::string stage = "extract:" + PathToUtf8String(entry.path().filename());
+                    std::string stem = PathToUtf8String(entry.path().stem());
+                    std::vector<std::string> outputs = { "toml/" + stem + ".ylayer" };
+                    if (export_toml) outputs.push_back("toml/" + stem + ".toml");
+                    seen.insert(stage);
+
+                    uint64_t bmpHash = 0;
+                    if (!HashFile(entry.path(), bmpHash)) {
+                        YIMA_LOG_ERROR("Step 1") << "Failed to read: " << entry.path();
+                        return -1;
+                    }
+                    uint64_t key = HashCombine(HashCombine(HashString(stage, PIPELINE_BUILD_SALT), bmpHash), export_toml);
+                    if (incremental && manifest.UpToDate(stage, key, base_dir)) {
+                        YIMA_LOG_INFO("Step 1") << "Up to date: " << entry.path().filename().string();
+                        continue;
+                    }
+
+                    LayerGrid grid;
+                    if (!DecodeBmpLayerFile(entry.path(), grid)) {
+                        YIMA_LOG_ERROR("Step 1") << "Failed to process: " << entry.path();
+                        return -1;
+                    }
+                    fs::path layer_path = output_path / entry.path().filename().replace_extension(".ylayer");
+                    if (!WriteYLayer(layer_path, grid)) {
+                        YIMA_LOG_ERROR("Step 1") << "Failed to write: " << layer_path;
+                        return -1;
+                    }
+                    if (export_toml) {
+                        fs::path out_path = output_path / entry.path().filename().replace_extension(".toml");
+                        std::ofstream out(out_path);
+                        if (out.is_open()) {
+                            out << FormatLayerToml(grid);
+                            out.close();
+                        }
+                    }
+                    manifest.Record(stage, key, base_dir, outputs);
+                }
+            }
+        } else {
+            #ifdef _WIN32
+            YIMA_LOG_ERROR("Step 1") << "Input directory not found: " << WideToUtf8(input_path.wstring());
+            #else
+            YIMA_LOG_ERROR("Step 1") << "Input directory not found: " << input_dir;
+            #endif
+            return -1;
+        }
+
+        // 已从输入目录删除的 BMP 不再保留记录
+        manifest.Prune("extract:", seen);
+        if (!found) YIMA_LOG_WARN("Step 1") << "No .bmp files found in " << input_dir;
+        return 0;
+    } catch (const std::exception& e) {
+        YIMA_LOG_ERROR("Step 1") << "Exception: " << e.what();
+        return -1;
+    }
+}
+
+int ProbeDesign(const std::string& input_path, DesignProbe& probe) {
+    probe = DesignProbe();
+    fs::path input_dir = CreatePathFromUtf8(input_path);
+    std::error_code ec;
+    if (!fs::is_directory(input_dir, ec)) return -1;
+
+    int ref = -1;
+    for (int li = 0; li < LAYER_COUNT; ++li) {
+        LayerProbe& L = probe.layers[li];
+        fs::path p = input_dir / (std::string(LAYER_NAMES[li]) + ".bmp");
+        L.present = fs::is_regular_file(p, ec);
+        if (!L.present) continue;
+        L.valid = ProbeBmpFile(p, L.info);
+        const std::string name = std::string(LAYER_NAMES[li]) + ".bmp";
+        if (!L.valid) {
+            probe.errors.push_back(name + ": not a BMP file");
+            continue;
+        }
+        const BmpProbe& b = L.info;
+        if (b.bitCount != 8) probe.errors.push_back(name + ": bit depth " + std::to_string(b.bitCount) + ", expected 8");
+        if (b.compression != 0) probe.errors.push_back(name + ": compressed BMP (biCompression=" + std::to_string(b.compression) + ") is not supported");
+        if (b.width <= 0 || b.height <= 0) probe.errors.push_back(name + ": invalid size " + std::to_string(b.width) + "x" + std::to_string(b.height));
+        if (b.truncated) probe.errors.push_back(name + ": pixel data is truncated");
+
+        // 与旧版合并逻辑一致, 最后一个存在的图层决定设计尺寸
+        probe.width = b.width;
+        probe.height = b.height;
+        if (ref < 0) {
+            ref = li;
+        } else if (b.width != probe.layers[ref].info.width || b.height != probe.layers[ref].info.height) {
+            const BmpProbe& r = probe.layers[ref].info;
+            probe.mismatches.push_back(name + " is " + std::to_string(b.width) + "x" + std::to_string(b.height) + ", " +
+                                       LAYER_NAMES[ref] + ".bmp is " + std::to_string(r.width) + "x" + std::to_string(r.height));
+        }
+    }
+    if (ref < 0) probe.errors.push_back("no layer BMP found (sema/shaxian/luola/dumu.bmp)");
+    return 0;
+}
+
+// Main logic
+int ProcessBmpTranslation(const std::string& config_path, const std::string& input_path, const std::string& output_path, const PipelineOptions& options) {
+    std::unique_ptr<TraceSession> trace;
+    if (!options.trace_path.empty()) trace = std::make_unique<TraceSession>(CreatePathFromUtf8(options.trace_path));
+    try {
+        auto early_exit = [&](int code) {
+            if (options.report) {
+                *options.report = RunReport();
+                options.report->code = code;
+            }
+            return code;
+        };
+        std::error_code ec;
+        if (!fs::is_directory(CreatePathFromUtf8(input_path), ec)) {
+            YIMA_LOG_ERROR("Pipeline") << "Input directory does not exist: " << input_path;
+            return early_exit(-1);
+        }
+        YimaConfig cfg;
+        if (!LoadYimaConfig(CreatePathFromUtf8(config_path), cfg)) return early_exit(PIPELINE_CONFIG_FAILED);
+        PipelineOptions inner = options;
+        inner.trace_path.clear();   // 本次运行的追踪会话已在上面开启
+        return ProcessBmpTranslation(cfg, input_path, output_path, inner);
+    } catch (const std::exception& e) {
+        YIMA_LOG_ERROR("Pipeline") << "Exception: " << e.what();
+        return -100;
+    }
+}
+
+// 阶段 1-6 的主体, 调用方已持有输出目录
+static int RunPipelineStages(const YimaConfig& cfg, const std::string& input_path, const std::string& output_path, const PipelineOptions& options) {
+    TraceSpan pipeline_span("pipeline", "pipeline");
+    pipeline_span.Detail(output_path);
+    try {
+        // Create fs::path objects from UTF-8 strings with proper encoding handling
+        fs::path output_dir = CreatePathFromUtf8(output_path);
+
+        // 1. 定义中间路径
+        fs::path toml_dir = output_dir / "toml";
+
+        ensure_directory_exists(output_dir);
+        ensure_directory_exists(toml_dir);
+
+        // Convert paths to UTF-8 strings for passing to C-style functions
+        std::string toml_dir_str = PathToUtf8String(toml_dir);
+        std::string output_dir_str = PathToUtf8String(output_dir);
+
+        // 增量构建: 每个阶段的输入键由其全部输入的内容哈希组成, 与清单一致时跳过
+        fs::path manifest_path = output_dir / "build_manifest.toml";
+        BuildManifest manifest;
+        manifest.Load(manifest_path);
+        const bool incremental = options.incremental;
+
+        // 上游阶段输出的哈希 (已记录在清单中时不再重复读取文件)
+        auto output_hash = [&](const std::string& stage, const std::string& rel) -> uint64_t {
+            uint64_t h = 0;
+            if (manifest.OutputHash(stage, rel, h) || HashFile(output_dir / CreatePathFromUtf8(rel), h)) return h;
+            return 0;
+        };
+        auto stage_key = [](const char* stage) { return HashString(stage, PIPELINE_BUILD_SALT); };
+        auto fail = [&](const char* stage, int code) {
+            manifest.Invalidate(stage);
+            manifest.Save(manifest_path);
+            return code;
+        };
+        // 运行一个阶段: 输入未变且输出完好时跳过, 成功后记录输出哈希
+        auto run_stage = [&](int step, const char* stage, uint64_t key, const std::vector<std::string>& outputs,
+                             const std::function<int()>& body) -> int {
+            StageScope scope(options.report, step, stage);
+            TraceSpan span(stage, "stage");
+            if (incremental && manifest.UpToDate(stage, key, output_dir)) {
+                YIMA_LOG_INFO("Step " + std::to_string(step)) << "Up to date, skipped";
+                return scope.Finish(0, true);
+            }
+            int rc = body();
+            if (rc != 0) return scope.Finish(rc);
+            if (!manifest.Record(stage, key, output_dir, outputs)) {
+                YIMA_LOG_WARN("Step " + std::to_string(step)) << "Outputs missing after stage, not recorded";
+            }
+            return scope.Finish(0);
+        };
+
+        // Step 1: Extract BMP to .ylayer
+        YIMA_LOG_INFO("Step 1") << "Extracting BMP layers...";
+        StageScope extract_scope(options.report, 1, "extract");
+        if (extract_scope.Finish(extract_bmp_layers_dir(input_path, toml_dir_str, options.export_toml, manifest, output_dir, incremental)) != 0) {
+            manifest.Save(manifest_path);
+            return -1;
+        }
+
+        // Step 2: Combine layers
+        YIMA_LOG_INFO("Step 2") << "Combining layer files...";
+        {
+            uint64_t key = HashCombine(stage_key("combine"), options.export_toml);
+            for (const char* layer : LAYER_NAMES) {
+                // 与 CombineLayerDir 的读取规则一致: .ylayer 优先, 否则旧版 .toml
+                std::string rel = std::string("toml/") + layer + ".ylayer";
+                uint64_t kind = 1;
+                if (!fs::exists(output_dir / rel)) { rel = std::string("toml/") + layer + ".toml"; kind = 2; }
+                if (!fs::exists(output_dir / rel)) { key = HashCombine(key, 0); continue; }
+                key = HashCombine(HashCombine(key, kind), output_hash(std::string("extract:") + layer + ".bmp", rel));
+            }
+            key = HashCombine(key, cfg.SourceHash("color_to_number.toml"));
+            key = HashCombine(key, cfg.SourceHash("zhenban_qianhou.toml"));
+            std::vector<std::string> outputs = { "toml/combined.ycomb" };
+            if (options.export_toml) outputs.push_back("toml/combined.toml");
+            if (run_stage(2, "combine", key, outputs, [&] { return CombineLayerDir(toml_dir, cfg, options.export_toml); }) != 0)
+                return fail("combine", -2);
+        }
+        const uint64_t combined_hash = output_hash("combine", "toml/combined.ycomb");
+
+        // Step 3: Generate Data CSV
+        YIMA_LOG_INFO("Step 3") << "Generating Data CSV...";
+        if (run_stage(3, "data_csv", HashCombine(stage_key("data_csv"), combined_hash), { "pixel_data.csv" },
+                      [&] { return GenerateDataCsv(toml_dir_str.c_str(), output_dir_str.c_str()); }) != 0)
+            return fail("data_csv", -3);
+
+        static const char* const cmd_files[] = {
+            "dumu_to_cmd.toml", "pre_action_to_cmd.toml", "post_action_to_cmd.toml", "sema_to_cmd.toml",
+            "luola_to_cmd.toml", "line_switch_to_cmd.toml", "shaxian_switch_to_cmd.toml" };
+        uint64_t cmd_key = HashCombine(stage_key("cmd_csv"), combined_hash);
+        for (const char* f : cmd_files) cmd_key = HashCombine(cmd_key, cfg.SourceHash(f));
+        auto txt_key = [&](uint64_t csv_hash) {
+            return HashCombine(HashCombine(HashCombine(stage_key("txt"), csv_hash), cfg.SourceHash("head_tail_cmd.toml")),
+                               options.optimize);
+        };
+        auto compress_key = [&](uint64_t simple_hash) { return HashCombine(stage_key("compress"), simple_hash); };
+
+        // Step 4-6 (增量): 由 combined.ycomb 逐行生成, 只重新生成键变化的行及受影响的压缩片段
+        // 优化遍会跨行合并指令, 各行的输出不再独立, 此时走逐阶段的路径
+        bool rows_written = false;
+        if (incremental && !options.optimize && !manifest.UpToDate("cmd_csv", cmd_key, output_dir)) {
+            YCombinedView grid;
+            if (grid.Open(toml_dir / "combined.ycomb") && CanWriteProgramRows(grid, cfg)) {
+                YIMA_LOG_INFO("Step 4-6") << "Generating commands row by row...";
+                ProgramFileHashes hashes;
+                RowUpdateStats stats;
+                StageScope rows_scope(options.report, 4, "rows");
+                TraceSpan rows_span("rows", "stage");
+                int rc = rows_scope.Finish(WriteProgramRows(grid, cfg, output_dir, toml_dir / "row_index.bin", true, hashes, stats));
+                if (rc != 0) {
+                    manifest.Invalidate("txt");
+                    manifest.Invalidate("compress");
+                    return fail("cmd_csv", rc);
+                }
+                YIMA_LOG_INFO("Step 4-6") << "Regenerated " << stats.regeneratedRows << "/" << stats.rows << " rows, reused "
+                                          << stats.reusedTokens << "/" << stats.tokens << " compressed segments";
+                if (options.report) {
+                    options.report->rowReuse = { stats.reusedIndex, stats.rows, stats.regeneratedRows,
+                                                 (int64_t)stats.tokens, (int64_t)stats.reusedTokens };
+                }
+                manifest.RecordHashes("cmd_csv", cmd_key, { { "pixel_cmd.csv", hashes.csv } });
+                manifest.RecordHashes("txt", txt_key(hashes.csv), { { "cmd_raw.txt", hashes.raw }, { "cmd_simple.txt", hashes.simple } });
+                manifest.RecordHashes("compress", compress_key(hashes.simple), { { "cmd_compressed.txt", hashes.compressed } });
+                rows_written = true;
+            }
+        }
+
+        if (!rows_written) {
+            // Step 4: Generate Command CSV
+            YIMA_LOG_INFO("Step 4") << "Generating Command CSV...";
+            if (run_stage(4, "cmd_csv", cmd_key, { "pixel_cmd.csv" }, [&] { return WriteCmdCsv(toml_dir, output_dir, cfg); }) != 0)
+                return fail("cmd_csv", -4);
+
+            // Step 5: Generate TXT
+            YIMA_LOG_INFO("Step 5") << "Generating TXT from CSV...";
+            if (run_stage(5, "txt", txt_key(output_hash("cmd_csv", "pixel_cmd.csv")), { "cmd_raw.txt", "cmd_simple.txt" },
+                          [&] { return WriteRawTxt(output_dir, output_dir, cfg, options.optimize); }) != 0)
+                return fail("txt", -5);
+
+            // Step 6: Finalize TXT
+            YIMA_LOG_INFO("Step 6") << "Finalizing TXT handle...";
+            if (run_stage(6, "compress", compress_key(output_hash("txt", "cmd_simple.txt")), { "cmd_compressed.txt" },
+                          [&] { return PostProcessTxt(output_dir_str.c_str(), output_dir_str.c_str()); }) != 0)
+                return fail("compress", -6);
+        }
+
+        if (!manifest.Save(manifest_path)) YIMA_LOG_WARN("Pipeline") << "Cannot write " << manifest_path.string();
+        YIMA_LOG_INFO("Pipeline") << "--- All steps completed successfully! ---";
+        return 0;
+
+    } catch (const std::exception& e) {
+        YIMA_LOG_ERROR("Pipeline") << "Exception: " << e.what();
+        return -100;
+    }
+}
+
+// 由输出目录中的文件补全报告中各阶段的输入输出字节数, 行数与指令行数, 以及压缩统计
+static void FillReportFromFiles(RunReport& report, const fs::path& input_dir, const fs::path& output_dir, bool export_toml) {
+    fs::path toml_dir = output_dir / "toml";
+    YCombinedView grid;
+    if (grid.Open(toml_dir / "combined.ycomb")) {
+        report.width = grid.width();
+        report.height = grid.height();
+    }
+    MappedFile simple(output_dir / "cmd_simple.txt"), compressed(output_dir / "cmd_compressed.txt");
+    auto text = [](const MappedFile& f) { return std::string_view((const char*)f.data(), f.size()); };
+    if (report.code == 0) report.compression = AnalyzeCompression(text(simple), text(compressed));
+
+    // 输入目录中的 BMP 及其对应的 .ylayer / .toml
+    uint64_t bmpBytes = 0, layerBytes = 0;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(input_dir, ec)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".bmp") continue;
+        bmpBytes += FileBytes(entry.path());
+        fs::path layer = toml_dir / entry.path().filename();
+        layerBytes += FileBytes(fs::path(layer).replace_extension(".ylayer"));
+        if (export_toml) layerBytes += FileBytes(fs::path(layer).replace_extension(".toml"));
+    }
+    auto sum = [&](std::initializer_list<const char*> rels) {
+        uint64_t total = 0;
+        for (const char* rel : rels) total += FileBytes(output_dir / CreatePathFromUtf8(rel));
+        return total;
+    };
+    const uint64_t combined = sum({ "toml/combined.ycomb" });
+
+    for (StageMetrics& m : report.stages) {
+        bool pixelStage = true;
+        if (m.name == "extract") {
+            m.inputBytes = bmpBytes;
+            m.outputBytes = layerBytes;
+        } else if (m.name == "combine") {
+            m.inputBytes = sum({ "toml/sema.ylayer", "toml/shaxian.ylayer", "toml/luola.ylayer", "toml/dumu.ylayer" });
+            m.outputBytes = combined + (export_toml ? sum({ "toml/combined.toml" }) : 0);
+        } else if (m.name == "data_csv") {
+            m.inputBytes = combined;
+            m.outputBytes = sum({ "pixel_data.csv" });
+        } else if (m.name == "cmd_csv") {
+            m.inputBytes = combined;
+            m.outputBytes = sum({ "pixel_cmd.csv" });
+        } else if (m.name == "rows") {
+            m.inputBytes = combined;
+            m.outputBytes = sum({ "pixel_cmd.csv", "cmd_raw.txt", "cmd_simple.txt", "cmd_compressed.txt", "toml/row_index.bin" });
+            m.commandLines = report.compression.rawLines;
+        } else {
+            pixelStage = false;
+            if (m.name == "txt") {
+                m.inputBytes = sum({ "pixel_cmd.csv" });
+                m.outputBytes = sum({ "cmd_raw.txt", "cmd_simple.txt" });
+                m.commandLines = report.compression.rawLines;
+            } else if (m.name == "compress") {
+                m.inputBytes = simple.size();
+                m.outputBytes = compressed.size();
+                m.commandLines = report.compression.compressedLines;
+            }
+        }
+        if (pixelStage) {
+            m.rows = report.height;
+            m.pixels = (int64_t)report.width * report.height;
+        }
+    }
+}
+
+int ProcessBmpTranslation(const YimaConfig& cfg, const std::string& input_path, const std::string& output_path, const PipelineOptions& options) {
+    std::unique_ptr<TraceSession> trace;
+    if (!options.trace_path.empty()) trace = std::make_unique<TraceSession>(CreatePathFromUtf8(options.trace_path));
+    OutputDirLock dirLock(output_path);
+    if (!dirLock.owned()) {
+        YIMA_LOG_ERROR("Pipeline") << "Output directory is in use by another pipeline: " << output_path;
+        if (options.report) {
+            *options.report = RunReport();
+            options.report->code = PIPELINE_OUTPUT_BUSY;
+        }
+        return PIPELINE_OUTPUT_BUSY;
+    }
+    if (!options.report) return RunPipelineStages(cfg, input_path, output_path, options);
+
+    RunReport& report = *options.report;
+    report = RunReport();
+    report.allocStats = AllocStatsEnabled();
+    StageTimer timer;
+    AllocScope alloc;
+    report.code = RunPipelineStages(cfg, input_path, output_path, options);
+    report.wallMs = timer.WallMs();
+    report.cpuMs = timer.CpuMs();
+    report.alloc = alloc.Finish();
+    try {
+        FillReportFromFiles(report, CreatePathFromUtf8(input_path), CreatePathFromUtf8(output_path), options.export_toml);
+    } catch (const std::exception& e) {
+        YIMA_LOG_WARN("Pipeline") << "Incomplete run report: " << e.what();
+    }
+    return report.code;
+}
+
+// 解码并合并内存中的四个图层, 返回值同 TranslateBmpBuffers
+static int CombineBmpBuffers(const YimaConfig& cfg, const BmpBuffer layers[LAYER_COUNT], CombinedDesign& design) {
+    // Step 1: 解码内存中的 BMP
+    LayerInput inputs[LAYER_COUNT];
+    for (int li = 0; li < LAYER_COUNT; ++li) {
+        if (!layers[li].data) continue;
+        LayerGrid grid;
+        if (!DecodeBmpLayer(layers[li].data, layers[li].size, grid)) {
+            YIMA_LOG_ERROR("Buffers") << "Failed to decode layer: " << LAYER_NAMES[li];
+            return -1;
+        }
+        inputs[li] = MakeLayerInput(LAYER_NAMES[li], std::move(grid));
+    }
+
+    // Step 2: 合并
+    try {
+        CombineLayers(inputs, cfg, design);
+    } catch (const std::exception& e) {
+        YIMA_LOG_ERROR("Buffers") << "Combine failed: " << e.what();
+        return -2;
+    }
+    if (design.width == 0 || design.height == 0) return -5;
+    return 0;
+}
+
+int TranslateBmpBuffers(const YimaConfig& cfg, const BmpBuffer layers[LAYER_COUNT], ProgramOutput& out,
+                        unsigned optimize) {
+    TraceSpan span("translate_buffers", "pipeline");
+    try {
+        CombinedDesign design;
+        int rc = CombineBmpBuffers(cfg, layers, design);
+        if (rc != 0) return rc;
+
+        // Step 4-6: 直接生成指令并压缩
+        YCombinedView grid;
+        grid.Attach(design);
+        out.simple = GenerateSimpleProgram(grid, cfg);
+        if (optimize) out.simple = OptimizeProgram(out.simple, optimize);
+        out.compressed = CompressProgram(out.simple);
+        return 0;
+    } catch (const std::exception& e) {
+        YIMA_LOG_ERROR("Buffers") << "Exception: " << e.what();
+        return -100;
+    }
+}
+
+int StreamBmpTranslation(const YimaConfig& cfg, const BmpBuffer layers[LAYER_COUNT], ProgramFormat format,
+                         size_t chunk_size, const ProgramChunkSink& sink, unsigned optimize) {
+    TraceSpan span("stream_program", "pipeline");
+    try {
+        CombinedDesign design;
+        int rc = CombineBmpBuffers(cfg, layers, design);
+        if (rc != 0) return rc;
+        YCombinedView grid;
+        grid.Attach(design);
+        return StreamProgram(grid, cfg, format, chunk_size, sink, optimize);
+    } catch (const std::exception& e) {
+        YIMA_LOG_ERROR("Stream") << "Exception: " << e.what();
+        return -100;
+    }
+}
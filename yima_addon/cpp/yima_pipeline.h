@@ -0,0 +1,98 @@
+#ifndef YIMA_PIPELINE_H
+#define YIMA_PIPELINE_H
+
+#include "yima_config.h"
+#include "ycombined_format.h"
+#include "program_stream.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "1.bmp_extract/bmp_extract.h"
+
+struct RunReport;
+
+// 流水线运行选项
+struct PipelineOptions {
+    bool export_toml = false;   // 额外导出各图层与 combined 的 .toml 供人工检查
+    bool incremental = true;    // 按 build_manifest.toml 跳过输入未变的阶段; false 时全部重跑 (仍会更新清单)
+    RunReport* report = nullptr;   // 非空时填写各阶段的运行指标 (见 run_report.h)
+    std::string trace_path;        // 非空时记录本次运行的 trace 并写入该文件 (见 yima_trace.h)
+    unsigned optimize = 0;         // cmd_simple.txt / cmd_compressed.txt 使用的优化遍 (见 program_optimize.h), 0 为不优化
+};
+
+// 内存中的单个 BMP 图层 (data 为空表示该图层缺失)
+struct BmpBuffer {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// 内存流水线的输出
+struct ProgramOutput {
+    std::string simple;       // 与 cmd_simple.txt 内容一致
+    std::string compressed;   // 与 cmd_compressed.txt 内容一致
+};
+
+// probeDesign 中单个图层的检查结果
+struct LayerProbe {
+    bool present = false;     // <key>.bmp 是否存在
+    bool valid = false;       // 文件头能否解析
+    BmpProbe info;
+};
+
+// 设计目录的快速检查结果 (仅读取各 BMP 的文件头与调色板)
+struct DesignProbe {
+    LayerProbe layers[LAYER_COUNT];   // 顺序为 sema/shaxian/luola/dumu
+    int width = 0;                    // 流水线实际采用的宽高 (最后一个存在的图层)
+    int height = 0;
+    std::vector<std::string> mismatches;   // 各图层之间的宽高不一致
+    std::vector<std::string> errors;       // 流水线无法处理的图层 (非 8 位, 压缩, 截断等)
+    bool ok() const { return mismatches.empty() && errors.empty(); }
+};
+
+/**
+ * @brief 检查设计目录中 sema/shaxian/luola/dumu 四个 BMP 的尺寸, 位深与调色板, 不解码像素
+ * @return 0: 检查完成 (结果见 probe.ok()), -1: 输入目录不存在
+ */
+int ProbeDesign(const std::string& input_path, DesignProbe& probe);
+
+// 同一输出目录已有流水线在写入 (本进程内的其他线程或 worker_threads)
+constexpr int PIPELINE_OUTPUT_BUSY = -103;
+// 配置目录无法加载 (颜色, 指令映射或首尾配置文件缺失或格式错误)
+constexpr int PIPELINE_CONFIG_FAILED = -104;
+
+// 规范化输出路径 (去掉末尾分隔符, 尽量解析为绝对路径), 用于判断两个输出目录是否相同
+std::string OutputDirKey(const std::string& output_path);
+
+/**
+ * @brief 基于目录的完整流水线 (阶段 1-6), 中间文件写入 output_path
+ * 可在多个线程上并发调用; 同一输出目录同时只允许一个调用写入, 其余立即返回 PIPELINE_OUTPUT_BUSY
+ * 先检查输入目录 (不存在时返回 -1, 同阶段 1), 再加载配置
+ * @return 0: 成功, -1 ~ -6: 对应阶段失败, -100: 异常, -103: 输出目录正被占用, -104: 配置加载失败
+ */
+int ProcessBmpTranslation(const std::string& config_path, const std::string& input_path,
+                          const std::string& output_path, const PipelineOptions& options = PipelineOptions());
+
+/**
+ * @brief 同上, 但使用已加载的配置 (可在多个线程间共享, 只读)
+ */
+int ProcessBmpTranslation(const YimaConfig& cfg, const std::string& input_path,
+                          const std::string& output_path, const PipelineOptions& options = PipelineOptions());
+
+/**
+ * @brief 纯内存流水线: 四个图层 (顺序为 sema/shaxian/luola/dumu) 的 BMP 数据直接生成指令, 不读写任何中间文件
+ * @param optimize 优化遍, 同 PipelineOptions::optimize
+ * @return 0: 成功, -1: BMP 解码失败, -2: 合并失败, -5: 设计为空, -100: 异常
+ */
+int TranslateBmpBuffers(const YimaConfig& cfg, const BmpBuffer layers[LAYER_COUNT], ProgramOutput& out,
+                        unsigned optimize = 0);
+
+/**
+ * @brief 流式内存流水线: 解码并合并后逐行生成指令, 按 chunk_size 切块交给 sink, 不保留完整的程序文本
+ * @param optimize 优化遍, 同 PipelineOptions::optimize (Raw 格式不受影响)
+ * @return 0: 成功, -1/-2/-5: 同 TranslateBmpBuffers, PROGRAM_STREAM_CANCELLED: sink 取消, -100: 异常
+ */
+int StreamBmpTranslation(const YimaConfig& cfg, const BmpBuffer layers[LAYER_COUNT], ProgramFormat format,
+                         size_t chunk_size, const ProgramChunkSink& sink, unsigned optimize = 0);
+
+#endif // YIMA_PIPELINE_H
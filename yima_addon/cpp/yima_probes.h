@@ -0,0 +1,36 @@
+#ifndef YIMA_PROBES_H
+#define YIMA_PROBES_H
+
+/*
+ * USDT 静态探针 (provider 为 yima), 供 perf / bpftrace / SystemTap 在生产环境中挂接
+ *
+ * 只在以 yima_usdt=1 构建时启用 (node-gyp rebuild -- -Dyima_usdt=1, 仅 Linux, 需要 systemtap-sdt-dev 提供 <sys/sdt.h>)。
+ * 启用后每个探针在未挂接时只是一条 nop; 未启用时展开为空, 参数不会被求值。
+ *
+ *   config__load(dir)                     开始加载配置目录
+ *   config__file(path, entries)           加载完一个指令映射文件
+ *   config__done(ok)                      配置加载结束
+ *   stage__start(step)                    阶段开始 (行级增量生成记为 4)
+ *   stage__done(step, code, skipped)      阶段结束
+ *   bmp__decode(bytes, width, height)     解码完一个 BMP 图层
+ *   row(y, width)                         生成完一行指令
+ *   row__reuse(y, csv_bytes)              增量生成时复用了一行
+ *   loop(line, count, length)             压缩输出一个 RS 循环: 起始行, 重复次数, 循环体行数
+ *
+ * 例: bpftrace -e 'usdt:./build/Release/yima_addon.node:yima:loop { @len = hist(arg2); }'
+ */
+
+#if defined(YIMA_USDT)
+#include <sys/sdt.h>
+#define YIMA_PROBE0(name) DTRACE_PROBE(yima, name)
+#define YIMA_PROBE1(name, a) DTRACE_PROBE1(yima, name, a)
+#define YIMA_PROBE2(name, a, b) DTRACE_PROBE2(yima, name, a, b)
+#define YIMA_PROBE3(name, a, b, c) DTRACE_PROBE3(yima, name, a, b, c)
+#else
+#define YIMA_PROBE0(name) do {} while (0)
+#define YIMA_PROBE1(name, a) do {} while (0)
+#define YIMA_PROBE2(name, a, b) do {} while (0)
+#define YIMA_PROBE3(name, a, b, c) do {} while (0)
+#endif
+
+#endif // YIMA_PROBES_H
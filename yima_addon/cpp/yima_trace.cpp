@@ -0,0 +1,229 @@
+#include "yima_trace.h"
+#include "yima_log.h"
+#include "encoding_utils.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <unistd.h>
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    double ts;            // 微秒, 相对会话开始
+    double dur;
+    int argCount;
+    const char* argKeys[2];
+    int64_t argValues[2];
+    std::string detail;
+};
+
+// 每个线程在每个会话中一份事件缓冲区; 只有会话结束时才会被其他线程读取
+struct ThreadBuffer {
+    uint64_t tid = 0;
+    uint64_t session = 0;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+};
+
+std::atomic<uint64_t> g_nextSession{ 0 };
+
+} // namespace
+
+// 一次追踪会话: 参与线程的缓冲区与时间原点
+struct TraceSessionState : std::enable_shared_from_this<TraceSessionState> {
+    uint64_t id = 0;
+    Clock::time_point origin;
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;   // 线程退出后缓冲区仍保留到会话结束
+};
+
+namespace yima_trace_detail {
+thread_local TraceSessionState* t_session = nullptr;
+}
+
+using yima_trace_detail::t_session;
+
+namespace {
+
+uint64_t CurrentThreadId() {
+#ifdef _WIN32
+    return (uint64_t)GetCurrentThreadId();
+#elif defined(__APPLE__)
+    uint64_t tid = 0;
+    pthread_threadid_np(nullptr, &tid);
+    return tid;
+#else
+    return (uint64_t)syscall(SYS_gettid);
+#endif
+}
+
+uint64_t ProcessId() {
+#ifdef _WIN32
+    return (uint64_t)GetCurrentProcessId();
+#else
+    return (uint64_t)getpid();
+#endif
+}
+
+ThreadBuffer& LocalBuffer(TraceSessionState& session) {
+    thread_local std::shared_ptr<ThreadBuffer> local;
+    if (local && local->session == session.id) return *local;
+    // 本线程在该会话中第一次记录: 新建缓冲区并登记 (旧缓冲区仍由其会话持有)
+    local = std::make_shared<ThreadBuffer>();
+    local->tid = CurrentThreadId();
+    local->session = session.id;
+    std::lock_guard<std::mutex> lock(session.mutex);
+    session.buffers.push_back(local);
+    return *local;
+}
+
+double NowUs(const TraceSessionState& session) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - session.origin).count();
+}
+
+void AppendJsonString(std::string& out, const char* s, size_t n) {
+    out += '"';
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += (char)c;
+        } else if (c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += (char)c;
+        }
+    }
+    out += '"';
+}
+
+void AppendJsonString(std::string& out, const char* s) {
+    AppendJsonString(out, s, std::char_traits<char>::length(s));
+}
+
+} // namespace
+
+void TraceSpan::Begin(const char* name, const char* category) {
+    active_ = true;
+    session_ = t_session->id;
+    name_ = name;
+    category_ = category;
+    start_ = NowUs(*t_session);
+}
+
+void TraceSpan::End() {
+    TraceSessionState* session = t_session;
+    if (!session || session->id != session_) return;
+    double end = NowUs(*session);
+    ThreadBuffer& buffer = LocalBuffer(*session);
+    TraceEvent e{ name_, category_, start_, end - start_, argCount_, { argKeys_[0], argKeys_[1] },
+                  { argValues_[0], argValues_[1] }, std::move(detail_) };
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back(std::move(e));
+}
+
+namespace {
+
+// 取出会话中全部事件, 生成 trace JSON ({"traceEvents": [...]})
+std::string SerializeTrace(TraceSessionState& session) {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        buffers.swap(session.buffers);
+    }
+
+    const uint64_t pid = ProcessId();
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    char num[96];
+    for (const auto& b : buffers) {
+        std::lock_guard<std::mutex> lock(b->mutex);
+        for (const TraceEvent& e : b->events) {
+            if (!first) out += ",\n";
+            first = false;
+            out += "{\"ph\":\"X\",\"name\":";
+            AppendJsonString(out, e.name);
+            out += ",\"cat\":";
+            AppendJsonString(out, e.category);
+            std::snprintf(num, sizeof(num), ",\"pid\":%llu,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f",
+                          (unsigned long long)pid, (unsigned long long)b->tid, e.ts, e.dur);
+            out += num;
+            if (e.argCount > 0 || !e.detail.empty()) {
+                out += ",\"args\":{";
+                for (int i = 0; i < e.argCount; ++i) {
+                    if (i) out += ',';
+                    AppendJsonString(out, e.argKeys[i]);
+                    out += ':';
+                    out += std::to_string(e.argValues[i]);
+                }
+                if (!e.detail.empty()) {
+                    if (e.argCount) out += ',';
+                    out += "\"detail\":";
+                    AppendJsonString(out, e.detail.data(), e.detail.size());
+                }
+                out += '}';
+            }
+            out += '}';
+        }
+        b->events.clear();
+        b->events.shrink_to_fit();
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+} // namespace
+
+TraceSession::TraceSession(const std::filesystem::path& file) : file_(file) {
+    if (t_session) {
+        YIMA_LOG_WARN("Trace") << "Tracing is already active on this thread; events are recorded in the outer trace and "
+                               << PathToUtf8String(file_) << " is not written";
+        return;
+    }
+    state_ = std::make_shared<TraceSessionState>();
+    state_->id = ++g_nextSession;
+    state_->origin = Clock::now();
+    owner_ = true;
+    t_session = state_.get();
+}
+
+TraceSession::~TraceSession() {
+    if (!owner_) return;
+    t_session = nullptr;
+    std::string json = SerializeTrace(*state_);
+    std::ofstream out(file_, std::ios::binary);
+    if (out.is_open()) out.write(json.data(), (std::streamsize)json.size());
+    if (!out.good()) YIMA_LOG_WARN("Trace") << "Cannot write " << PathToUtf8String(file_);
+}
+
+std::shared_ptr<TraceSessionState> CurrentTraceSession() {
+    return t_session ? t_session->shared_from_this() : nullptr;
+}
+
+TraceScope::TraceScope(std::shared_ptr<TraceSessionState> session)
+    : session_(std::move(session)), previous_(t_session) {
+    t_session = session_.get();
+}
+
+TraceScope::~TraceScope() {
+    t_session = previous_;
+}
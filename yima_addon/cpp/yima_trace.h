@@ -0,0 +1,101 @@
+#ifndef YIMA_TRACE_H
+#define YIMA_TRACE_H
+
+/*
+ * Chrome trace-event 格式的运行追踪 (可用 Perfetto 或 chrome://tracing 打开)
+ *
+ * TraceSpan 记录一段耗时 (complete 事件, 带线程 ID 与至多两个数值参数)。
+ * 追踪会话按线程生效: TraceSession 所在的线程, 以及经 TraceScope 加入该会话的线程 (如批处理工作线程)
+ * 的事件写入该会话自己的缓冲区与文件; 不同线程上的会话 (如并发的两次流水线运行) 互不影响。
+ * 未在会话内时构造与析构只读取一次线程局部指针; 记录时事件写入各线程自己的缓冲区, 线程之间不竞争。
+ */
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+struct TraceSessionState;
+
+namespace yima_trace_detail {
+extern thread_local TraceSessionState* t_session;
+}
+
+// 当前线程是否在追踪会话内
+inline bool TraceEnabled() {
+    return yima_trace_detail::t_session != nullptr;
+}
+
+// 一段耗时; name / category / 参数名须为字符串字面量 (只保存指针)
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category) {
+        if (TraceEnabled()) Begin(name, category);
+    }
+    ~TraceSpan() {
+        if (active_) End();
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void Arg(const char* key, int64_t value) {
+        if (!active_ || argCount_ >= 2) return;
+        argKeys_[argCount_] = key;
+        argValues_[argCount_++] = value;
+    }
+    // 附加一段文本 (如文件名), 只在记录时复制; 需要构造文本时调用方先检查 TraceEnabled()
+    void Detail(const std::string& text) {
+        if (active_) detail_ = text;
+    }
+
+private:
+    void Begin(const char* name, const char* category);
+    void End();
+
+    bool active_ = false;
+    uint64_t session_ = 0;   // 开始时所在的会话; 结束时已不在该会话内则丢弃
+    const char* name_ = nullptr;
+    const char* category_ = nullptr;
+    double start_ = 0;
+    int argCount_ = 0;
+    const char* argKeys_[2] = {};
+    int64_t argValues_[2] = {};
+    std::string detail_;
+};
+
+/**
+ * 在作用域内为当前线程开启一次追踪会话, 结束时写出 file
+ * 当前线程已在会话内 (嵌套调用) 时不另开会话: 事件并入外层会话, 不写 file, 并记录一条警告
+ */
+class TraceSession {
+public:
+    explicit TraceSession(const std::filesystem::path& file);
+    ~TraceSession();
+    TraceSession(const TraceSession&) = delete;
+    TraceSession& operator=(const TraceSession&) = delete;
+
+    bool owner() const { return owner_; }
+
+private:
+    std::filesystem::path file_;
+    std::shared_ptr<TraceSessionState> state_;
+    bool owner_ = false;
+};
+
+// 当前线程所在的会话 (没有时为空); 启动新线程时传给 TraceScope, 使其事件写入同一会话
+std::shared_ptr<TraceSessionState> CurrentTraceSession();
+
+// 在作用域内让当前线程加入指定会话 (为空时不记录)
+class TraceScope {
+public:
+    explicit TraceScope(std::shared_ptr<TraceSessionState> session);
+    ~TraceScope();
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    std::shared_ptr<TraceSessionState> session_;
+    TraceSessionState* previous_;
+};
+
+#endif // YIMA_TRACE_H
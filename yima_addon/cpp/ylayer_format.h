@@ -0,0 +1,113 @@
+#ifndef YLAYER_FORMAT_H
+#define YLAYER_FORMAT_H
+
+/*
+ * .ylayer 二进制图层格式 (阶段 1 输出, 阶段 2 输入)
+ *
+ *   [YLayerHeader 24 字节]
+ *   [调色板 paletteCount x {r, g, b, 0}]   按 #RRGGBB 字典序排列, 仅包含实际使用的颜色
+ *   [像素索引 width x height 字节]         行主序, 第 0 行对应 TOML 中的 y = 1, 第 0 列对应 x = 1
+ *
+ * 所有整数均为小端序, 文件可直接内存映射后按偏移访问。
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include "mapped_file.h"
+
+#pragma pack(push, 1)
+struct YLayerHeader {
+    char     magic[4];      // "YLYR"
+    uint16_t version;       // 当前为 1
+    uint16_t paletteCount;  // 1..256
+    uint32_t width;
+    uint32_t height;
+    uint32_t dataOffset;    // 像素索引起始偏移
+    uint32_t reserved;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(YLayerHeader) == 24, "YLayerHeader must be 24 bytes");
+
+constexpr uint16_t YLAYER_VERSION = 1;
+
+struct LayerColor {
+    uint8_t r = 0, g = 0, b = 0, a = 0;
+};
+
+// 解码后的单个图层: 紧凑调色板 + 每像素一个字节的调色板索引
+struct LayerGrid {
+    int32_t width = 0;
+    int32_t height = 0;
+    std::vector<LayerColor> palette;
+    std::vector<uint8_t> indices;
+
+    uint8_t At(int x, int y) const { return indices[(size_t)(y - 1) * width + (x - 1)]; }  // 1 起始坐标
+};
+
+// 颜色转为 "#RRGGBB" (大写), 与旧版 TOML 中的写法一致
+inline std::string LayerColorHex(const LayerColor& c) {
+    static const char digits[] = "0123456789ABCDEF";
+    char buf[8] = { '#',
+        digits[c.r >> 4], digits[c.r & 15],
+        digits[c.g >> 4], digits[c.g & 15],
+        digits[c.b >> 4], digits[c.b & 15], '\0' };
+    return std::string(buf, 7);
+}
+
+inline bool WriteYLayer(const std::filesystem::path& p, const LayerGrid& grid) {
+    YLayerHeader h;
+    std::memcpy(h.magic, "YLYR", 4);
+    h.version = YLAYER_VERSION;
+    h.paletteCount = (uint16_t)grid.palette.size();
+    h.width = (uint32_t)grid.width;
+    h.height = (uint32_t)grid.height;
+    h.dataOffset = (uint32_t)(sizeof(YLayerHeader) + grid.palette.size() * sizeof(LayerColor));
+    h.reserved = 0;
+
+    std::ofstream out(p, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.write(reinterpret_cast<const char*>(grid.palette.data()), grid.palette.size() * sizeof(LayerColor));
+    out.write(reinterpret_cast<const char*>(grid.indices.data()), grid.indices.size());
+    return out.good();
+}
+
+// 内存映射后的只读视图, 不复制像素数据
+class YLayerView {
+public:
+    bool Open(const std::filesystem::path& p) {
+        if (!file_.Open(p)) return false;
+        const uint8_t* d = file_.data();
+        size_t n = file_.size();
+        if (n < sizeof(YLayerHeader)) return false;
+        std::memcpy(&header_, d, sizeof(header_));
+        if (std::memcmp(header_.magic, "YLYR", 4) != 0 || header_.version != YLAYER_VERSION) return false;
+        size_t paletteEnd = sizeof(YLayerHeader) + (size_t)header_.paletteCount * sizeof(LayerColor);
+        size_t pixels = (size_t)header_.width * header_.height;
+        if (header_.dataOffset < paletteEnd || header_.dataOffset + pixels > n) return false;
+        palette_ = reinterpret_cast<const LayerColor*>(d + sizeof(YLayerHeader));
+        indices_ = d + header_.dataOffset;
+        return true;
+    }
+
+    int width() const { return (int)header_.width; }
+    int height() const { return (int)header_.height; }
+    size_t paletteCount() const { return header_.paletteCount; }
+    const LayerColor& color(size_t i) const { return palette_[i]; }
+    const LayerColor* palette() const { return palette_; }
+    const uint8_t* indices() const { return indices_; }
+    uint8_t At(int x, int y) const { return indices_[(size_t)(y - 1) * header_.width + (x - 1)]; }  // 1 起始坐标
+
+private:
+    MappedFile file_;
+    YLayerHeader header_{};
+    const LayerColor* palette_ = nullptr;
+    const uint8_t* indices_ = nullptr;
+};
+
+#endif // YLAYER_FORMAT_H
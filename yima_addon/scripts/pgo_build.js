@@ -0,0 +1,57 @@
+// 两步 PGO 构建 (仅 Linux, GCC):
+//   1. 以 yima_profile=pgo-generate 构建, 插桩后的 yima_core 同时链接进 yima_bench / yima_cli
+//   2. 在基准语料上训练: yima_bench 跑示例设计与各合成图案, yima_cli 以增量与全量方式跑一批合成设计
+//   3. 以 yima_profile=pgo-use 重新构建, 使用 pgo-data 中的剖析数据
+// 剖析数据按目标文件路径保存, 两次构建必须在同一目录下进行。
+const { spawnSync } = require('child_process')
+const fs = require('fs')
+const os = require('os')
+const path = require('path')
+
+const root = path.join(__dirname, '..')
+const pgoDir = path.join(root, 'pgo-data')
+const bin = path.join(root, 'build', 'Release')
+const work = path.join(os.tmpdir(), 'yima_pgo')
+const config = 'resources/config'
+const patterns = ['random', 'striped', 'tiled', 'sparse', 'yarn']
+
+function run (cmd, args) {
+  console.log(`== ${cmd} ${args.join(' ')}`)
+  const r = spawnSync(cmd, args, { cwd: root, stdio: 'inherit' })
+  if (r.status !== 0) {
+    console.error(`${cmd} failed (${r.error ? r.error.message : 'exit ' + r.status})`)
+    process.exit(1)
+  }
+}
+
+function build (profile) {
+  run('node-gyp', ['rebuild', '--', `-Dyima_profile=${profile}`])
+}
+
+function train () {
+  const bench = path.join(bin, 'yima_bench')
+  const cli = path.join(bin, 'yima_cli')
+  const benchArgs = ['--config', config, '--sizes', '100x500', '--repeat', '1',
+    '--work', path.join(work, 'bench'), '--out', path.join(work, 'bench.json')]
+  run(bench, [...benchArgs, '--input', 'resources/input'])
+  for (const pattern of patterns) run(bench, [...benchArgs, '--pattern', pattern])
+
+  const designs = path.join(work, 'designs')
+  for (const pattern of patterns) {
+    run(cli, ['generate', '--config', config, '--size', '100x400', '--pattern', pattern, '--seed', '1',
+      path.join(designs, pattern)])
+  }
+  run(cli, ['--config', config, '--batch', designs, path.join(work, 'rows')])
+  run(cli, ['--config', config, '--full', '--batch', designs, path.join(work, 'full')])
+}
+
+if (process.platform !== 'linux') {
+  console.error('PGO builds are only set up for Linux (GCC)')
+  process.exit(1)
+}
+fs.rmSync(pgoDir, { recursive: true, force: true })
+fs.rmSync(work, { recursive: true, force: true })
+build('pgo-generate')
+train()
+build('pgo-use')
+console.log(`profile data: ${pgoDir}`)
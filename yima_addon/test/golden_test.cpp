@@ -0,0 +1,497 @@
+/*
+ * 输出回归测试: 在一组设计上运行流水线, 将输出文件的哈希与 test/golden/outputs.txt 中记录的值比较
+ *
+ *   yima_golden_test [--config <dir>] [--input <dir>] [--golden <file>] [--work <dir>] [--update]
+ *
+ * 语料为 input 中的示例设计, 以及设计生成器按每种图案 x 每个 line_sign 循环长度生成的小设计 (固定种子)。
+ * 每个设计检查:
+ *   1. 全量运行 (逐阶段写文件) 的 pixel_data.csv / pixel_cmd.csv / cmd_simple.txt / cmd_compressed.txt 与记录一致
+ *   2. 在新目录中增量运行 (行级生成) 的输出与全量运行逐字节一致; 之后修改输入副本中一行中间的几个像素,
+ *      在同一目录再次增量运行: 运行报告显示复用了行索引且只重新生成部分行, 输出与修改后设计的全量运行一致
+ *   3. 纯内存流水线 TranslateBmpBuffers 的 simple / compressed 与文件一致
+ *   4. 流式展开 cmd_compressed.txt 后与 cmd_simple.txt 的指令行一致, 且两者模拟执行的指令数与最终寄存器相同
+ *   5. 把 cmd_simple.txt 逐行推入 StreamingCompressor 的结果与 cmd_compressed.txt 一致
+ *   6. 启用优化遍运行时, cmd_simple.txt 与 OptimizeProgram / 逐行推入 ProgramOptimizer / 内存流水线的结果一致,
+ *      压缩输出展开后还原优化后的程序, 且模拟执行的外部效果与最终寄存器和未优化的程序相同
+ *   7. DesignSession 打开设计后依次: 修改 sema 的几个像素 (只重新生成部分行, 不完整合并), 修改每个图层的一段像素,
+ *      在 sema 调色板末尾追加配置中的新颜色并使用; 每次 Regenerate 的结果与按会话图层重新编码的
+ *      BMP 运行 TranslateBmpBuffers 的结果一致
+ * 另外在几段固定的小程序上检查优化遍的输出 (kOptimizeCases), 覆盖语料中不出现的情形。
+ * --update 按当前输出重写记录文件 (只应在确认输出变化是预期行为时使用)。
+ * 默认路径相对于 yima_addon 目录。全部通过返回 0, 有失败返回 1, 参数错误返回 2。
+ */
+
+#include "yima_pipeline.h"
+#include "content_hash.h"
+#include "design_generator.h"
+#include "design_session.h"
+#include "encoding_utils.h"
+#include "mapped_file.h"
+#include "program_emulator.h"
+#include "program_optimize.h"
+#include "run_report.h"
+#include "yima_log.h"
+#include "1.bmp_extract/bmp_extract.h"
+#include "6.txt_handle/txt_handle.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const kOutputs[] = { "pixel_data.csv", "pixel_cmd.csv", "cmd_simple.txt", "cmd_compressed.txt" };
+
+// 生成语料的参数; 修改后需要 --update
+constexpr int CORPUS_WIDTH = 40;
+constexpr int CORPUS_HEIGHT = 60;
+constexpr uint64_t CORPUS_SEED = 7;
+
+struct TestOptions {
+    std::string config = "resources/config";
+    std::string input = "resources/input";
+    std::string golden = "test/golden/outputs.txt";
+    std::string work;
+    bool update = false;
+};
+
+struct Design {
+    std::string name;
+    fs::path dir;
+};
+
+using GoldenMap = std::map<std::string, std::string>;   // "design file" -> 哈希
+
+class Failures {
+public:
+    void Add(const std::string& design, const std::string& message) {
+        std::fprintf(stderr, "FAIL %s: %s\n", design.c_str(), message.c_str());
+        ++count_;
+    }
+    int count() const { return count_; }
+
+private:
+    int count_ = 0;
+};
+
+bool ParseArgs(const std::vector<std::string>& args, TestOptions& opts) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& a = args[i];
+        if (a == "--update") {
+            opts.update = true;
+            continue;
+        }
+        if (i + 1 >= args.size()) return false;
+        const std::string& v = args[++i];
+        if (a == "--config") opts.config = v;
+        else if (a == "--input") opts.input = v;
+        else if (a == "--golden") opts.golden = v;
+        else if (a == "--work") opts.work = v;
+        else return false;
+    }
+    if (opts.work.empty()) opts.work = PathToUtf8String(fs::temp_directory_path() / "yima_golden");
+    return true;
+}
+
+GoldenMap LoadGoldens(const fs::path& p) {
+    GoldenMap goldens;
+    std::ifstream in(p);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ss(line);
+        std::string design, file, hash;
+        if (ss >> design >> file >> hash) goldens[design + " " + file] = hash;
+    }
+    return goldens;
+}
+
+bool SaveGoldens(const fs::path& p, const GoldenMap& goldens) {
+    std::ofstream out(p, std::ios::binary | std::ios::trunc);
+    out << "# design file fnv1a64 (yima_golden_test --update)\n";
+    for (const auto& [key, hash] : goldens) out << key << " " << hash << "\n";
+    return out.good();
+}
+
+std::string ReadText(const fs::path& p) {
+    MappedFile f(p);
+    return f.IsOpen() ? std::string(reinterpret_cast<const char*>(f.data()), f.size()) : std::string();
+}
+
+std::string FileHash(const fs::path& p) {
+    uint64_t h = 0;
+    return HashFile(p, h) ? HashToHex(h) : std::string("missing");
+}
+
+// 示例设计 + 每种图案 x 每个 line_sign 循环长度的合成设计
+bool BuildCorpus(const TestOptions& opts, const YimaConfig& cfg, std::vector<Design>& corpus) {
+    corpus.push_back({ "sample", CreatePathFromUtf8(opts.input) });
+    const DesignPattern patterns[] = { DesignPattern::Random, DesignPattern::Striped, DesignPattern::Tiled,
+                                       DesignPattern::Sparse, DesignPattern::YarnSwitch };
+    for (DesignPattern pattern : patterns) {
+        for (int types : SignCycleTypes(cfg)) {
+            DesignSpec spec;
+            spec.width = CORPUS_WIDTH;
+            spec.height = CORPUS_HEIGHT;
+            spec.pattern = pattern;
+            spec.seed = CORPUS_SEED;
+            spec.shaxianTypes = types;
+            std::string name = std::string(DesignPatternName(pattern)) + "_s" + std::to_string(types);
+            fs::path dir = CreatePathFromUtf8(opts.work) / "designs" / name;
+            GeneratedDesign design;
+            if (GenerateDesign(cfg, spec, design) != 0 || WriteDesignDir(design, dir) != 0) {
+                std::fprintf(stderr, "cannot generate design %s\n", name.c_str());
+                return false;
+            }
+            corpus.push_back({ name, dir });
+        }
+    }
+    return true;
+}
+
+// 在第一个有两种以上颜色的图层中, 把中间一行正中的三个像素改为调色板中的下一种颜色; 没有这样的图层时返回 false
+bool EditDesign(const fs::path& dir) {
+    for (const char* name : LAYER_NAMES) {
+        const fs::path p = dir / (std::string(name) + ".bmp");
+        LayerGrid grid;
+        if (!fs::exists(p) || !DecodeBmpLayerFile(p, grid) || grid.palette.size() < 2) continue;
+        const size_t y = (size_t)grid.height / 2;
+        for (int x = std::max(0, grid.width / 2 - 1); x <= grid.width / 2 && x < grid.width; ++x) {
+            uint8_t& index = grid.indices[y * (size_t)grid.width + (size_t)x];
+            index = (uint8_t)((index + 1) % grid.palette.size());
+        }
+        const std::vector<uint8_t> bytes = EncodeBmpLayer(grid);
+        std::ofstream out(p, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+        return out.good();
+    }
+    return false;
+}
+
+// 2 (续). 修改 input (rowsDir 的输入副本) 后在 rowsDir 中再次增量运行, 应复用未变的行
+void CheckRowReuse(const YimaConfig& cfg, const Design& d, const fs::path& input, const fs::path& rowsDir,
+                   const fs::path& work, Failures& failures) {
+    if (!EditDesign(input)) return;
+    RunReport report;
+    PipelineOptions incremental;
+    incremental.report = &report;
+    int rc = ProcessBmpTranslation(cfg, PathToUtf8String(input), PathToUtf8String(rowsDir), incremental);
+    const fs::path editedDir = work / "edited" / d.name;
+    PipelineOptions full;
+    full.incremental = false;
+    int fullRc = ProcessBmpTranslation(cfg, PathToUtf8String(input), PathToUtf8String(editedDir), full);
+    if (rc != 0 || fullRc != 0) {
+        failures.Add(d.name, "runs after editing pixels returned " + std::to_string(rc) + " / " + std::to_string(fullRc));
+        return;
+    }
+    for (const char* file : kOutputs) {
+        if (FileHash(rowsDir / file) != FileHash(editedDir / file)) {
+            failures.Add(d.name, std::string(file) + ": incremental run after editing pixels differs from a full run");
+        }
+    }
+    const RowReuseMetrics& r = report.rowReuse;
+    if (!r.reusedIndex || r.regeneratedRows <= 0 || r.regeneratedRows >= r.rows || r.reusedSegments <= 0) {
+        failures.Add(d.name, "editing one row regenerated " + std::to_string(r.regeneratedRows) + "/" +
+                     std::to_string(r.rows) + " rows and reused " + std::to_string(r.reusedSegments) + "/" +
+                     std::to_string(r.segments) + " segments" + (r.reusedIndex ? "" : " (row index not reused)"));
+    }
+}
+
+void CheckDesign(const YimaConfig& cfg, const Design& d, const fs::path& work, GoldenMap& goldens, bool update,
+                 Failures& failures) {
+    const fs::path fullDir = work / "full" / d.name;
+    const fs::path rowsDir = work / "rows" / d.name;
+    const std::string input = PathToUtf8String(d.dir);
+
+    // 1. 全量运行与记录比较
+    PipelineOptions full;
+    full.incremental = false;
+    int rc = ProcessBmpTranslation(cfg, input, PathToUtf8String(fullDir), full);
+    if (rc != 0) {
+        failures.Add(d.name, "full run returned " + std::to_string(rc));
+        return;
+    }
+    for (const char* file : kOutputs) {
+        std::string key = d.name + " " + file;
+        std::string hash = FileHash(fullDir / file);
+        if (update) {
+            goldens[key] = hash;
+            continue;
+        }
+        auto it = goldens.find(key);
+        if (it == goldens.end()) failures.Add(d.name, std::string(file) + ": no golden hash (run with --update)");
+        else if (it->second != hash) failures.Add(d.name, std::string(file) + ": hash " + hash + ", golden " + it->second);
+    }
+
+    // 2. 增量 (行级) 运行与全量运行一致 (输入为副本, 之后在其中修改像素)
+    const fs::path rowsInput = work / "rows_input" / d.name;
+    fs::create_directories(rowsInput);
+    for (const char* name : LAYER_NAMES) {
+        const fs::path p = d.dir / (std::string(name) + ".bmp");
+        if (fs::exists(p)) fs::copy_file(p, rowsInput / p.filename(), fs::copy_options::overwrite_existing);
+    }
+    rc = ProcessBmpTranslation(cfg, PathToUtf8String(rowsInput), PathToUtf8String(rowsDir));
+    if (rc != 0) {
+        failures.Add(d.name, "incremental run returned " + std::to_string(rc));
+    } else {
+        for (const char* file : kOutputs) {
+            if (FileHash(rowsDir / file) != FileHash(fullDir / file)) {
+                failures.Add(d.name, std::string(file) + ": incremental output differs from full run");
+            }
+        }
+        CheckRowReuse(cfg, d, rowsInput, rowsDir, work, failures);
+    }
+
+    // 3. 纯内存流水线与文件一致
+    std::string simple = ReadText(fullDir / "cmd_simple.txt");
+    std::string compressed = ReadText(fullDir / "cmd_compressed.txt");
+    std::vector<std::vector<uint8_t>> bmp(LAYER_COUNT);
+    BmpBuffer buffers[LAYER_COUNT];
+    for (int i = 0; i < LAYER_COUNT; ++i) {
+        fs::path p = d.dir / (std::string(LAYER_NAMES[i]) + ".bmp");
+        if (!fs::exists(p)) continue;
+        std::string bytes = ReadText(p);
+        bmp[i].assign(bytes.begin(), bytes.end());
+        buffers[i].data = bmp[i].data();
+        buffers[i].size = bmp[i].size();
+    }
+    ProgramOutput program;
+    rc = TranslateBmpBuffers(cfg, buffers, program);
+    if (rc != 0) failures.Add(d.name, "TranslateBmpBuffers returned " + std::to_string(rc));
+    else if (program.simple != simple) failures.Add(d.name, "in-memory simple program differs from cmd_simple.txt");
+    else if (program.compressed != compressed) failures.Add(d.name, "in-memory compressed program differs from cmd_compressed.txt");
+
+    // 4. 展开 RS/RE 后还原 cmd_simple.txt 的指令行, 模拟执行的结果相同
+    ProgramDiff diff;
+    if (!CompareExpanded(compressed, simple, diff)) {
+        failures.Add(d.name, diff.error.empty()
+            ? "expanding cmd_compressed.txt differs from cmd_simple.txt at line " + std::to_string(diff.line)
+            : "cmd_compressed.txt: " + diff.error);
+    }
+    EmulatorResult runSimple, runCompressed;
+    if (EmulateProgram(simple, EmulatorOptions(), runSimple) != 0) {
+        failures.Add(d.name, "emulating cmd_simple.txt: " + runSimple.error);
+    } else if (EmulateProgram(compressed, EmulatorOptions(), runCompressed) != 0) {
+        failures.Add(d.name, "emulating cmd_compressed.txt: " + runCompressed.error);
+    } else if (runCompressed.steps != runSimple.steps || runCompressed.registers != runSimple.registers) {
+        failures.Add(d.name, "emulating cmd_compressed.txt gives a different result from cmd_simple.txt");
+    }
+
+    // 5. 逐行推入 StreamingCompressor 的结果与文件一致
+    StreamingCompressor streaming;
+    std::string streamed;
+    for (std::string_view line : SplitProgramLines(simple)) {
+        streaming.Push(std::string(line) + "\n");
+        streaming.Drain(streamed);
+    }
+    streaming.Finish(streamed);
+    if (streamed != compressed) failures.Add(d.name, "line-by-line StreamingCompressor output differs from cmd_compressed.txt");
+
+    // 6. 优化遍: 各条路径结果一致, 且与未优化的程序效果相同
+    const fs::path optDir = work / "optimized" / d.name;
+    PipelineOptions optimized;
+    optimized.optimize = PROGRAM_PASS_ALL;
+    rc = ProcessBmpTranslation(cfg, input, PathToUtf8String(optDir), optimized);
+    if (rc != 0) {
+        failures.Add(d.name, "optimized run returned " + std::to_string(rc));
+        return;
+    }
+    const std::string optSimple = ReadText(optDir / "cmd_simple.txt");
+    const std::string optCompressed = ReadText(optDir / "cmd_compressed.txt");
+    if (OptimizeProgram(simple) != optSimple) failures.Add(d.name, "OptimizeProgram(cmd_simple.txt) differs from the optimized run");
+    ProgramOptimizer optimizer;
+    std::string pushed;
+    for (std::string_view line : SplitProgramLines(simple)) optimizer.Push(std::string(line) + "\n", pushed);
+    optimizer.Finish(pushed);
+    if (pushed != optSimple) failures.Add(d.name, "line-by-line ProgramOptimizer output differs from the optimized run");
+    ProgramOutput optProgram;
+    rc = TranslateBmpBuffers(cfg, buffers, optProgram, PROGRAM_PASS_ALL);
+    if (rc != 0 || optProgram.simple != optSimple || optProgram.compressed != optCompressed) {
+        failures.Add(d.name, "optimized in-memory program differs from the optimized run");
+    }
+    if (!CompareExpanded(optCompressed, optSimple, diff)) failures.Add(d.name, "optimized cmd_compressed.txt does not expand to cmd_simple.txt");
+    EmulatorResult runOptimized;
+    if (EmulateProgram(optSimple, EmulatorOptions(), runOptimized) != 0) {
+        failures.Add(d.name, "emulating optimized cmd_simple.txt: " + runOptimized.error);
+    } else if (!SameEffects(runOptimized, runSimple)) {
+        failures.Add(d.name, "optimized program behaves differently from cmd_simple.txt");
+    } else if (runOptimized.steps > runSimple.steps) {
+        failures.Add(d.name, "optimized program executes more instructions than cmd_simple.txt");
+    }
+}
+
+// 7. 会话编辑后的增量生成与纯内存流水线一致
+void CheckSession(const std::shared_ptr<const YimaConfig>& cfg, const Design& d, Failures& failures) {
+    DesignSession session;
+    SessionStats stats;
+    int rc = session.OpenDir(cfg, PathToUtf8String(d.dir));
+    if (rc == 0) rc = session.Regenerate(stats);
+    if (rc != 0) {
+        failures.Add(d.name, "DesignSession returned " + std::to_string(rc));
+        return;
+    }
+    auto compare = [&](const char* step) {
+        std::vector<uint8_t> bmp[LAYER_COUNT];
+        BmpBuffer buffers[LAYER_COUNT];
+        for (int i = 0; i < LAYER_COUNT; ++i) {
+            if (!session.HasLayer(i)) continue;
+            bmp[i] = EncodeBmpLayer(session.Layer(i));
+            buffers[i].data = bmp[i].data();
+            buffers[i].size = bmp[i].size();
+        }
+        ProgramOutput expected;
+        std::shared_ptr<const std::string> simple, compressed;
+        session.Program(simple, compressed);
+        if (TranslateBmpBuffers(*cfg, buffers, expected) != 0 || !simple || *simple != expected.simple ||
+            *compressed != expected.compressed) {
+            failures.Add(d.name, std::string("DesignSession program differs from TranslateBmpBuffers after ") + step);
+        }
+    };
+    // 把 (x, y) 起 w 个像素改为同一行中右侧相邻像素的索引 (只使用图层已用到的颜色)
+    auto shift = [&](int layer, int x, int y, int w) {
+        const LayerGrid& grid = session.Layer(layer);
+        std::vector<uint8_t> data((size_t)w);
+        for (int i = 0; i < w; ++i) data[(size_t)i] = grid.indices[(size_t)y * grid.width + (size_t)((x + i + 1) % grid.width)];
+        return session.SetPixels(layer, x, y, w, 1, data.data(), data.size());
+    };
+    compare("opening");
+    const int w = session.width(), h = session.height();
+    if (!session.HasLayer(LAYER_SEMA) || w < 4 || h < 2) return;
+
+    rc = shift(LAYER_SEMA, w / 3, h / 3, 3);
+    if (rc == 0) rc = session.Regenerate(stats);
+    if (rc != 0 || stats.recombined || stats.regeneratedRows >= stats.rows) {
+        failures.Add(d.name, "editing sema pixels: code " + std::to_string(rc) + ", regenerated " +
+                     std::to_string(stats.regeneratedRows) + "/" + std::to_string(stats.rows) + " rows" +
+                     (stats.recombined ? " (recombined)" : ""));
+    }
+    compare("editing sema pixels");
+
+    for (int layer = 0; layer < LAYER_COUNT && rc == 0; ++layer) {
+        if (session.HasLayer(layer)) rc = shift(layer, 0, h / 2, w / 2);
+    }
+    if (rc == 0) rc = session.Regenerate(stats);
+    if (rc != 0) failures.Add(d.name, "editing every layer returned " + std::to_string(rc));
+    compare("editing every layer");
+
+    // 配置中有而 sema 调色板中没有的颜色
+    int added = -1;
+    auto colors = cfg->colorMap.find(LAYER_NAMES[LAYER_SEMA]);
+    for (auto it = colors->second.begin(); colors != cfg->colorMap.end() && it != colors->second.end(); ++it) {
+        unsigned r, g, b;
+        if (std::sscanf(it->first.c_str(), "#%02x%02x%02x", &r, &g, &b) != 3) continue;
+        const std::vector<LayerColor>& pal = session.Layer(LAYER_SEMA).palette;
+        if (std::none_of(pal.begin(), pal.end(), [&](const LayerColor& c) { return c.r == r && c.g == g && c.b == b; })) {
+            added = session.AddColor(LAYER_SEMA, LayerColor{ (uint8_t)r, (uint8_t)g, (uint8_t)b, 0 });
+            break;
+        }
+    }
+    if (added < 0) return;
+    const uint8_t index = (uint8_t)added;
+    rc = session.SetPixels(LAYER_SEMA, w / 2, h - 1, 1, 1, &index, 1);
+    if (rc == 0) rc = session.Regenerate(stats);
+    if (rc != 0 || !stats.recombined) {
+        failures.Add(d.name, "using an appended sema colour: code " + std::to_string(rc) +
+                     (stats.recombined ? "" : " (not recombined)"));
+    }
+    compare("using an appended sema colour");
+}
+
+// 优化遍的固定用例: 输入, 启用的遍, 期望输出
+struct OptimizeCase {
+    const char* name;
+    const char* input;
+    unsigned passes;
+    const char* expected;
+};
+
+const OptimizeCase kOptimizeCases[] = {
+    { "empty loop after const", "DAT1 = 0\nRS 3\nDAT1 = 0\nRE\nT 1\n", PROGRAM_PASS_ALL, "DAT1 = 0\nT 1\n" },
+    { "nested empty loops", "DAT1 = 0\nRS 2\nRS 3\nDAT1 = 0\nRE\nRE\nT 1\n", PROGRAM_PASS_ALL, "DAT1 = 0\nT 1\n" },
+    { "loop with a T is kept", "DAT1 = 0\nRS 3\nDAT1 = 0\nT 1\nRE\n", PROGRAM_PASS_ALL, "DAT1 = 0\nRS 3\nT 1\nRE\n" },
+    { "empty loop after fold", "RS 2\nDAT1 += 1\nDAT1 -= 1\nRE\nT 1\n", PROGRAM_PASS_FOLD, "T 1\n" },
+};
+
+void CheckOptimizeCases(Failures& failures) {
+    for (const OptimizeCase& c : kOptimizeCases) {
+        const std::string out = OptimizeProgram(c.input, c.passes);
+        EmulatorResult before, after;
+        if (out != c.expected) {
+            failures.Add(c.name, "OptimizeProgram gives \"" + out + "\"");
+        } else if (EmulateProgram(c.input, EmulatorOptions(), before) != 0 ||
+                   EmulateProgram(out, EmulatorOptions(), after) != 0 || !SameEffects(after, before)) {
+            failures.Add(c.name, "optimized program behaves differently");
+        }
+    }
+}
+
+int Run(const std::vector<std::string>& args) {
+    TestOptions opts;
+    if (!ParseArgs(args, opts)) {
+        std::fprintf(stderr, "usage: yima_golden_test [--config <dir>] [--input <dir>] [--golden <file>] [--work <dir>] [--update]\n");
+        return 2;
+    }
+    SetLogLevel(LogLevel::Error);
+
+    YimaConfig cfg;
+    if (!LoadYimaConfig(CreatePathFromUtf8(opts.config), cfg)) {
+        std::fprintf(stderr, "cannot load config %s\n", opts.config.c_str());
+        return 2;
+    }
+    const fs::path work = CreatePathFromUtf8(opts.work);
+    std::error_code ec;
+    fs::remove_all(work, ec);
+
+    std::vector<Design> corpus;
+    if (!BuildCorpus(opts, cfg, corpus)) return 1;
+
+    const fs::path goldenPath = CreatePathFromUtf8(opts.golden);
+    GoldenMap goldens = opts.update ? GoldenMap() : LoadGoldens(goldenPath);
+    if (!opts.update && goldens.empty()) {
+        std::fprintf(stderr, "no golden hashes in %s\n", opts.golden.c_str());
+        return 1;
+    }
+    Failures failures;
+    const auto sharedCfg = std::make_shared<const YimaConfig>(cfg);
+    for (const Design& d : corpus) {
+        int before = failures.count();
+        CheckDesign(cfg, d, work, goldens, opts.update, failures);
+        CheckSession(sharedCfg, d, failures);
+        std::printf("%-4s %s\n", failures.count() == before ? "ok" : "FAIL", d.name.c_str());
+    }
+    const int before = failures.count();
+    CheckOptimizeCases(failures);
+    std::printf("%-4s optimizer cases\n", failures.count() == before ? "ok" : "FAIL");
+    FlushLog();
+
+    if (opts.update) {
+        if (!SaveGoldens(goldenPath, goldens)) {
+            std::fprintf(stderr, "cannot write %s\n", opts.golden.c_str());
+            return 1;
+        }
+        std::printf("updated %s (%zu hashes)\n", opts.golden.c_str(), goldens.size());
+    }
+    std::printf("%zu designs, %d failures\n", corpus.size(), failures.count());
+    return failures.count() ? 1 : 0;
+}
+
+} // namespace
+
+#ifdef _WIN32
+int wmain(int argc, wchar_t** argv) {
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) args.push_back(WideToUtf8(argv[i]));
+    return Run(args);
+}
+#else
+int main(int argc, char** argv) {
+    return Run(std::vector<std::string>(argv + 1, argv + argc));
+}
+#endif
@@ -0,0 +1,37 @@
+// 依次运行原生测试程序 (工作目录为 yima_addon), 任一失败时以非 0 退出
+const { spawnSync } = require('child_process')
+const fs = require('fs')
+const os = require('os')
+const path = require('path')
+
+const root = path.join(__dirname, '..')
+const exe = process.platform === 'win32' ? '.exe' : ''
+const buildDir = ['Release', 'Debug']
+  .map((c) => path.join(root, 'build', c))
+  .find((d) => fs.existsSync(path.join(d, 'yima_golden_test' + exe)))
+
+const tests = [['yima_golden_test']]
+
+// 性能回归门限: 与 test/perf/baseline.json 比较; 峰值 RSS 的逐用例计量依赖 /proc, 只在 Linux 上运行。
+// 每个用例取 9 次中的最小值。基线按 `npm test` 构建的配置 (node-gyp Release, 默认 yima_profile) 记录,
+// 其他构建 (Debug, yima_profile, yima_alloc_stats) 的结果不可比较, yima_bench 只提示不比较
+if (process.platform === 'linux') {
+  tests.push(['yima_bench', '--config', 'resources/config', '--input', 'resources/input', '--sizes', '300x1000',
+    '--repeat', '9', '--baseline', 'test/perf/baseline.json', '--out', path.join(os.tmpdir(), 'yima_bench.json')])
+}
+
+if (!buildDir) {
+  console.error('native tests are not built; run `node-gyp build` first')
+  process.exit(1)
+}
+
+let failed = 0
+for (const [name, ...args] of tests) {
+  console.log(`== ${name} ${args.join(' ')}`)
+  const r = spawnSync(path.join(buildDir, name + exe), args, { cwd: root, stdio: 'inherit' })
+  if (r.status !== 0) {
+    console.error(`${name} failed (${r.error ? r.error.message : 'exit ' + r.status})`)
+    failed++
+  }
+}
+process.exit(failed ? 1 : 0)
@@ -1,9 +1,85 @@
 {
+  "variables": {
+    "yima_usdt%": 0,
+    "yima_alloc_stats%": 0,
+    "yima_profile%": "default",
+    "yima_pgo_dir%": "<!(node -p \"require('path').resolve('pgo-data')\")"
+  },
+  "target_defaults": {
+    "include_dirs": [
+      ".",
+      "./cpp/1.bmp_extract",
+      "./cpp/2.toml_handle",
+      "./cpp/3.data_csv_handle",
+      "./cpp/4.cmd_csv_handle",
+      "./cpp/5.txt_generator",
+      "./cpp/6.txt_handle"
+    ],
+    "defines": [
+      "YIMA_EXPORTS"
+    ],
+    "cflags!": [ "-fno-exceptions" ],
+    "cflags_cc!": [ "-fno-exceptions", "-fno-rtti" ],
+    "cflags_cc": [ "-fexceptions" ],
+    "conditions": [
+      [ "OS=='linux' and yima_usdt==1", { "defines": [ "YIMA_USDT" ] } ],
+      [ "yima_profile!='default'", {
+        "conditions": [
+          [ "OS=='linux'", {
+            "cflags": [ "-O3", "-flto=auto" ],
+            "ldflags": [ "-O3", "-flto=auto" ]
+          } ],
+          [ "OS=='mac'", {
+            "xcode_settings": { "GCC_OPTIMIZATION_LEVEL": "3", "LLVM_LTO": "YES" }
+          } ],
+          [ "OS=='win'", {
+            "msvs_settings": {
+              "VCCLCompilerTool": { "WholeProgramOptimization": "true" },
+              "VCLibrarianTool": { "AdditionalOptions": [ "/LTCG" ] },
+              "VCLinkerTool": { "LinkTimeCodeGeneration": 1 }
+            }
+          } ]
+        ]
+      } ],
+      [ "OS=='linux' and yima_profile=='pgo-generate'", {
+        "cflags": [ "-fprofile-generate=<(yima_pgo_dir)", "-fprofile-update=atomic" ],
+        "ldflags": [ "-fprofile-generate=<(yima_pgo_dir)" ]
+      } ],
+      [ "OS=='linux' and yima_profile=='pgo-use'", {
+        "cflags": [ "-fprofile-use=<(yima_pgo_dir)", "-fprofile-correction", "-Wno-missing-profile" ]
+      } ],
+      [ "yima_profile=='multiversion'", { "defines": [ "YIMA_TARGET_CLONES" ] } ]
+    ],
+    "msvs_settings": {
+      "VCCLCompilerTool": { "ExceptionHandling": 1, "AdditionalOptions": [ "/std:c++17" ] }
+    },
+    "xcode_settings": {
+      "GCC_ENABLE_CPP_EXCEPTIONS": "YES",
+      "GCC_ENABLE_CPP_RTTI": "YES",
+      "CLANG_CXX_LANGUAGE_STANDARD": "c++17"
+    }
+  },
   "targets": [
     {
-      "target_name": "yima_addon",
+      "target_name": "yima_core",
+      "type": "static_library",
       "sources": [
-        "cpp/yima.cpp",
+        "cpp/yima_config.cpp",
+        "cpp/yima_pipeline.cpp",
+        "cpp/batch_runner.cpp",
+        "cpp/build_manifest.cpp",
+        "cpp/incremental_rows.cpp",
+        "cpp/design_session.cpp",
+        "cpp/design_generator.cpp",
+        "cpp/pixel_kernels.cpp",
+        "cpp/program_stream.cpp",
+        "cpp/program_ir.cpp",
+        "cpp/program_emulator.cpp",
+        "cpp/program_optimize.cpp",
+        "cpp/run_report.cpp",
+        "cpp/yima_log.cpp",
+        "cpp/yima_trace.cpp",
+        "cpp/yima_alloc_stats.cpp",
         "cpp/1.bmp_extract/bmp_extract.cpp",
         "cpp/2.toml_handle/toml_handle.cpp",
         "cpp/3.data_csv_handle/data_csv_handle.cpp",
@@ -11,30 +87,75 @@
         "cpp/5.txt_generator/txt_generator.cpp",
         "cpp/6.txt_handle/txt_handle.cpp"
       ],
+      "cflags": [ "-fPIC" ],
+      "xcode_settings": {
+        "OTHER_CFLAGS": [ "-fPIC" ]
+      },
+      "link_settings": {
+        "conditions": [
+          [ "OS=='win'", { "libraries": [ "psapi.lib" ] } ],
+          [ "OS=='linux'", { "libraries": [ "-lpthread" ] } ]
+        ]
+      }
+    },
+    {
+      "target_name": "yima_addon",
+      "sources": [
+        "cpp/yima.cpp"
+      ],
       "include_dirs": [
-        "<!@(node -p \"require('node-addon-api').include\")",
-        ".",
-        "./cpp/1.bmp_extract",
-        "./cpp/2.toml_handle",
-        "./cpp/3.data_csv_handle",
-        "./cpp/4.cmd_csv_handle",
-        "./cpp/5.txt_generator",
-        "./cpp/6.txt_handle"
+        "<!@(node -p \"require('node-addon-api').include\")"
       ],
       "dependencies": [
+        "yima_core",
         "<!(node -p \"require('node-addon-api').gyp\")"
       ],
       "defines": [
-        "NAPI_CPP_EXCEPTIONS",
-        "YIMA_EXPORTS"
+        "NAPI_CPP_EXCEPTIONS"
+      ]
+    },
+    {
+      "target_name": "yima_cli",
+      "type": "executable",
+      "sources": [
+        "cpp/yima_cli.cpp"
       ],
-      "msvs_settings": {
-        "VCCLCompilerTool": { "ExceptionHandling": 1, "AdditionalOptions": [ "/std:c++17" ] }
-      },
-      "xcode_settings": {
-        "GCC_ENABLE_CPP_EXCEPTIONS": "YES",
-        "CLANG_CXX_LANGUAGE_STANDARD": "c++17"
-      }
+      "dependencies": [
+        "yima_core"
+      ],
+      "conditions": [
+        [ "yima_alloc_stats==1", { "sources": [ "cpp/yima_alloc_hooks.cpp" ] } ]
+      ]
+    },
+    {
+      "target_name": "yima_bench",
+      "type": "executable",
+      "sources": [
+        "cpp/yima_bench.cpp",
+        "cpp/bench_gate.cpp"
+      ],
+      "defines": [
+        "YIMA_BUILD_PROFILE=\"<(yima_profile)\""
+      ],
+      "dependencies": [
+        "yima_core"
+      ],
+      "conditions": [
+        [ "yima_alloc_stats==1", { "sources": [ "cpp/yima_alloc_hooks.cpp" ] } ]
+      ]
+    },
+    {
+      "target_name": "yima_golden_test",
+      "type": "executable",
+      "sources": [
+        "test/golden_test.cpp"
+      ],
+      "include_dirs": [
+        "./cpp"
+      ],
+      "dependencies": [
+        "yima_core"
+      ]
     }
   ]
 }